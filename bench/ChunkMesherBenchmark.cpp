@@ -0,0 +1,186 @@
+// Compares ChunkMesher against the per-voxel face emitter VoxelWorld::generateMeshData
+// used before: six std::vector<Vertex> face tables built on every call, and an addFace
+// that branches on the normal of every vertex to pick its UV axes.
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <string>
+#include <cmath>
+#include "ChunkMesher.h"
+#include "ChunkedVoxelStorage.h"
+#include "MaterialRegistry.h"
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// The addFace VoxelWorld used, unchanged apart from taking the colour by value
+static void legacyAddFace(std::vector<Vertex>& vertexBuffer, std::vector<unsigned int>& indexBuffer, int x, int y, int z, const std::vector<Vertex>& faceVertices, const std::vector<unsigned int>& faceIndices, glm::vec3 color) {
+    unsigned int baseIndex = static_cast<unsigned int>(vertexBuffer.size());
+    float scale = 1.0f / 5.0f;
+    for (const auto& vertex : faceVertices) {
+        float u = vertex.u * scale;
+        float v = vertex.v * scale;
+        if (vertex.nx != 0) {
+            u += (z % 5) * scale;
+            v += (y % 5) * scale;
+        } else if (vertex.ny != 0) {
+            u += (x % 5) * scale;
+            v += (z % 5) * scale;
+        } else if (vertex.nz != 0) {
+            u += (x % 5) * scale;
+            v += (y % 5) * scale;
+        }
+        vertexBuffer.emplace_back(vertex.x + x, vertex.y + y, vertex.z + z, color.r, color.g, color.b, vertex.nx, vertex.ny, vertex.nz, u, v);
+    }
+    for (const auto& index : faceIndices) {
+        indexBuffer.push_back(baseIndex + index);
+    }
+}
+
+// generateMeshData's loop for one chunk. Neighbours come from the same padded block the
+// mesher reads instead of a hash lookup, so only building the faces is compared.
+static void legacyMeshChunk(const VoxelStorage& storage, const glm::ivec3& chunkPos, std::vector<MaterialId>& block, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+    const float halfSize = 0.5f;
+    const std::vector<Vertex> faceVertices[6] = {
+        { Vertex(-halfSize, -halfSize, halfSize, 1, 0, 0, 0, 0, 1, 0, 0), Vertex(halfSize, -halfSize, halfSize, 0, 1, 0, 0, 0, 1, 1, 0),
+          Vertex(halfSize, halfSize, halfSize, 0, 0, 1, 0, 0, 1, 1, 1), Vertex(-halfSize, halfSize, halfSize, 1, 1, 0, 0, 0, 1, 0, 1) },
+        { Vertex(-halfSize, -halfSize, -halfSize, 1, 0, 0, 0, 0, -1, 0, 0), Vertex(halfSize, -halfSize, -halfSize, 0, 1, 0, 0, 0, -1, 1, 0),
+          Vertex(halfSize, halfSize, -halfSize, 0, 0, 1, 0, 0, -1, 1, 1), Vertex(-halfSize, halfSize, -halfSize, 1, 1, 0, 0, 0, -1, 0, 1) },
+        { Vertex(-halfSize, -halfSize, -halfSize, 1, 0, 0, -1, 0, 0, 0, 0), Vertex(-halfSize, -halfSize, halfSize, 0, 1, 0, -1, 0, 0, 1, 0),
+          Vertex(-halfSize, halfSize, halfSize, 0, 0, 1, -1, 0, 0, 1, 1), Vertex(-halfSize, halfSize, -halfSize, 1, 1, 0, -1, 0, 0, 0, 1) },
+        { Vertex(halfSize, -halfSize, -halfSize, 1, 0, 0, 1, 0, 0, 0, 0), Vertex(halfSize, -halfSize, halfSize, 0, 1, 0, 1, 0, 0, 1, 0),
+          Vertex(halfSize, halfSize, halfSize, 0, 0, 1, 1, 0, 0, 1, 1), Vertex(halfSize, halfSize, -halfSize, 1, 1, 0, 1, 0, 0, 0, 1) },
+        { Vertex(-halfSize, halfSize, -halfSize, 1, 0, 0, 0, 1, 0, 0, 0), Vertex(halfSize, halfSize, -halfSize, 0, 1, 0, 0, 1, 0, 1, 0),
+          Vertex(halfSize, halfSize, halfSize, 0, 0, 1, 0, 1, 0, 1, 1), Vertex(-halfSize, halfSize, halfSize, 1, 1, 0, 0, 1, 0, 0, 1) },
+        { Vertex(-halfSize, -halfSize, -halfSize, 1, 0, 0, 0, -1, 0, 0, 0), Vertex(halfSize, -halfSize, -halfSize, 0, 1, 0, 0, -1, 0, 1, 0),
+          Vertex(halfSize, -halfSize, halfSize, 0, 0, 1, 0, -1, 0, 1, 1), Vertex(-halfSize, -halfSize, halfSize, 1, 1, 0, 0, -1, 0, 0, 1) }
+    };
+    const std::vector<unsigned int> faceIndices = { 0, 1, 2, 2, 3, 0 };
+    const int P = ChunkMesher::PADDED;
+    const int neighbours[6] = { P * P, -P * P, -1, 1, P, -P }; // Same face order as above
+
+    vertices.clear();
+    indices.clear();
+    glm::ivec3 origin = VoxelChunk::chunkOrigin(chunkPos);
+    storage.readRegion(origin - 1, glm::ivec3(P), block.data());
+    const MaterialRegistry& registry = MaterialRegistry::global();
+    for (int z = 0; z < VoxelChunk::SIZE; ++z) {
+        for (int y = 0; y < VoxelChunk::SIZE; ++y) {
+            for (int x = 0; x < VoxelChunk::SIZE; ++x) {
+                int padded = (x + 1) + (y + 1) * P + (z + 1) * P * P;
+                MaterialId material = block[padded];
+                if (material == MaterialRegistry::NONE) {
+                    continue;
+                }
+                glm::vec3 color = registry.get(material).color;
+                for (int face = 0; face < 6; ++face) {
+                    if (block[padded + neighbours[face]] == MaterialRegistry::NONE) {
+                        legacyAddFace(vertices, indices, origin.x + x, origin.y + y, origin.z + z, faceVertices[face], faceIndices, color);
+                    }
+                }
+            }
+        }
+    }
+}
+
+static void printResult(const std::string& name, double seconds, size_t chunkCount, size_t vertexBytes, size_t triangles) {
+    std::cout << "  " << std::left << std::setw(34) << name
+              << std::right << std::setw(10) << std::fixed << std::setprecision(1) << seconds / chunkCount * 1e6 << " us/chunk"
+              << std::setw(10) << vertexBytes / 1024 << " KiB vertices"
+              << std::setw(10) << triangles << " triangles" << std::endl;
+}
+
+// Best of several rounds over every chunk, as the machine's other load only ever slows a round down
+static void runScene(const std::string& scene, const ChunkedVoxelStorage& storage, const std::vector<glm::ivec3>& chunks) {
+    const int rounds = 10;
+    std::cout << scene << " (" << chunks.size() << " chunks)" << std::endl;
+
+    std::vector<MaterialId> block(ChunkMesher::PADDED * ChunkMesher::PADDED * ChunkMesher::PADDED);
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    double best = 1e30;
+    size_t vertexBytes = 0;
+    size_t triangles = 0;
+    for (int round = 0; round < rounds; ++round) {
+        vertexBytes = 0;
+        triangles = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (const glm::ivec3& chunkPos : chunks) {
+            legacyMeshChunk(storage, chunkPos, block, vertices, indices);
+            vertexBytes += vertices.size() * sizeof(Vertex);
+            triangles += indices.size() / 3;
+        }
+        best = std::min(best, secondsSince(start));
+    }
+    printResult("per-voxel addFace (before)", best, chunks.size(), vertexBytes, triangles);
+
+    const MeshingMode modes[2] = { MESH_FACES, MESH_GREEDY };
+    const char* names[2] = { "ChunkMesher MESH_FACES", "ChunkMesher MESH_GREEDY" };
+    for (int i = 0; i < 2; ++i) {
+        ChunkMesher mesher;
+        mesher.setMode(modes[i]);
+        ChunkMesh mesh;
+        best = 1e30;
+        for (int round = 0; round < rounds; ++round) {
+            vertexBytes = 0;
+            triangles = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (const glm::ivec3& chunkPos : chunks) {
+                mesher.meshChunk(storage, chunkPos, mesh);
+                vertexBytes += mesh.vertices.size() * sizeof(PackedVertex);
+                triangles += mesh.indices.size() / 3;
+            }
+            best = std::min(best, secondsSince(start));
+        }
+        printResult(names[i], best, chunks.size(), vertexBytes, triangles);
+    }
+}
+
+static std::vector<glm::ivec3> chunksOf(const ChunkedVoxelStorage& storage, const glm::ivec3& voxelMin, const glm::ivec3& voxelMax) {
+    std::vector<glm::ivec3> chunks;
+    glm::ivec3 low = VoxelChunk::chunkCoord(voxelMin);
+    glm::ivec3 high = VoxelChunk::chunkCoord(voxelMax);
+    for (int z = low.z; z <= high.z; ++z) {
+        for (int y = low.y; y <= high.y; ++y) {
+            for (int x = low.x; x <= high.x; ++x) {
+                if (storage.hasChunk(glm::ivec3(x, y, z))) {
+                    chunks.emplace_back(x, y, z);
+                }
+            }
+        }
+    }
+    return chunks;
+}
+
+int main() {
+    MaterialRegistry& registry = MaterialRegistry::global();
+    MaterialId stone = registry.getMaterial(1, glm::vec3(0.5f, 0.5f, 0.5f), "default");
+    MaterialId grass = registry.getMaterial(1, glm::vec3(0.2f, 0.8f, 0.2f), "default");
+
+    ChunkedVoxelStorage terrain;
+    for (int x = 0; x < 128; ++x) {
+        for (int z = 0; z < 128; ++z) {
+            int height = 20 + static_cast<int>(8 * std::sin(x * 0.1) + 8 * std::cos(z * 0.13));
+            for (int y = 0; y < height; ++y) {
+                terrain.setVoxel(glm::ivec3(x, y, z), y > height - 3 ? grass : stone);
+            }
+        }
+    }
+    runScene("Rolling terrain 128x128", terrain, chunksOf(terrain, glm::ivec3(0), glm::ivec3(127, 40, 127)));
+
+    // Every other voxel of a checkerboard shows all six faces: the worst case for both
+    ChunkedVoxelStorage checker;
+    for (int x = 0; x < 64; ++x) {
+        for (int y = 0; y < 64; ++y) {
+            for (int z = 0; z < 64; ++z) {
+                if ((x + y + z) % 2 == 0) {
+                    checker.setVoxel(glm::ivec3(x, y, z), (x / 8) % 2 ? grass : stone);
+                }
+            }
+        }
+    }
+    runScene("Checkerboard 64^3", checker, chunksOf(checker, glm::ivec3(0), glm::ivec3(63)));
+    return 0;
+}
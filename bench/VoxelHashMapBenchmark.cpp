@@ -0,0 +1,88 @@
+// Compares voxel coordinate lookups in VoxelHashSet against the
+// std::unordered_set + shift-xor hashes the editor used before.
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <string>
+#include <unordered_set>
+#include "VoxelHashMap.h"
+#include "glm_hash.h"
+
+// The hasher VoxelWorld used for its voxel map
+struct ShiftXorHasher {
+    std::size_t operator()(const glm::ivec3& voxel) const {
+        std::size_t xHash = std::hash<int>()(voxel.x);
+        std::size_t yHash = std::hash<int>()(voxel.y);
+        std::size_t zHash = std::hash<int>()(voxel.z);
+        return ((xHash ^ (yHash << 1)) >> 1) ^ (zHash << 1);
+    }
+};
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Neighbour tests like the mesher does: every key probed along with its six neighbours
+template <typename Set>
+static void runBenchmark(const std::string& name, const std::vector<glm::ivec3>& keys) {
+    static const glm::ivec3 offsets[6] = {
+        glm::ivec3(1, 0, 0), glm::ivec3(-1, 0, 0), glm::ivec3(0, 1, 0),
+        glm::ivec3(0, -1, 0), glm::ivec3(0, 0, 1), glm::ivec3(0, 0, -1)
+    };
+
+    Set set;
+    auto start = std::chrono::steady_clock::now();
+    for (const auto& key : keys) {
+        set.insert(key);
+    }
+    double insertSeconds = secondsSince(start);
+
+    size_t hits = 0;
+    const int rounds = 3;
+    start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; ++round) {
+        for (const auto& key : keys) {
+            hits += set.count(key);
+            for (const auto& offset : offsets) {
+                hits += set.count(key + offset);
+            }
+        }
+    }
+    double lookupSeconds = secondsSince(start);
+    double lookups = static_cast<double>(keys.size()) * 7 * rounds;
+
+    std::cout << "  " << std::left << std::setw(34) << name
+              << std::right << std::setw(10) << std::fixed << std::setprecision(1) << keys.size() / insertSeconds / 1e6 << " M inserts/s"
+              << std::setw(10) << lookups / lookupSeconds / 1e6 << " M lookups/s"
+              << "   (hits " << hits << ")" << std::endl;
+}
+
+static void runScene(const std::string& scene, const std::vector<glm::ivec3>& keys) {
+    std::cout << scene << " (" << keys.size() << " voxels)" << std::endl;
+    runBenchmark<std::unordered_set<glm::ivec3>>("unordered_set + std::hash<ivec3>", keys);
+    runBenchmark<std::unordered_set<glm::ivec3, ShiftXorHasher>>("unordered_set + VoxelIndexHasher", keys);
+    runBenchmark<VoxelHashSet>("VoxelHashSet (Morton, Robin Hood)", keys);
+}
+
+int main() {
+    std::vector<glm::ivec3> floor;
+    // Kept modest: the shift-xor hashes degrade badly enough on planes that larger floors take minutes
+    for (int x = -128; x < 128; ++x) {
+        for (int z = -128; z < 128; ++z) {
+            floor.emplace_back(x, 0, z);
+        }
+    }
+    runScene("Planar floor 256x1x256", floor);
+
+    std::vector<glm::ivec3> cube;
+    for (int x = 0; x < 40; ++x) {
+        for (int y = 0; y < 40; ++y) {
+            for (int z = 0; z < 40; ++z) {
+                cube.emplace_back(x, y, z);
+            }
+        }
+    }
+    runScene("Solid cube 40^3", cube);
+    return 0;
+}
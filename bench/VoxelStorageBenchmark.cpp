@@ -0,0 +1,105 @@
+// Compares the storage backends on bounded scenes: the padded block reads the
+// mesher does for every chunk, and single voxel lookups like picking and the
+// extrusion tools make.
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <string>
+#include <cmath>
+#include "VoxelStorage.h"
+#include "ChunkMesher.h"
+#include "VoxelChunk.h"
+#include "MaterialRegistry.h"
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void runBackend(const std::string& name, const VoxelStorage& storage, int size) {
+    const int rounds = 5;
+    const int padded = ChunkMesher::PADDED;
+    std::vector<glm::ivec3> chunks;
+    storage.forEachChunk([&](const glm::ivec3& chunkPos) { chunks.push_back(chunkPos); });
+
+    // Padded block reads, best of several rounds
+    std::vector<MaterialId> block(static_cast<size_t>(padded) * padded * padded);
+    size_t filled = 0;
+    double bestRead = 1e30;
+    for (int round = 0; round < rounds; ++round) {
+        filled = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (const glm::ivec3& chunkPos : chunks) {
+            storage.readRegion(chunkPos * VoxelChunk::SIZE - 1, glm::ivec3(padded), block.data());
+            filled += block[block.size() / 2] != MaterialRegistry::NONE;
+        }
+        bestRead = std::min(bestRead, secondsSince(start));
+    }
+
+    // Every cell of the bounds, x fastest
+    size_t hits = 0;
+    double bestLookup = 1e30;
+    for (int round = 0; round < rounds; ++round) {
+        hits = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int z = 0; z < size; ++z) {
+            for (int y = 0; y < size; ++y) {
+                for (int x = 0; x < size; ++x) {
+                    hits += storage.getVoxel(glm::ivec3(x, y, z)) != MaterialRegistry::NONE;
+                }
+            }
+        }
+        bestLookup = std::min(bestLookup, secondsSince(start));
+    }
+    double lookups = static_cast<double>(size) * size * size;
+
+    std::cout << "  " << std::left << std::setw(16) << name
+              << std::right << std::setw(10) << std::fixed << std::setprecision(1) << bestRead / chunks.size() * 1e6 << " us/block read"
+              << std::setw(10) << lookups / bestLookup / 1e6 << " M lookups/s"
+              << "   (" << chunks.size() << " chunks, " << hits << " voxels, " << filled << ")" << std::endl;
+}
+
+template <typename Fill>
+static void runScene(const std::string& scene, int size, Fill fill) {
+    std::cout << scene << std::endl;
+    const VoxelStorageType types[3] = { STORAGE_CHUNKED, STORAGE_SPARSE_OCTREE, STORAGE_DENSE };
+    const char* names[3] = { "Chunked", "Sparse octree", "Dense grid" };
+    for (int i = 0; i < 3; ++i) {
+        std::unique_ptr<VoxelStorage> storage = VoxelStorage::create(types[i], size);
+        fill(*storage);
+        runBackend(names[i], *storage, size);
+    }
+}
+
+int main() {
+    MaterialRegistry& registry = MaterialRegistry::global();
+    MaterialId stone = registry.getMaterial(1, glm::vec3(0.5f, 0.5f, 0.5f), "default");
+    MaterialId grass = registry.getMaterial(1, glm::vec3(0.2f, 0.8f, 0.2f), "default");
+
+    runScene("Rolling terrain 128^3", 128, [&](VoxelStorage& storage) {
+        for (int x = 0; x < 128; ++x) {
+            for (int z = 0; z < 128; ++z) {
+                int height = 40 + static_cast<int>(12 * std::sin(x * 0.1) + 12 * std::cos(z * 0.13));
+                for (int y = 0; y < height; ++y) {
+                    storage.setVoxel(glm::ivec3(x, y, z), y > height - 3 ? grass : stone);
+                }
+            }
+        }
+    });
+
+    // A hollow sphere mixing two materials, like a sculpted prop
+    runScene("Sphere shell 96^3", 96, [&](VoxelStorage& storage) {
+        glm::vec3 centre(47.5f);
+        for (int x = 0; x < 96; ++x) {
+            for (int y = 0; y < 96; ++y) {
+                for (int z = 0; z < 96; ++z) {
+                    float distance = glm::length(glm::vec3(x, y, z) - centre);
+                    if (distance < 46.0f && distance > 38.0f) {
+                        storage.setVoxel(glm::ivec3(x, y, z), (x + z) % 7 < 3 ? grass : stone);
+                    }
+                }
+            }
+        }
+    });
+    return 0;
+}
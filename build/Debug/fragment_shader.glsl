@@ -4,12 +4,34 @@ in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoord;
 in vec3 Color;
+in float AmbientOcclusion;
+in vec3 VoxelCoord;
 
 uniform sampler2D texture1;
 uniform vec3 objectColor;
 uniform int useTexture; // Changed to int
 uniform vec3 lightPos;
 uniform vec3 viewPos;
+// Selection and highlight bits, 2048 words per chunk slot: 1024 selected, then 1024 highlighted,
+// bit i of the chunk's mask in word i / 32. selectionSlot is -1 for chunks with nothing flagged.
+uniform usamplerBuffer selectionBits;
+uniform int selectionSlot;
+
+// 1 for selected, 2 for highlighted, 0 otherwise
+int voxelFlags()
+{
+    if (selectionSlot < 0) {
+        return 0;
+    }
+    ivec3 voxel = clamp(ivec3(floor(VoxelCoord)), 0, 31);
+    int index = voxel.x | voxel.y << 5 | voxel.z << 10;
+    int word = selectionSlot * 2048 + (index >> 5);
+    uint bit = 1u << uint(index & 31);
+    if ((texelFetch(selectionBits, word).r & bit) != 0u) {
+        return 1;
+    }
+    return (texelFetch(selectionBits, word + 1024).r & bit) != 0u ? 2 : 0;
+}
 
 void main()
 {
@@ -31,11 +53,18 @@ void main()
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
     vec3 specular = specularStrength * spec * vec3(1.0);
 
-    vec3 lighting = (ambient + diffuse + specular);
+    vec3 lighting = (ambient + diffuse) * AmbientOcclusion + specular;
 
-    if (useTexture == 1) { // Check if useTexture is 1
+    int flags = voxelFlags();
+    if (flags == 1) {
+        vec4 texColor = texture(texture1, TexCoord);
+        FragColor = vec4(lighting * vec3(1.0, 0.0, 0.0), 0.9) * texColor; // Red for selected
+    } else if (flags == 2) {
+        vec4 texColor = texture(texture1, TexCoord);
+        FragColor = vec4(lighting * vec3(1.0, 0.7, 0.0), 0.9) * texColor; // Orange for highlighted
+    } else if (useTexture == 1) { // Check if useTexture is 1
         vec4 texColor = texture(texture1, TexCoord);
-        FragColor = vec4(lighting, 1.0) * texColor;
+        FragColor = vec4(lighting * Color, 1.0) * texColor; // Tinted by the material palette
     } else {
         vec4 texColor = texture(texture1, TexCoord);
         FragColor = vec4(lighting * objectColor, 0.9)* texColor; // 0.6 alpha for transparency
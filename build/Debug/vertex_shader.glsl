@@ -1,23 +1,73 @@
 #version 330 core
-layout(location = 0) in vec3 aPos;
-layout(location = 1) in vec3 aColor;
-layout(location = 2) in vec3 aNormal;
-layout(location = 3) in vec2 aTexCoord;
+// Chunk vertices are packed into two words, see PackedVertex in Vertex.h
+layout(location = 0) in uint aPosition;
+layout(location = 1) in uint aMaterial;
 
 out vec3 FragPos;
 out vec3 Normal;
 out vec3 Color;
 out vec2 TexCoord;
+out float AmbientOcclusion;
+out vec3 VoxelCoord; // Chunk-local; floor() gives the voxel the fragment belongs to
 
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
+uniform vec3 chunkOrigin;
+uniform samplerBuffer materialColors; // One RGBA texel per MaterialId
+uniform int smoothMesh; // 1 if the chunk was meshed with MESH_SMOOTH, which packs vertices differently
+
+const vec3 faceNormals[6] = vec3[6](
+    vec3(0.0, 0.0, 1.0), vec3(0.0, 0.0, -1.0),
+    vec3(-1.0, 0.0, 0.0), vec3(1.0, 0.0, 0.0),
+    vec3(0.0, 1.0, 0.0), vec3(0.0, -1.0, 0.0)
+);
+
+// Inverse of encodeNormal in ChunkMesher.cpp
+vec3 decodeNormal(uint encoded) {
+    vec2 oct = vec2(encoded & 255u, (encoded >> 8) & 255u) / 255.0 * 2.0 - 1.0;
+    vec3 n = vec3(oct, 1.0 - abs(oct.x) - abs(oct.y));
+    if (n.z < 0.0) {
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(n);
+}
 
 void main() {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;
-    Color = aColor;
-    TexCoord = aTexCoord;
+    // Both encodings end up as a chunk-local voxel corner position: voxel centres sit half a voxel
+    // inside, on integer coordinates once the chunk origin is added
+    vec3 local;
+    vec3 normal;
+    uint ao = 0u;
+    if (smoothMesh == 1) {
+        local = vec3(aPosition & 1023u, (aPosition >> 10) & 1023u, (aPosition >> 20) & 1023u) / 16.0 - 0.5;
+        normal = decodeNormal(aMaterial >> 16);
+    } else {
+        local = vec3(aPosition & 63u, (aPosition >> 6) & 63u, (aPosition >> 12) & 63u);
+        normal = faceNormals[(aPosition >> 18) & 7u];
+        ao = (aPosition >> 21) & 3u;
+    }
+    AmbientOcclusion = 1.0 - 0.2 * float(ao); // Corners in creases get less ambient and diffuse light
+
+    // The texture repeats every 5 voxels along the two axes the face spans; smooth
+    // surfaces take the plane their normal leans towards most
+    vec3 corner = chunkOrigin + local;
+    vec3 lean = abs(normal);
+    if (lean.z >= lean.x && lean.z >= lean.y) {
+        TexCoord = corner.xy / 5.0;
+    } else if (lean.x >= lean.y) {
+        TexCoord = corner.zy / 5.0;
+    } else {
+        TexCoord = corner.xz / 5.0;
+    }
+
+    Color = texelFetch(materialColors, int(aMaterial & 0xFFFFu)).rgb;
+
+    // Half a voxel back from the surface lands inside the voxel that owns it
+    VoxelCoord = local - 0.5 * normal;
+
+    FragPos = vec3(model * vec4(corner - 0.5, 1.0));
+    Normal = mat3(transpose(inverse(model))) * normal;
 
     gl_Position = projection * view * vec4(FragPos, 1.0);
 }
@@ -0,0 +1,42 @@
+#ifndef CHUNKCULLER_H
+#define CHUNKCULLER_H
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+// The six planes of a view frustum, each with its normal pointing inwards:
+// a point p is inside a plane when dot(plane.xyz, p) + plane.w >= 0.
+struct Frustum {
+    glm::vec4 planes[6]; // Left, right, bottom, top, near, far
+
+    // Reads the planes straight off projection * view, so they come out in world space
+    static Frustum fromMatrix(const glm::mat4& viewProjection);
+};
+
+// Axis-aligned boxes, one per chunk, stored as separate centre and half extent arrays, so
+// SSE tests four boxes against a plane at once. Boxes are numbered in the order they are
+// added; removing one moves the last box into its place.
+class ChunkCuller {
+public:
+    ChunkCuller();
+
+    size_t add(const glm::vec3& boxMin, const glm::vec3& boxMax); // Returns the new box's index
+    void remove(size_t index);
+    void clear();
+    size_t size() const { return count; }
+
+    // Replaces visible with the index of every box at least partly inside the frustum, in
+    // ascending order. Boxes that straddle a plane corner may pass; none inside is dropped.
+    void cull(const Frustum& frustum, std::vector<uint32_t>& visible) const;
+
+private:
+    // Sized to a multiple of four, so the SSE loop never runs off the end; lanes past count are ignored
+    std::vector<float> centerX, centerY, centerZ;
+    std::vector<float> extentX, extentY, extentZ;
+    size_t count;
+
+    void setBox(size_t index, const glm::vec3& center, const glm::vec3& extent);
+};
+
+#endif
@@ -0,0 +1,130 @@
+#ifndef CHUNKMESHER_H
+#define CHUNKMESHER_H
+
+#include <vector>
+#include <utility>
+#include <glm/glm.hpp>
+#include "Vertex.h"
+#include "VoxelChunk.h"
+#include "VoxelStorage.h"
+
+class MeshCache;
+
+// Run of indices that all sample the same texture
+struct TextureRange {
+    TextureId texture;
+    uint32_t firstIndex;
+    uint32_t indexCount;
+};
+
+// Quad of a ChunkMesh that covers a single voxel; the quad owns vertices 4 * quad to 4 * quad + 3
+struct VoxelQuad {
+    uint16_t voxel; // VoxelChunk::localIndex
+    uint32_t quad;
+};
+
+// Triangles for one chunk, with positions relative to the chunk origin. Only voxels
+// shape the mesh; selection and highlight are drawn over it by the renderer, so
+// changing them never remeshes a chunk.
+struct ChunkMesh {
+    std::vector<PackedVertex> vertices;
+    std::vector<unsigned int> indices;
+    std::vector<TextureRange> textureRanges; // Covers indices, one range per texture used
+    // Sorted by voxel, so recolouring a voxel can rewrite the material of its quads in place.
+    // Greedy quads spanning several voxels are left out.
+    std::vector<VoxelQuad> voxelQuads;
+    bool smooth; // Vertices use the MESH_SMOOTH encoding, see PackedVertex
+    // Coarser copies for distant chunks: lods[i] is meshed from cells of 2 << i voxels.
+    // Empty unless the mesher was asked for levels of detail; only textureRanges are set.
+    std::vector<ChunkMesh> lods;
+    // MeshCache key of the voxels the mesh was built from; 0 if unknown, or if the mesh was
+    // patched since and no longer matches them
+    uint64_t contentKey;
+    // Changes whenever the owner changes the mesh, so a renderer can tell whether its copy is current
+    uint64_t generation;
+
+    ChunkMesh() : smooth(false), contentKey(0), generation(0) {}
+    bool empty() const { return indices.empty(); }
+    // The voxel's entries in voxelQuads, as [first, last)
+    std::pair<const VoxelQuad*, const VoxelQuad*> findVoxelQuads(int voxel) const;
+    void clear();
+};
+
+// MESH_FACES emits one quad per exposed voxel face. MESH_GREEDY merges coplanar
+// neighbouring faces of the same material and shading into rectangles,
+// which cuts flat surfaces down to a handful of quads. MESH_SMOOTH runs surface
+// nets over the occupancy: one shared vertex per cell of 8 voxel centres that
+// straddles the surface, with a normal from the cell's gradient, so sculpted
+// shapes come out smooth instead of as stacked cubes.
+enum MeshingMode {
+    MESH_FACES,
+    MESH_GREEDY,
+    MESH_SMOOTH
+};
+
+// Builds the mesh of one chunk from any storage backend. The chunk is copied
+// out with a one voxel border first, so faces on the chunk edge are culled
+// against the neighbouring chunks too. Culling turns the copy into bit columns
+// along each axis and finds every visible face with a shift and mask per column. Keeps that copy as scratch space, so
+// reuse one mesher for many chunks, and use one per thread.
+class ChunkMesher {
+public:
+    static constexpr int PADDED = VoxelChunk::SIZE + 2;
+    static constexpr int MAX_LOD_LEVELS = 3; // Cells of 2, 4 and 8 voxels
+
+    ChunkMesher();
+
+    void setMode(MeshingMode newMode) { mode = newMode; }
+    MeshingMode getMode() const { return mode; }
+    // How many coarse meshes meshChunk adds to ChunkMesh::lods, 0 to MAX_LOD_LEVELS.
+    // MESH_SMOOTH builds none; its surface has no seam handling between levels.
+    void setLodLevels(int levels) { lodLevels = levels; }
+    int getLodLevels() const { return lodLevels; }
+    // Chunks whose padded block is found in the cache are copied out of it instead of
+    // meshed, and every mesh built is stored there. nullptr (the default) meshes everything.
+    void setCache(MeshCache* newCache) { cache = newCache; }
+
+    void meshChunk(const VoxelStorage& storage, const glm::ivec3& chunkPos, ChunkMesh& mesh);
+    // Rebuilds only mesh.lods, e.g. after recolouring voxels patched the full detail mesh
+    void meshLods(const VoxelStorage& storage, const glm::ivec3& chunkPos, ChunkMesh& mesh);
+
+private:
+    struct TextureBucket {
+        TextureId texture;
+        std::vector<unsigned int> indices;
+        std::vector<uint32_t> quads; // Cube quads as quad << 1 | flipped diagonal, expanded into indices when joined
+    };
+
+    MeshingMode mode;
+    int lodLevels;
+    MeshCache* cache;
+    std::vector<MaterialId> block;
+    std::vector<uint32_t> faceMask; // Face keys of one face direction, slice by slice; all zero between uses
+    std::vector<uint64_t> columns;  // Padded block occupancy: per axis, one bit column per (u, v)
+    std::vector<uint64_t> culled;   // Column kernel output, the + and - faces of one axis
+    std::vector<uint32_t> faceBits; // Visible faces: per face, one 32-bit column per chunk (u, v)
+    std::vector<TextureBucket> buckets; // Indices per texture, joined into one buffer at the end
+    std::vector<VoxelQuad> quadScratch; // Second buffer for sorting voxelQuads
+    std::vector<int32_t> cellVertices;  // Smooth mode: vertex of each cell, -1 until used; reset after every chunk
+    std::vector<int> usedCells;
+    std::vector<MaterialId> lodBlocks[MAX_LOD_LEVELS]; // Downsampled block per level, with a one cell border
+    std::vector<uint32_t> lodMask;                     // Coarse face keys per face and slice, sized for level 1; all zero between uses
+
+    TextureBucket& findBucket(TextureId texture);
+    std::vector<unsigned int>& bucketFor(TextureId texture);
+    std::vector<uint32_t>& bucketForQuads(TextureId texture);
+    void joinBuckets(ChunkMesh& mesh); // Appends the buckets' indices to mesh and empties them
+    void cullFaces(); // Fills faceBits from block
+    void sortVoxelQuads(std::vector<VoxelQuad>& quads);
+    void meshFaces(ChunkMesh& mesh);
+    void meshGreedy(ChunkMesh& mesh);
+    // One face direction, FACE numbered as in PackedVertex, so its axes and strides are constants.
+    // Writes its quads from quadCount and voxelQuadCount on, into lists meshGreedy sized for every face.
+    template <int FACE> void meshGreedyDirection(ChunkMesh& mesh, uint32_t& quadCount, uint32_t& voxelQuadCount);
+    void meshSmooth(ChunkMesh& mesh);
+    void buildLods(ChunkMesh& mesh); // From block
+    void meshCoarse(const std::vector<MaterialId>& cells, int cellsPerAxis, ChunkMesh& mesh);
+    uint32_t cellVertex(ChunkMesh& mesh, const glm::ivec3& cell); // cell is the local voxel at its low corner, -1..31
+};
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef CHUNKEDVOXELSTORAGE_H
+#define CHUNKEDVOXELSTORAGE_H
+
+#include <memory>
+#include "VoxelStorage.h"
+#include "VoxelChunk.h"
+#include "VoxelHashMap.h"
+
+// Unbounded storage made of palette-compressed chunks keyed by chunk coordinate.
+// Chunks are created on first write and dropped again once they are empty.
+//
+// Chunks are reference counted and copy-on-write: clone() only copies the chunk
+// table, and whichever copy edits a shared chunk first gets its own copy of
+// that one chunk. A clone is never modified by edits to the original, so it can
+// be read from another thread while editing continues.
+class ChunkedVoxelStorage : public VoxelStorage {
+public:
+    ChunkedVoxelStorage();
+
+    std::unique_ptr<VoxelStorage> clone() const override { return std::make_unique<ChunkedVoxelStorage>(*this); }
+
+    MaterialId getVoxel(const glm::ivec3& position) const override;
+    void setVoxel(const glm::ivec3& position, MaterialId material) override;
+    size_t getVoxelCount() const override { return voxelCount; }
+    // Chunk coordinates are Morton keys, so chunks cover [-2^20, 2^20) chunks per axis
+    glm::ivec3 getMinPosition() const override { return glm::ivec3(-(Morton::BIAS << VoxelChunk::SHIFT)); }
+    glm::ivec3 getMaxPosition() const override { return glm::ivec3((Morton::BIAS << VoxelChunk::SHIFT) - 1); }
+
+    void forEachVoxel(const glm::ivec3& regionMin, const glm::ivec3& regionMax, const VoxelVisitor& visitor) const override;
+    bool hasChunk(const glm::ivec3& chunkPos) const override { return chunks.contains(chunkPos); }
+    void forEachChunk(const ChunkVisitor& visitor) const override;
+    void readRegion(const glm::ivec3& regionMin, const glm::ivec3& extent, MaterialId* out) const override;
+
+    const VoxelChunk* findChunk(const glm::ivec3& chunkPos) const;
+    size_t getChunkCount() const { return chunks.size(); }
+
+private:
+    VoxelHashMap<std::shared_ptr<VoxelChunk>> chunks;
+    size_t voxelCount;
+
+    static VoxelChunk& writable(std::shared_ptr<VoxelChunk>& chunk);
+};
+
+#endif
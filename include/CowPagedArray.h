@@ -0,0 +1,87 @@
+#ifndef COWPAGEDARRAY_H
+#define COWPAGEDARRAY_H
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <algorithm>
+#include <cstddef>
+
+// Array split into fixed-size pages that copies share. Copying the array only
+// copies the page table, and the first write to a page that another copy still
+// references clones that one page, so a copy costs O(pages) instead of
+// O(elements) and never sees later writes to the original. Used by the dense
+// grid and the octree so their snapshots stay as cheap as the chunked backend's.
+template <typename T, int PAGE_SHIFT>
+class CowPagedArray {
+public:
+    static constexpr size_t PAGE_SIZE = size_t(1) << PAGE_SHIFT;
+    static constexpr size_t PAGE_MASK = PAGE_SIZE - 1;
+
+    CowPagedArray() : count(0) {}
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    size_t getPageCount() const { return pages.size(); }
+
+    // Every page starts out as the same shared page, so a fresh array costs one page of memory
+    void assign(size_t newCount, const T& value) {
+        std::shared_ptr<Page> filled = std::make_shared<Page>();
+        std::fill(filled->items, filled->items + PAGE_SIZE, value);
+        pages.assign((newCount + PAGE_MASK) >> PAGE_SHIFT, filled);
+        count = newCount;
+    }
+
+    void push_back(const T& value) {
+        if ((count & PAGE_MASK) == 0) {
+            pages.push_back(std::make_shared<Page>());
+        }
+        writablePage(count >> PAGE_SHIFT).items[count & PAGE_MASK] = value;
+        ++count;
+    }
+
+    const T& operator[](size_t index) const { return pages[index >> PAGE_SHIFT]->items[index & PAGE_MASK]; }
+
+    // Reference for writing, cloning the page first if another copy still shares it
+    T& write(size_t index) { return writablePage(index >> PAGE_SHIFT).items[index & PAGE_MASK]; }
+
+    // The elements [first, last] as one contiguous run, or nullptr if they cross a page boundary
+    const T* span(size_t first, size_t last) const {
+        return (first >> PAGE_SHIFT) == (last >> PAGE_SHIFT) ? pages[first >> PAGE_SHIFT]->items + (first & PAGE_MASK) : nullptr;
+    }
+
+    // Copies count elements starting at first into out, across page boundaries
+    void read(size_t first, size_t length, T* out) const {
+        while (length > 0) {
+            size_t offset = first & PAGE_MASK;
+            size_t run = std::min(length, PAGE_SIZE - offset);
+            const T* items = pages[first >> PAGE_SHIFT]->items + offset;
+            std::copy(items, items + run, out);
+            first += run;
+            out += run;
+            length -= run;
+        }
+    }
+
+private:
+    struct Page {
+        T items[PAGE_SIZE];
+    };
+
+    std::vector<std::shared_ptr<Page>> pages;
+    size_t count;
+
+    Page& writablePage(size_t page) {
+        std::shared_ptr<Page>& target = pages[page];
+        if (target.use_count() > 1) {
+            target = std::make_shared<Page>(*target);
+        } else {
+            // A reader on another thread may just have dropped the last other reference;
+            // its final reads of the page must happen before we write to it
+            std::atomic_thread_fence(std::memory_order_acquire);
+        }
+        return *target;
+    }
+};
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef DENSEGRIDSTORAGE_H
+#define DENSEGRIDSTORAGE_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "VoxelStorage.h"
+#include "CowPagedArray.h"
+
+// Flat array covering [0, size) on every axis, for small bounded models.
+// The array carries a one voxel border that is always empty, so a cell's six
+// neighbours are always at fixed offsets (+-1, +-strideY, +-strideZ) with no
+// bounds checks, and rows are contiguous so regions copy a row at a time.
+// Cells live in copy-on-write pages, so clone() costs O(pages) rather than
+// O(size^3) and a snapshot only pays for the pages edited after it was taken.
+class DenseGridStorage : public VoxelStorage {
+public:
+    explicit DenseGridStorage(int size);
+
+    std::unique_ptr<VoxelStorage> clone() const override { return std::make_unique<DenseGridStorage>(*this); } // Shares every page
+
+    MaterialId getVoxel(const glm::ivec3& position) const override {
+        return contains(position) ? cells[cellIndex(position)] : MaterialRegistry::NONE;
+    }
+    void setVoxel(const glm::ivec3& position, MaterialId material) override;
+    size_t getVoxelCount() const override { return voxelCount; }
+    glm::ivec3 getMinPosition() const override { return glm::ivec3(0); }
+    glm::ivec3 getMaxPosition() const override { return glm::ivec3(size - 1); }
+
+    void forEachVoxel(const glm::ivec3& regionMin, const glm::ivec3& regionMax, const VoxelVisitor& visitor) const override;
+    bool hasChunk(const glm::ivec3& chunkPos) const override;
+    void forEachChunk(const ChunkVisitor& visitor) const override;
+    void readRegion(const glm::ivec3& regionMin, const glm::ivec3& extent, MaterialId* out) const override;
+
+    int getSize() const { return size; }
+    bool contains(const glm::ivec3& position) const {
+        return static_cast<unsigned>(position.x) < static_cast<unsigned>(size)
+            && static_cast<unsigned>(position.y) < static_cast<unsigned>(size)
+            && static_cast<unsigned>(position.z) < static_cast<unsigned>(size);
+    }
+
+    // Index into the bordered cell array; valid for positions in [-1, size]
+    size_t cellIndex(const glm::ivec3& position) const {
+        return (position.x + 1) + (position.y + 1) * strideY + (position.z + 1) * strideZ;
+    }
+    size_t getStrideY() const { return strideY; }
+    size_t getStrideZ() const { return strideZ; }
+
+private:
+    int size;
+    size_t strideY;
+    size_t strideZ;
+    CowPagedArray<MaterialId, 15> cells; // 64 KB pages, about one per 32^3 chunk
+    int chunksPerAxis;
+    std::vector<uint32_t> chunkCounts; // Filled voxels per VoxelChunk-sized cell, so empty chunks are skipped
+    size_t voxelCount;
+};
+
+#endif
@@ -3,9 +3,8 @@
 
 #include <glm/glm.hpp>
 #include <vector>
-#include <unordered_set>
 #include "VoxelWorld.h"
-#include "glm_hash.h"
+#include "VoxelHashMap.h"
 
 class ExtrusionManager {
 public:
@@ -14,7 +13,7 @@ public:
     void endExtrusion(VoxelWorld& voxelWorld);
     bool isExtruding() const;
     glm::ivec3 getExtrusionStart() const;
-    void setSelectedVoxels(const std::unordered_set<glm::ivec3>& selectedVoxels);
+    void setSelectedVoxels(const VoxelHashSet& selectedVoxels);
     void clearSelectedVoxels();
 
 private:
@@ -24,8 +23,8 @@ private:
     glm::dvec2 initialMousePos;
     bool extruding = false;
     int currentLayers = 0;
-    std::unordered_set<glm::ivec3> newVoxels;
-    std::unordered_set<glm::ivec3> selectedVoxels;
+    VoxelHashSet newVoxels;
+    VoxelHashSet selectedVoxels;
     void addVoxels(int layers, VoxelWorld& voxelWorld);
     void removeVoxels(int layers, VoxelWorld& voxelWorld);
     void ExtrusionManager::drawVector(const glm::dvec2& start, const glm::dvec2& end, const glm::vec3& color);
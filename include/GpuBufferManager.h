@@ -0,0 +1,98 @@
+#ifndef GPUBUFFERMANAGER_H
+#define GPUBUFFERMANAGER_H
+
+#include <vector>
+#include <cstdint>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "ChunkMesher.h"
+#include "VoxelHashMap.h"
+#include "ChunkCuller.h"
+
+// One level of detail inside a chunk's buffers; the full detail mesh is level 0
+struct ChunkLevel {
+    GLint baseVertex;
+    std::vector<TextureRange> textureRanges; // firstIndex already counts from the start of the EBO
+};
+
+// GPU copy of one chunk's mesh, all levels of detail back to back in one VBO and EBO.
+// Level 0 comes first, so recolour patches still index the VBO directly.
+struct ChunkBuffers {
+    GLuint VAO;
+    GLuint VBO;
+    GLuint EBO;
+    GLsizei indexCount;
+    size_t vertexCapacity; // Allocated sizes in elements; the buffers are only reallocated to grow, or when mostly unused
+    size_t indexCapacity;
+    std::vector<ChunkLevel> levels;
+    bool smooth; // Vertex encoding, see ChunkMesh::smooth
+    uint64_t generation; // ChunkMesh::generation of the mesh in the buffers
+    uint32_t box; // Index of the chunk's bounds in GpuBufferManager's culler
+};
+
+// Staging memory that uploads go through on their way to the chunk buffers, which the GPU
+// then copies over itself, so the CPU never waits for a buffer a draw is still reading.
+// With ARB_buffer_storage it is mapped once and split into one region per frame in flight,
+// each guarded by a fence; without it, the buffer is orphaned at the start of every frame.
+class StreamBuffer {
+public:
+    static constexpr int FRAMES = 3;
+
+    StreamBuffer();
+
+    void create(size_t bytesPerFrame); // Needs a current context
+    void destroy();
+    // Copies data to target at offset (in bytes) through the ring; false if this frame's
+    // region is full, and the caller has to upload it some other way
+    bool copyTo(GLuint target, size_t offset, const void* data, size_t bytes);
+    void endFrame();
+    bool isPersistent() const { return persistent; }
+
+private:
+    GLuint buffer;
+    unsigned char* mapped; // Whole buffer, persistent mapping only
+    size_t regionSize;
+    size_t head; // Next free byte of the current region
+    int frame;   // Region in use, 0 to FRAMES - 1
+    bool frameStarted;
+    bool persistent;
+    GLsync fences[FRAMES];
+
+    void beginFrame();
+};
+
+// Owns the buffers of every chunk mesh and keeps them in step with the world's meshes.
+// Each mesh carries a generation that changes whenever its contents do, and a chunk is
+// only uploaded when its generation differs from the one already in its buffers.
+class GpuBufferManager {
+public:
+    static constexpr size_t STREAM_BYTES_PER_FRAME = size_t(16) << 20;
+
+    void create(); // Needs a current context
+    void destroy(); // Frees every buffer
+
+    // Uploads the mesh unless the chunk's buffers already hold its generation; false if skipped
+    bool upload(const glm::ivec3& chunkPos, const ChunkMesh& mesh);
+    // Rewrites vertices [firstVertex, firstVertex + vertexCount) of the full detail level in place
+    void patch(const glm::ivec3& chunkPos, const ChunkMesh& mesh, uint32_t firstVertex, uint32_t vertexCount);
+    void release(const glm::ivec3& chunkPos);
+    void endFrame(); // Call once per frame after the draws
+
+    const VoxelHashMap<ChunkBuffers>& getChunkBuffers() const { return chunks; }
+    const ChunkBuffers* find(const glm::ivec3& chunkPos) const { return chunks.find(chunkPos); }
+    // Replaces visible with the chunks whose bounds reach into the frustum, so drawing costs
+    // what is on screen rather than what is loaded
+    void findVisible(const Frustum& frustum, std::vector<glm::ivec3>& visible);
+
+private:
+    VoxelHashMap<ChunkBuffers> chunks;
+    StreamBuffer stream;
+    ChunkCuller culler;
+    std::vector<glm::ivec3> boxChunks; // Chunk of each culler box
+    std::vector<uint32_t> visibleBoxes;
+
+    void write(GLuint target, size_t offset, const void* data, size_t bytes);
+    static void releaseBuffers(ChunkBuffers& buffers);
+};
+
+#endif
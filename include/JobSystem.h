@@ -0,0 +1,57 @@
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+// Fixed pool of worker threads with one job queue each. A worker takes jobs from
+// the front of its own queue and, once that runs dry, steals from the back of the
+// others, so uneven jobs (a full chunk next to an empty one) still keep every core busy.
+// The thread calling parallelFor works as worker 0 until its batch is done.
+class JobSystem {
+public:
+    // Shared by every world; sized to the machine
+    static JobSystem& global();
+
+    // threadCount extra threads next to the caller; 0 picks one per core
+    explicit JobSystem(unsigned threadCount = 0);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // Worker indices passed to jobs run from 0 to getWorkerCount() - 1, so callers
+    // can keep per-worker scratch space in a plain vector
+    unsigned getWorkerCount() const { return static_cast<unsigned>(queues.size()); }
+
+    // Runs job(index, worker) for every index in [0, count) and returns once all have finished.
+    // Jobs must not call parallelFor themselves.
+    void parallelFor(size_t count, const std::function<void(size_t index, unsigned worker)>& job);
+
+private:
+    using Job = std::function<void(unsigned worker)>;
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues; // One per worker, 0 belongs to the caller
+    std::vector<std::thread> threads;
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    std::atomic<size_t> queued; // Jobs pushed but not yet taken
+    bool stopping;              // Guarded by wakeMutex
+    std::mutex batchMutex;      // One parallelFor at a time
+
+    bool runOne(unsigned worker);
+    void workerLoop(unsigned worker);
+};
+
+#endif
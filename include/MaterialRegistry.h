@@ -0,0 +1,83 @@
+#ifndef MATERIALREGISTRY_H
+#define MATERIALREGISTRY_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+#include <unordered_map>
+#include <glm/glm.hpp>
+
+using MaterialId = uint16_t;
+using TextureId = uint16_t;
+
+struct Material {
+    int type;
+    glm::vec3 color;
+    TextureId texture;
+    uint64_t hash; // Of type, colour and texture name, so unlike the id it is the same in every run
+};
+
+// Global table of every distinct (type, color, texture) combination in use.
+// Voxels refer to materials by a 16-bit id, so bulk edits never touch strings
+// and all voxels with the same look share one entry and one texture handle.
+class MaterialRegistry {
+public:
+    static constexpr MaterialId NONE = 0; // Reserved, never handed out for a real material
+    static constexpr size_t MAX_MATERIALS = 65536;
+
+    static MaterialRegistry& global();
+
+    MaterialRegistry();
+
+    // Returns the id for this material, registering it on first use. Never returns NONE: once
+    // the registry is full the closest existing material is returned instead.
+    MaterialId getMaterial(int type, const glm::vec3& color, TextureId texture);
+    MaterialId getMaterial(int type, const glm::vec3& color, const std::string& texture);
+    TextureId getTexture(const std::string& name);
+
+    // Entries never move once registered, so references stay valid while other threads register materials
+    const Material& get(MaterialId id) const { return blocks[id >> BLOCK_SHIFT][id & BLOCK_MASK]; }
+    std::string getTextureName(TextureId id) const;
+    unsigned int getTextureHandle(TextureId id) const;
+    void setTextureHandle(TextureId id, unsigned int handle);
+    size_t size() const { return count.load(std::memory_order_acquire); }
+
+    static glm::vec3 colorFromName(const std::string& name);
+
+private:
+    static constexpr int BLOCK_SHIFT = 8;
+    static constexpr int BLOCK_MASK = (1 << BLOCK_SHIFT) - 1;
+
+    struct MaterialKey {
+        int type;
+        glm::vec3 color;
+        TextureId texture;
+        bool operator==(const MaterialKey& other) const {
+            return type == other.type && color == other.color && texture == other.texture;
+        }
+    };
+
+    struct MaterialKeyHasher {
+        std::size_t operator()(const MaterialKey& key) const;
+    };
+
+    struct TextureEntry {
+        std::string name;
+        unsigned int handle; // GL texture name, 0 until the renderer loads it
+    };
+
+    std::unique_ptr<Material[]> blocks[MAX_MATERIALS >> BLOCK_SHIFT];
+    std::atomic<size_t> count;
+    std::unordered_map<MaterialKey, MaterialId, MaterialKeyHasher> lookup;
+    std::vector<TextureEntry> textures;
+    std::unordered_map<std::string, TextureId> textureLookup;
+    mutable std::mutex mutex;
+    bool reportedFull;
+
+    MaterialId findClosest(const MaterialKey& key) const;
+};
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <cstdint>
+#include <unordered_map>
+#include "ChunkMesher.h"
+
+// Chunk meshes by the voxels they were built from, so a chunk whose content comes back
+// (undo, redo, switching the meshing mode back, reopening a scene) skips meshing. A mesh
+// depends only on its chunk, the one voxel border around it and the meshing settings, and
+// the key covers exactly those. The most recently used meshes stay in memory up to a byte
+// budget. With a directory set, misses are looked up on disk too, and save writes meshes
+// there for the next run. Thread-safe: all meshers of a pipeline share one cache.
+class MeshCache {
+public:
+    static constexpr size_t DEFAULT_MEMORY_BUDGET = size_t(128) << 20;
+    static constexpr uint64_t DEFAULT_DISK_BUDGET = uint64_t(512) << 20;
+
+    MeshCache();
+
+    MeshCache(const MeshCache&) = delete;
+    MeshCache& operator=(const MeshCache&) = delete;
+
+    // Key of a padded block as ChunkMesher reads it, ChunkMesher::PADDED voxels per side.
+    // Materials go in by content rather than id, so keys stay valid from run to run.
+    // Never 0, which ChunkMesh::contentKey keeps for "unknown".
+    static uint64_t contentKey(const MaterialId* block, MeshingMode mode, int lodLevels);
+
+    // Copies the mesh stored under key into mesh; false on a miss
+    bool find(uint64_t key, ChunkMesh& mesh);
+    void store(uint64_t key, const ChunkMesh& mesh);
+    // Writes the mesh to the directory unless it is there already. Call trimDirectory after a batch of saves.
+    void save(uint64_t key, const ChunkMesh& mesh);
+    // Deletes the least recently used files until the directory fits its budget
+    void trimDirectory();
+    void clear(); // Drops the meshes in memory; the directory is left alone
+
+    void setMemoryBudget(size_t bytes); // 0 turns the cache off
+    void setDirectory(const std::string& path); // "" (the default) turns the disk cache off
+    void setDiskBudget(uint64_t bytes);
+    size_t getMemoryUsed() const;
+    size_t getHits() const;   // Since construction, from memory or disk
+    size_t getMisses() const;
+
+private:
+    struct Entry {
+        uint64_t key;
+        std::shared_ptr<const ChunkMesh> mesh; // Shared, so find can copy it out after unlocking
+        size_t bytes;
+    };
+
+    mutable std::mutex mutex;
+    std::list<Entry> entries; // Most recently used first
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> lookup;
+    size_t memoryBudget;
+    size_t memoryUsed;
+    std::string directory;
+    uint64_t diskBudget;
+    size_t hits;
+    size_t misses;
+
+    // Both need the caller to hold the lock
+    void insert(uint64_t key, std::shared_ptr<const ChunkMesh> mesh);
+    void evictOverBudget();
+    std::string pathFor(const std::string& dir, uint64_t key) const;
+};
+
+#endif
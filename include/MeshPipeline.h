@@ -0,0 +1,74 @@
+#ifndef MESHPIPELINE_H
+#define MESHPIPELINE_H
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <glm/glm.hpp>
+#include "ChunkMesher.h"
+#include "MeshCache.h"
+
+struct VoxelSnapshot;
+
+// Meshes batches of chunks with one ChunkMesher per job system worker, either right
+// away on the calling thread or in the background from a snapshot. Background batches
+// run one at a time: submit one, then collect the meshes with takeFinished before
+// submitting the next. The owner must not call meshNow while a batch is in flight.
+class MeshPipeline {
+public:
+    MeshPipeline();
+    ~MeshPipeline();
+
+    MeshPipeline(const MeshPipeline&) = delete;
+    MeshPipeline& operator=(const MeshPipeline&) = delete;
+
+    // Meshes every chunk into meshes (same order) on this thread and the job system's workers,
+    // each with lodLevels coarse meshes, see ChunkMesher::setLodLevels
+    void meshNow(const VoxelStorage& storage, MeshingMode mode, int lodLevels, const std::vector<glm::ivec3>& chunks, std::vector<ChunkMesh>& meshes);
+    // Rebuilds only the coarse meshes of one chunk on this thread. Has a mesher of its own,
+    // so the owner may call it while a batch is in flight.
+    void meshLodsNow(const VoxelStorage& storage, MeshingMode mode, int lodLevels, const glm::ivec3& chunkPos, ChunkMesh& mesh);
+
+    // Meshes the chunks of source on the background thread. The snapshot keeps the
+    // voxels it reads frozen while the world goes on editing.
+    void submit(std::shared_ptr<const VoxelSnapshot> source, MeshingMode mode, int lodLevels, std::vector<glm::ivec3> chunks);
+    // A batch is queued, running, or finished but not yet taken
+    bool isBusy() const;
+    // Moves out the finished batch; false if there is none (yet)
+    bool takeFinished(std::vector<glm::ivec3>& chunks, std::vector<ChunkMesh>& meshes);
+    // Blocks until the submitted batch, if any, has finished
+    void wait();
+
+    // Shared by the meshers of meshNow and of background batches alike
+    MeshCache& getCache() { return cache; }
+
+private:
+    enum BatchState {
+        BATCH_NONE,
+        BATCH_QUEUED,
+        BATCH_RUNNING,
+        BATCH_FINISHED
+    };
+
+    MeshCache cache;
+    std::vector<ChunkMesher> meshers; // One per job system worker, created on first use
+    std::unique_ptr<ChunkMesher> lodMesher; // For meshLodsNow, created on first use
+
+    std::thread thread; // Started by the first submit
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    BatchState state;
+    bool stopping;
+    std::shared_ptr<const VoxelSnapshot> source;
+    MeshingMode batchMode;
+    int batchLodLevels;
+    std::vector<glm::ivec3> batchChunks;
+    std::vector<ChunkMesh> batchMeshes;
+
+    void run();
+};
+
+#endif
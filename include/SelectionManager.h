@@ -3,9 +3,8 @@
 
 #include <glm/glm.hpp>
 #include <vector>
-#include <unordered_set>
 #include "VoxelWorld.h"
-#include "glm_hash.h" // Include custom hash header
+#include "VoxelHashMap.h"
 
 class SelectionManager {
 public:
@@ -21,8 +20,8 @@ private:
     glm::ivec3 selectionStart;
     glm::ivec3 selectionEnd;
     bool selecting;
-    std::unordered_set<glm::ivec3> selectedVoxels;
-    std::unordered_set<glm::ivec3> highlightedVoxels;
+    VoxelHashSet selectedVoxels;
+    VoxelHashSet highlightedVoxels;
 };
 
 
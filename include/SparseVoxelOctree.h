@@ -0,0 +1,81 @@
+#ifndef SPARSEVOXELOCTREE_H
+#define SPARSEVOXELOCTREE_H
+
+#include <vector>
+#include <cstdint>
+#include "VoxelStorage.h"
+#include "CowPagedArray.h"
+
+// Octree over the same coordinate range as the Morton keys, [-2^20, 2^20) per
+// axis. Every child slot either points at another node or holds one material
+// for its whole cube, so open air and solid interiors collapse into a single
+// slot no matter how large they are and memory follows the surface area.
+// Edits split collapsed cubes on the way down and merge children that became
+// uniform again on the way back up.
+//
+// Nodes live in copy-on-write pages and freed nodes form a list threaded through
+// the nodes themselves, so clone() costs O(pages) and an edit after a snapshot
+// only copies the pages on the path it touches.
+class SparseVoxelOctree : public VoxelStorage {
+public:
+    static constexpr int LEVELS = 21; // The root cube is 2^LEVELS voxels wide
+    static constexpr int32_t ORIGIN = -(1 << (LEVELS - 1));
+
+    // Called once per uniform filled cube, already clipped to the requested region
+    using BoxVisitor = std::function<void(const glm::ivec3& boxMin, const glm::ivec3& boxMax, MaterialId material)>;
+
+    SparseVoxelOctree();
+
+    std::unique_ptr<VoxelStorage> clone() const override { return std::make_unique<SparseVoxelOctree>(*this); }
+
+    MaterialId getVoxel(const glm::ivec3& position) const override;
+    void setVoxel(const glm::ivec3& position, MaterialId material) override;
+    size_t getVoxelCount() const override { return voxelCount; }
+    glm::ivec3 getMinPosition() const override { return glm::ivec3(ORIGIN); }
+    glm::ivec3 getMaxPosition() const override { return glm::ivec3(ORIGIN + (1 << LEVELS) - 1); }
+
+    void forEachVoxel(const glm::ivec3& regionMin, const glm::ivec3& regionMax, const VoxelVisitor& visitor) const override;
+    bool hasChunk(const glm::ivec3& chunkPos) const override;
+    void forEachChunk(const ChunkVisitor& visitor) const override;
+    void readRegion(const glm::ivec3& regionMin, const glm::ivec3& extent, MaterialId* out) const override;
+
+    void forEachBox(const glm::ivec3& regionMin, const glm::ivec3& regionMax, const BoxVisitor& visitor) const;
+    size_t getNodeCount() const { return nodes.size() - freeCount; }
+
+    static bool inRange(const glm::ivec3& position) {
+        return static_cast<uint32_t>(position.x - ORIGIN) < (1u << LEVELS)
+            && static_cast<uint32_t>(position.y - ORIGIN) < (1u << LEVELS)
+            && static_cast<uint32_t>(position.z - ORIGIN) < (1u << LEVELS);
+    }
+
+private:
+    static constexpr uint32_t UNIFORM = 0x80000000u; // Slot holds a material in its low bits instead of a node index
+    static constexpr uint32_t NO_NODE = 0xFFFFFFFFu;
+
+    struct Node {
+        uint32_t children[8]; // Child i sits at offset (i & 1, (i >> 1) & 1, i >> 2) * half the node width
+    };
+
+    CowPagedArray<Node, 8> nodes; // 8 KB pages
+    uint32_t freeHead; // First free node, whose children[0] links to the next; NO_NODE when none
+    size_t freeCount;
+    uint32_t root;
+    size_t voxelCount;
+
+    static bool isUniform(uint32_t slot) { return (slot & UNIFORM) != 0; }
+    static uint32_t uniformSlot(MaterialId material) { return UNIFORM | material; }
+    static MaterialId slotMaterial(uint32_t slot) { return static_cast<MaterialId>(slot & 0xFFFF); }
+    // Which child of a node 2^level wide contains the position, given its offset from ORIGIN
+    static int childIndex(const glm::uvec3& offset, int level) {
+        int shift = level - 1;
+        return ((offset.x >> shift) & 1) | (((offset.y >> shift) & 1) << 1) | (((offset.z >> shift) & 1) << 2);
+    }
+
+    uint32_t allocateNode(uint32_t fill);
+    void freeNode(uint32_t index);
+    uint32_t& slotRef(uint32_t parent, int child) { return child < 0 ? root : nodes.write(parent).children[child]; }
+    void visitBoxes(uint32_t slot, int level, const glm::ivec3& nodeMin, const glm::ivec3& regionMin, const glm::ivec3& regionMax, const BoxVisitor& visitor) const;
+    void visitChunks(uint32_t slot, int level, const glm::ivec3& nodeMin, const ChunkVisitor& visitor) const;
+};
+
+#endif
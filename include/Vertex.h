@@ -0,0 +1,55 @@
+#ifndef VERTEX_H
+#define VERTEX_H
+
+#include <cstdint>
+
+// Vertex layout shared by the mesher and the renderer; kept free of GL so meshing code can run without a context
+struct Vertex {
+    float x, y, z;
+    float r, g, b;
+    float nx, ny, nz;
+    float u, v;
+    bool selected;
+    Vertex(float x, float y, float z, float r, float g, float b, float nx = 0.0f, float ny = 0.0f, float nz = 0.0f, float u = 0.0f, float v = 0.0f, bool selected = false)
+        : x(x), y(y), z(z), r(r), g(g), b(b), nx(nx), ny(ny), nz(nz), u(u), v(v), selected(selected) {}
+};
+
+// Chunk mesh vertex, 8 bytes. Position is a voxel corner relative to the chunk
+// origin (0..32 per axis), so the vertex shader rebuilds the world position, the
+// normal (from the face) and the UVs (corner / 5) from these bits:
+//   position: x 0-5, y 6-11, z 12-17, face 18-20, ao 21-22
+//   material: MaterialId in bits 0-15, the shader looks its colour up in a palette
+// Smooth meshes (MESH_SMOOTH) use the words differently, see ChunkMesh::smooth:
+//   position: x 0-9, y 10-19, z 20-29 in 1/16 voxel, measured from one voxel below the chunk origin
+//   material: MaterialId in bits 0-15, normal in 16-31 as two 8-bit octahedral coordinates
+// Selection and highlight are not part of the mesh; the fragment shader looks them up per voxel.
+struct PackedVertex {
+    uint32_t position;
+    uint32_t material;
+
+    // Leaves both words unset, so buffers of vertices about to be written are cheap to size
+    PackedVertex() = default;
+
+    static PackedVertex fromWords(uint32_t position, uint32_t material) {
+        PackedVertex vertex(0, 0, 0, 0, 0, 0);
+        vertex.position = position;
+        vertex.material = material;
+        return vertex;
+    }
+
+    PackedVertex(uint32_t x, uint32_t y, uint32_t z, uint32_t face, uint32_t ao, uint32_t material)
+        : position(x | y << 6 | z << 12 | face << 18 | ao << 21), material(material) {}
+
+    uint32_t getX() const { return position & 63; }
+    uint32_t getY() const { return (position >> 6) & 63; }
+    uint32_t getZ() const { return (position >> 12) & 63; }
+    uint32_t getFace() const { return (position >> 18) & 7; }
+    uint32_t getAo() const { return (position >> 21) & 3; }
+
+    // 0 for an open corner up to 3 for one tucked into a crease
+    void setAo(uint32_t ao) { position = (position & ~(3u << 21)) | ao << 21; }
+};
+
+static_assert(sizeof(PackedVertex) == 8, "PackedVertex must stay two words");
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef VOXELCHUNK_H
+#define VOXELCHUNK_H
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "BitUtils.h"
+#include "MaterialRegistry.h"
+
+// Fixed-size block of voxels. The world is split into these so that
+// neighbour tests inside a chunk are plain array lookups instead of hash probes.
+//
+// Storage is palette compressed: an occupancy bitset says which slots are
+// filled and a bit-packed array holds each voxel's index into a small local
+// palette of MaterialIds. The index width grows through 0/1/2/4/8/16 bits as
+// the palette grows, so a chunk made of one material costs a single bit per voxel.
+// Once fewer than half of the palette entries are still in use the palette is
+// compacted and the width shrinks again, so overwritten chunks do not stay wide.
+class VoxelChunk {
+public:
+    static constexpr int SHIFT = 5;
+    static constexpr int SIZE = 1 << SHIFT; // 32 voxels per side
+    static constexpr int MASK = SIZE - 1;
+    static constexpr int VOLUME = SIZE * SIZE * SIZE;
+    static constexpr int WORDS = VOLUME / 64; // 64-bit words in a one-bit-per-voxel mask
+
+    VoxelChunk();
+
+    // x varies fastest, then y, then z
+    static int localIndex(int x, int y, int z) { return x | (y << SHIFT) | (z << (2 * SHIFT)); }
+    static int localIndex(const glm::ivec3& local) { return localIndex(local.x, local.y, local.z); }
+    static glm::ivec3 localPosition(int index) { return glm::ivec3(index & MASK, (index >> SHIFT) & MASK, index >> (2 * SHIFT)); }
+    static bool contains(const glm::ivec3& local) { return ((local.x | local.y | local.z) & ~MASK) == 0; }
+
+    // Arithmetic shifts floor towards negative infinity, so negative coordinates map correctly
+    static glm::ivec3 chunkCoord(const glm::ivec3& position) { return glm::ivec3(position.x >> SHIFT, position.y >> SHIFT, position.z >> SHIFT); }
+    static glm::ivec3 localCoord(const glm::ivec3& position) { return glm::ivec3(position.x & MASK, position.y & MASK, position.z & MASK); }
+    static glm::ivec3 chunkOrigin(const glm::ivec3& chunkPos) { return chunkPos * SIZE; }
+
+    bool hasVoxel(int index) const { return (occupancy[index >> 6] >> (index & 63)) & 1; }
+    // Occupancy of the 32 voxels along x at (y, z), bit x set when filled
+    uint32_t getRowOccupancy(int y, int z) const {
+        int index = localIndex(0, y, z);
+        return static_cast<uint32_t>(occupancy[index >> 6] >> (index & 63));
+    }
+    MaterialId getMaterial(int index) const { return palette[getPaletteIndex(index)]; }
+    void setVoxel(int index, MaterialId material);
+    bool removeVoxel(int index);
+
+    int getVoxelCount() const { return voxelCount; }
+    bool isEmpty() const { return voxelCount == 0; }
+    int getBitsPerIndex() const { return bitsPerIndex; }
+    size_t getPaletteSize() const { return palette.size(); }
+
+    // Calls fn(index) for every occupied slot, skipping empty 64-voxel runs at once
+    template <typename Fn>
+    void forEachVoxel(Fn fn) const {
+        for (int word = 0; word < WORDS; ++word) {
+            uint64_t bits = occupancy[word];
+            while (bits) {
+                int index = word * 64 + countTrailingZeros(bits);
+                bits &= bits - 1;
+                fn(index);
+            }
+        }
+    }
+
+private:
+    std::vector<uint64_t> occupancy;
+    std::vector<uint64_t> packedIndices;
+    std::vector<MaterialId> palette;
+    std::vector<uint32_t> paletteRefCounts; // Entries that drop to zero are reused before the palette grows
+    int liveEntries; // Palette entries with a non-zero ref count
+    int bitsPerIndex;
+    int voxelCount;
+
+    uint32_t getPaletteIndex(int index) const;
+    void setPaletteIndex(int index, uint32_t paletteIndex);
+    uint32_t findOrAddPaletteEntry(MaterialId material);
+    void repackIndices(int newBits, const std::vector<uint32_t>* remap);
+    void retainEntry(uint32_t paletteIndex);
+    void releaseEntry(uint32_t paletteIndex);
+    void compactPalette();
+};
+
+#endif
@@ -0,0 +1,354 @@
+#ifndef VOXELHASHMAP_H
+#define VOXELHASHMAP_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <iterator>
+#include <utility>
+#include <type_traits>
+#include <iostream>
+#include <cassert>
+#include <glm/glm.hpp>
+
+// Interleaves the bits of a coordinate into a single 64-bit key (21 bits per
+// axis). Coordinates are biased so the usable range is [-2^20, 2^20) per axis.
+namespace Morton {
+    constexpr int BITS = 21;
+    constexpr int32_t BIAS = 1 << (BITS - 1);
+
+    inline uint64_t spreadBits(uint32_t value) {
+        uint64_t x = value & 0x1fffff;
+        x = (x | x << 32) & 0x001f00000000ffffull;
+        x = (x | x << 16) & 0x001f0000ff0000ffull;
+        x = (x | x << 8) & 0x100f00f00f00f00full;
+        x = (x | x << 4) & 0x10c30c30c30c30c3ull;
+        x = (x | x << 2) & 0x1249249249249249ull;
+        return x;
+    }
+
+    inline uint32_t compactBits(uint64_t x) {
+        x &= 0x1249249249249249ull;
+        x = (x ^ (x >> 2)) & 0x10c30c30c30c30c3ull;
+        x = (x ^ (x >> 4)) & 0x100f00f00f00f00full;
+        x = (x ^ (x >> 8)) & 0x001f0000ff0000ffull;
+        x = (x ^ (x >> 16)) & 0x001f00000000ffffull;
+        x = (x ^ (x >> 32)) & 0x1fffff;
+        return static_cast<uint32_t>(x);
+    }
+
+    inline bool inRange(const glm::ivec3& p) {
+        return static_cast<uint32_t>(p.x + BIAS) < (1u << BITS)
+            && static_cast<uint32_t>(p.y + BIAS) < (1u << BITS)
+            && static_cast<uint32_t>(p.z + BIAS) < (1u << BITS);
+    }
+
+    // Out of range coordinates would alias other keys, so callers must check inRange first
+    inline uint64_t encode(const glm::ivec3& p) {
+        assert(inRange(p) && "Morton::encode coordinate outside [-2^20, 2^20)");
+        return spreadBits(static_cast<uint32_t>(p.x + BIAS))
+            | (spreadBits(static_cast<uint32_t>(p.y + BIAS)) << 1)
+            | (spreadBits(static_cast<uint32_t>(p.z + BIAS)) << 2);
+    }
+
+    inline glm::ivec3 decode(uint64_t code) {
+        return glm::ivec3(static_cast<int32_t>(compactBits(code)) - BIAS,
+                          static_cast<int32_t>(compactBits(code >> 1)) - BIAS,
+                          static_cast<int32_t>(compactBits(code >> 2)) - BIAS);
+    }
+}
+
+// Flat open-addressing map from voxel coordinates to T using Robin Hood
+// probing. Keys are stored as Morton codes; a separate byte per slot holds the
+// probe distance (0 = empty) so most probes never touch the key array.
+// Erasing uses backward shifting, so there are no tombstones to clean up.
+template <typename T>
+class VoxelHashMap {
+public:
+    template <bool Const>
+    class Iterator {
+    public:
+        using Map = typename std::conditional<Const, const VoxelHashMap, VoxelHashMap>::type;
+        using Value = typename std::conditional<Const, const T, T>::type;
+
+        struct Entry {
+            glm::ivec3 first;
+            Value& second;
+        };
+
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Entry;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = Entry;
+
+        Iterator(Map* map, size_t slot) : map(map), slot(slot) { skipEmpty(); }
+        Entry operator*() const { return Entry{ Morton::decode(map->keys[slot]), map->values[slot] }; }
+        Iterator& operator++() { ++slot; skipEmpty(); return *this; }
+        bool operator==(const Iterator& other) const { return slot == other.slot; }
+        bool operator!=(const Iterator& other) const { return slot != other.slot; }
+
+    private:
+        Map* map;
+        size_t slot;
+        void skipEmpty() { while (slot < map->distances.size() && map->distances[slot] == 0) ++slot; }
+    };
+
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    VoxelHashMap() : count(0), shift(64) {}
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, distances.size()); }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, distances.size()); }
+
+    // Keys outside Morton's range are never stored, so looking one up always misses
+    T* find(const glm::ivec3& key) {
+        size_t slot = findKey(key);
+        return slot != NOT_FOUND ? &values[slot] : nullptr;
+    }
+
+    const T* find(const glm::ivec3& key) const {
+        size_t slot = findKey(key);
+        return slot != NOT_FOUND ? &values[slot] : nullptr;
+    }
+
+    bool contains(const glm::ivec3& key) const { return findKey(key) != NOT_FOUND; }
+
+    // The key must be Morton::inRange; use insert when it may not be
+    T& operator[](const glm::ivec3& key) {
+        uint64_t code = Morton::encode(key);
+        size_t slot = findSlot(code);
+        if (slot != NOT_FOUND) {
+            return values[slot];
+        }
+        return values[insertNew(code, T())];
+    }
+
+    // Returns true if the key was not present yet. Keys outside Morton's range are rejected.
+    bool insert(const glm::ivec3& key, T value) {
+        if (!Morton::inRange(key)) {
+            std::cout << "VoxelHashMap: ignoring key outside [-2^20, 2^20): " << key.x << ", " << key.y << ", " << key.z << std::endl;
+            return false;
+        }
+        uint64_t code = Morton::encode(key);
+        size_t slot = findSlot(code);
+        if (slot != NOT_FOUND) {
+            values[slot] = std::move(value);
+            return false;
+        }
+        insertNew(code, std::move(value));
+        return true;
+    }
+
+    bool erase(const glm::ivec3& key) {
+        size_t slot = findKey(key);
+        if (slot == NOT_FOUND) {
+            return false;
+        }
+        size_t mask = distances.size() - 1;
+        size_t next = (slot + 1) & mask;
+        // Pull the rest of the cluster back one slot so probe chains stay unbroken
+        while (distances[next] > 1) {
+            keys[slot] = keys[next];
+            values[slot] = std::move(values[next]);
+            distances[slot] = distances[next] - 1;
+            slot = next;
+            next = (next + 1) & mask;
+        }
+        distances[slot] = 0;
+        values[slot] = T();
+        --count;
+        return true;
+    }
+
+    void clear() {
+        keys.clear();
+        values.clear();
+        distances.clear();
+        count = 0;
+        shift = 64;
+    }
+
+    void reserve(size_t expected) {
+        size_t capacity = MIN_CAPACITY;
+        while (capacity * MAX_LOAD_NUM < expected * MAX_LOAD_DEN) {
+            capacity *= 2;
+        }
+        if (capacity > distances.size()) {
+            rehash(capacity);
+        }
+    }
+
+private:
+    static constexpr size_t NOT_FOUND = ~size_t(0);
+    static constexpr size_t MIN_CAPACITY = 16;
+    static constexpr size_t MAX_LOAD_NUM = 7; // Grow past 7/8 full
+    static constexpr size_t MAX_LOAD_DEN = 8;
+    static constexpr uint8_t MAX_DISTANCE = 255;
+
+    std::vector<uint64_t> keys;
+    std::vector<T> values;
+    std::vector<uint8_t> distances; // Probe distance + 1, 0 marks an empty slot
+    size_t count;
+    int shift;
+
+    // Fibonacci hashing spreads the low-entropy bits of planar layouts across the table
+    size_t homeSlot(uint64_t code) const { return static_cast<size_t>((code * 0x9E3779B97F4A7C15ull) >> shift); }
+
+    size_t findKey(const glm::ivec3& key) const {
+        return Morton::inRange(key) ? findSlot(Morton::encode(key)) : NOT_FOUND;
+    }
+
+    size_t findSlot(uint64_t code) const {
+        if (count == 0) {
+            return NOT_FOUND;
+        }
+        size_t mask = distances.size() - 1;
+        size_t slot = homeSlot(code);
+        for (unsigned distance = 1;; ++distance) {
+            // Robin Hood invariant: once we see an entry closer to home than we are, the key is absent
+            if (distances[slot] < distance) {
+                return NOT_FOUND;
+            }
+            if (keys[slot] == code) {
+                return slot;
+            }
+            slot = (slot + 1) & mask;
+        }
+    }
+
+    size_t insertNew(uint64_t code, T value) {
+        if ((count + 1) * MAX_LOAD_DEN > distances.size() * MAX_LOAD_NUM) {
+            rehash(distances.empty() ? MIN_CAPACITY : distances.size() * 2);
+        }
+        size_t placed;
+        while ((placed = tryPlace(code, value)) == NOT_FOUND) {
+            rehash(distances.size() * 2); // A probe chain would overflow its distance byte, spread things out
+        }
+        ++count;
+        return placed;
+    }
+
+    // Places a key known to be absent and returns the slot it landed in. Returns
+    // NOT_FOUND without touching the table if a probe distance would overflow.
+    size_t tryPlace(uint64_t code, T& value) {
+        size_t mask = distances.size() - 1;
+        size_t slot = homeSlot(code);
+        uint8_t distance = 1;
+        while (distances[slot] >= distance) {
+            if (distance == MAX_DISTANCE) {
+                return NOT_FOUND;
+            }
+            slot = (slot + 1) & mask;
+            ++distance;
+        }
+
+        // Inserting shifts the rest of the cluster one slot further from home
+        for (size_t end = slot; distances[end] != 0; end = (end + 1) & mask) {
+            if (distances[end] == MAX_DISTANCE) {
+                return NOT_FOUND;
+            }
+        }
+
+        size_t placed = slot;
+        uint64_t carryKey = code;
+        T carryValue = std::move(value);
+        uint8_t carryDistance = distance;
+        for (;;) {
+            if (distances[slot] == 0) {
+                keys[slot] = carryKey;
+                values[slot] = std::move(carryValue);
+                distances[slot] = carryDistance;
+                return placed;
+            }
+            if (distances[slot] < carryDistance) {
+                std::swap(keys[slot], carryKey);
+                std::swap(values[slot], carryValue);
+                std::swap(distances[slot], carryDistance);
+            }
+            slot = (slot + 1) & mask;
+            ++carryDistance;
+        }
+    }
+
+    void rehash(size_t capacity) {
+        std::vector<uint64_t> oldKeys;
+        std::vector<T> oldValues;
+        std::vector<uint8_t> oldDistances;
+        oldKeys.swap(keys);
+        oldValues.swap(values);
+        oldDistances.swap(distances);
+
+        keys.assign(capacity, 0);
+        values.resize(capacity);
+        distances.assign(capacity, 0);
+        shift = 64;
+        for (size_t c = capacity; c > 1; c >>= 1) {
+            --shift;
+        }
+
+        for (size_t i = 0; i < oldDistances.size(); ++i) {
+            if (oldDistances[i] != 0) {
+                while (tryPlace(oldKeys[i], oldValues[i]) == NOT_FOUND) {
+                    rehash(distances.size() * 2);
+                }
+            }
+        }
+    }
+};
+
+// Set of voxel coordinates built on the same table
+class VoxelHashSet {
+    struct Empty {};
+
+public:
+    class iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = glm::ivec3;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = glm::ivec3;
+
+        explicit iterator(VoxelHashMap<Empty>::const_iterator it) : it(it) {}
+        glm::ivec3 operator*() const { return (*it).first; }
+        iterator& operator++() { ++it; return *this; }
+        bool operator==(const iterator& other) const { return it == other.it; }
+        bool operator!=(const iterator& other) const { return it != other.it; }
+
+    private:
+        VoxelHashMap<Empty>::const_iterator it;
+    };
+
+    VoxelHashSet() {}
+
+    template <typename It>
+    VoxelHashSet(It first, It last) {
+        for (; first != last; ++first) {
+            insert(*first);
+        }
+    }
+
+    bool insert(const glm::ivec3& key) { return map.insert(key, Empty()); }
+    bool erase(const glm::ivec3& key) { return map.erase(key); }
+    bool contains(const glm::ivec3& key) const { return map.contains(key); }
+    size_t count(const glm::ivec3& key) const { return map.contains(key) ? 1 : 0; }
+    size_t size() const { return map.size(); }
+    bool empty() const { return map.empty(); }
+    void clear() { map.clear(); }
+    void reserve(size_t expected) { map.reserve(expected); }
+
+    iterator begin() const { return iterator(map.begin()); }
+    iterator end() const { return iterator(map.end()); }
+
+private:
+    VoxelHashMap<Empty> map;
+};
+
+#endif // VOXELHASHMAP_H
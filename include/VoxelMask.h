@@ -0,0 +1,91 @@
+#ifndef VOXELMASK_H
+#define VOXELMASK_H
+
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include <glm/glm.hpp>
+#include "BitUtils.h"
+#include "VoxelChunk.h"
+#include "VoxelHashMap.h"
+
+// One bit per voxel position, kept apart from the voxel storage so every
+// backend can carry selection and highlight state. Bits live in chunk-sized
+// bitsets with a population count each. A chunk's bitset is dropped as soon as
+// its count reaches zero, so clearing, counting and iterating cost
+// O(chunks with a bit set) no matter how large the world is.
+//
+// Copying a mask shares the chunk bitsets; whichever copy writes to a shared
+// chunk first clones it, so copies are O(chunks) and never see each other's edits.
+class VoxelMask {
+public:
+    VoxelMask() : total(0) {}
+
+    bool test(const glm::ivec3& position) const {
+        return testBit(getChunkBits(VoxelChunk::chunkCoord(position)), VoxelChunk::localIndex(VoxelChunk::localCoord(position)));
+    }
+    // Both return true if the bit changed
+    bool set(const glm::ivec3& position);
+    bool reset(const glm::ivec3& position);
+    void clear();
+
+    bool empty() const { return total == 0; }
+    size_t count() const { return total; }
+    size_t count(const glm::ivec3& chunkPos) const {
+        const std::shared_ptr<ChunkBits>* bits = chunks.find(chunkPos);
+        return bits ? (*bits)->count : 0;
+    }
+    size_t getChunkCount() const { return chunks.size(); }
+
+    // Word-at-a-time union and difference with another mask
+    void merge(const VoxelMask& other);
+    void subtract(const VoxelMask& other);
+
+    // VoxelChunk::WORDS words indexed like VoxelChunk::localIndex, or nullptr if no bit in the chunk is set
+    const uint64_t* getChunkBits(const glm::ivec3& chunkPos) const {
+        const std::shared_ptr<ChunkBits>* bits = chunks.find(chunkPos);
+        return bits ? (*bits)->words : nullptr;
+    }
+
+    // Tests a bit in a block returned by getChunkBits; a missing block reads as all clear
+    static bool testBit(const uint64_t* bits, int index) { return bits && ((bits[index >> 6] >> (index & 63)) & 1); }
+
+    // Calls fn(chunkPos) for every chunk with at least one bit set
+    template <typename Fn>
+    void forEachChunk(Fn fn) const {
+        for (const auto& chunkPair : chunks) {
+            fn(chunkPair.first);
+        }
+    }
+
+    // Calls fn(position) for every set bit
+    template <typename Fn>
+    void forEach(Fn fn) const {
+        for (const auto& chunkPair : chunks) {
+            glm::ivec3 origin = VoxelChunk::chunkOrigin(chunkPair.first);
+            const uint64_t* words = chunkPair.second->words;
+            for (int word = 0; word < VoxelChunk::WORDS; ++word) {
+                uint64_t remaining = words[word];
+                while (remaining) {
+                    int index = word * 64 + countTrailingZeros(remaining);
+                    remaining &= remaining - 1;
+                    fn(origin + VoxelChunk::localPosition(index));
+                }
+            }
+        }
+    }
+
+private:
+    struct ChunkBits {
+        uint64_t words[VoxelChunk::WORDS];
+        uint32_t count;
+    };
+
+    VoxelHashMap<std::shared_ptr<ChunkBits>> chunks;
+    size_t total;
+
+    // Returns bits ready to write, cloning them first if another copy still shares them
+    static ChunkBits& writable(std::shared_ptr<ChunkBits>& bits);
+};
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef VOXELSTORAGE_H
+#define VOXELSTORAGE_H
+
+#include <memory>
+#include <functional>
+#include <glm/glm.hpp>
+#include "MaterialRegistry.h"
+
+enum VoxelStorageType {
+    STORAGE_CHUNKED,       // Hash of palette-compressed 32^3 chunks, good for anything edited by hand
+    STORAGE_SPARSE_OCTREE, // Collapses uniform air and solid regions, for large terrain
+    STORAGE_DENSE          // Flat size^3 array over [0, size), fastest for small bounded props
+};
+
+// Backend that owns the voxel materials of a VoxelWorld. A voxel exists when
+// its material is anything other than MaterialRegistry::NONE.
+class VoxelStorage {
+public:
+    using VoxelVisitor = std::function<void(const glm::ivec3& position, MaterialId material)>;
+    using ChunkVisitor = std::function<void(const glm::ivec3& chunkPos)>;
+
+    virtual ~VoxelStorage() {}
+
+    // size is the grid extent for STORAGE_DENSE; the other backends are unbounded
+    static std::unique_ptr<VoxelStorage> create(VoxelStorageType type, int size);
+
+    // Independent copy for snapshots. Every backend shares its chunks or pages copy-on-write,
+    // so this is O(chunks) and later edits to either copy only clone what they touch.
+    virtual std::unique_ptr<VoxelStorage> clone() const = 0;
+
+    virtual MaterialId getVoxel(const glm::ivec3& position) const = 0;
+    // Setting MaterialRegistry::NONE removes the voxel
+    virtual void setVoxel(const glm::ivec3& position, MaterialId material) = 0;
+    virtual size_t getVoxelCount() const = 0;
+
+    // Inclusive box of the positions this backend can hold; writes outside it are ignored
+    virtual glm::ivec3 getMinPosition() const = 0;
+    virtual glm::ivec3 getMaxPosition() const = 0;
+    bool canHold(const glm::ivec3& position) const {
+        return glm::all(glm::greaterThanEqual(position, getMinPosition())) && glm::all(glm::lessThanEqual(position, getMaxPosition()));
+    }
+
+    bool hasVoxel(const glm::ivec3& position) const { return getVoxel(position) != MaterialRegistry::NONE; }
+    bool removeVoxel(const glm::ivec3& position);
+
+    // Calls visitor for every voxel inside the inclusive box [regionMin, regionMax]
+    virtual void forEachVoxel(const glm::ivec3& regionMin, const glm::ivec3& regionMax, const VoxelVisitor& visitor) const = 0;
+    // True if the VoxelChunk-sized cell at chunkPos holds at least one voxel
+    virtual bool hasChunk(const glm::ivec3& chunkPos) const = 0;
+    // Calls visitor with the coordinate of every VoxelChunk-sized cell that holds at least one voxel
+    virtual void forEachChunk(const ChunkVisitor& visitor) const = 0;
+    // Copies extent.x * extent.y * extent.z materials starting at regionMin into out,
+    // x fastest, NONE where empty. The mesher reads each chunk plus a one voxel border this way.
+    virtual void readRegion(const glm::ivec3& regionMin, const glm::ivec3& extent, MaterialId* out) const;
+};
+
+#endif
@@ -2,10 +2,15 @@
 #define VOXELWORLD_H
 
 #include <vector>
-#include <unordered_map>
+#include <memory>
 #include <string>
 #include <glm/glm.hpp>
 #include <GL/glew.h>
+#include "Vertex.h"
+#include "VoxelStorage.h"
+#include "VoxelMask.h"
+#include "ChunkMesher.h"
+#include "MeshPipeline.h"
 
 class ExtrusionManager; // Forward declaration
 
@@ -19,82 +24,172 @@ enum FaceDirection {
     NONE // For cases where no face is hit
 };
 
-struct Vertex {
-    float x, y, z;
-    float r, g, b;
-    float nx, ny, nz;
-    float u, v;
-    bool selected;
-    Vertex(float x, float y, float z, float r, float g, float b, float nx = 0.0f, float ny = 0.0f, float nz = 0.0f, float u = 0.0f, float v = 0.0f, bool selected = false)
-        : x(x), y(y), z(z), r(r), g(g), b(b), nx(nx), ny(ny), nz(nz), u(u), v(v), selected(selected) {}
+// Frozen copy of a VoxelWorld's voxels and selection state. Storage and masks
+// share unchanged chunks with the live world, and the world clones a chunk
+// before editing it, so a snapshot can be read from any thread while editing continues.
+struct VoxelSnapshot {
+    std::unique_ptr<const VoxelStorage> storage;
+    VoxelMask selected;
+    VoxelMask highlighted;
+    glm::ivec3 boundsMin;
+    glm::ivec3 boundsMax;
+    uint64_t version;
+    VoxelHashMap<uint64_t> chunkVersions; // World version of the last edit to each chunk
+
+    // Compare against an older snapshot to find the chunks that changed in between; 0 if never edited
+    uint64_t getChunkVersion(const glm::ivec3& chunkPos) const;
+    bool raycast(const glm::vec3& rayOrigin, const glm::vec3& rayDirection, glm::ivec3& hitVoxel, glm::vec3& hitNormal, FaceDirection& hitFace) const;
 };
 
-struct Voxel {
-    int type;
-    glm::vec3 color;
-    bool selected;
-    bool highlighted;
-    std::string texture;
-    glm::ivec3 position;
-
-    Voxel(int type = 0, const glm::vec3& color = glm::vec3(1.0f), bool selected = false, bool highlighted = false, const std::string& texture = "", const glm::ivec3& position = glm::ivec3(0))
-        : type(type), color(color), selected(selected), highlighted(highlighted), texture(texture), position(position) {}
-};
-
-struct VoxelIndexHasher {
-    std::size_t operator()(const glm::ivec3& voxel) const {
-        std::size_t xHash = std::hash<int>()(voxel.x);
-        std::size_t yHash = std::hash<int>()(voxel.y);
-        std::size_t zHash = std::hash<int>()(voxel.z);
-
-        return ((xHash ^ (yHash << 1)) >> 1) ^ (zHash << 1);
-    }
+// Vertices of one chunk mesh rewritten in place, see VoxelWorld::takeMeshPatches
+struct MeshPatch {
+    uint32_t firstVertex;
+    uint32_t vertexCount;
 };
 
+// Threading: one thread owns the world and makes every edit. Other threads
+// never touch it directly; they call acquireSnapshot() and read that. While at
+// least one reader is registered with addReader(), each finished edit (outside
+// beginEdit/commitEdit, or at the outermost commitEdit) publishes a fresh
+// snapshot; with no readers nothing is published. Old snapshots are freed when
+// their last reader drops them.
 class VoxelWorld {
 public:
-    VoxelWorld(int size);
+    VoxelWorld(int size, VoxelStorageType storageType = STORAGE_CHUNKED);
     void setVoxel(int x, int y, int z, int type, const std::string& color, const std::string& texture);
+    void setVoxel(int x, int y, int z, MaterialId material); // No string work; use this for bulk edits
+    // Remeshes the chunks queued as dirty since the last call, spread over every core; edits call this on their own
     void generateMeshData();
-    std::vector<Vertex>& getVertices() { return vertices; }
-    std::vector<unsigned int>& getIndices() { return indices; }
     GLuint loadTexture(const std::string& path);
 
     bool raycast(const glm::vec3& rayOrigin, const glm::vec3& rayDirection, glm::ivec3& hitVoxel, glm::vec3& hitNormal, FaceDirection& hitFace);
     void updateVoxelColor(const glm::ivec3& voxel, const glm::vec3& color);
+    // Recolours and selects the voxels, e.g. one paint stroke. Only the material of their quads
+    // changes, so the meshes are patched in place; voxels inside merged greedy quads, or in chunks
+    // waiting to be remeshed anyway, remesh their chunk instead. Coarse meshes are rebuilt
+    // for the patched chunks, which the renderer then re-uploads whole.
+    void updateVoxelColors(const std::vector<glm::ivec3>& voxels, const glm::vec3& color);
     void selectVoxel(const glm::ivec3& voxel);
     bool rayIntersectsTriangle(const glm::vec3& rayOrigin, const glm::vec3& rayDirection, const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, glm::vec3& hitPoint);
     //void clearSelections();
     void clearSelections(ExtrusionManager& extrusionManager); // Update this method signature
 
-    std::vector<Vertex> selectedVertices;
-    std::vector<unsigned int> selectedIndices;
-    std::vector<Vertex> unselectedVertices;
-    std::vector<unsigned int> unselectedIndices;
-
     void highlightVoxel(const glm::ivec3& voxel);
     void resetHighlight(const glm::ivec3& voxel);
     bool isVoxelSelected(const glm::ivec3& voxel) const;
-
-    const std::vector<Vertex>& getUnselectedVertices() const { return unselectedVertices; }
-    const std::vector<unsigned int>& getUnselectedIndices() const { return unselectedIndices; }
-    const std::vector<Vertex>& getSelectedVertices() const { return selectedVertices; }
-    const std::vector<unsigned int>& getSelectedIndices() const { return selectedIndices; }
+    size_t getSelectedCount() const { return selectedMask.count(); }
+    const VoxelMask& getSelection() const { return selectedMask; }
+    const VoxelMask& getHighlight() const { return highlightedMask; }
+    // Chunks whose selection or highlight bits changed since the last call. The renderer draws
+    // those bits over the meshes, so selecting and hovering never remesh anything.
+    std::vector<glm::ivec3> takeSelectionChangedChunks();
+
+    // One mesh per chunk with anything to draw. A chunk is remeshed only when a voxel
+    // inside it changes, or a voxel on the border of a neighbouring chunk does.
+    const VoxelHashMap<ChunkMesh>& getChunkMeshes() const { return chunkMeshes; }
+    const ChunkMesh* getChunkMesh(const glm::ivec3& chunkPos) const { return chunkMeshes.find(chunkPos); }
+    // Chunks whose mesh was rebuilt or dropped since the last call, for the renderer to re-upload.
+    // A rebuilt mesh of the same voxels as before, e.g. an untouched chunk after restore, keeps
+    // its ChunkMesh::generation, so the upload can be skipped.
+    std::vector<glm::ivec3> takeUpdatedChunks();
+    // Vertices recoloured in place since the last call, one span per chunk, for glBufferSubData.
+    // Take these after takeUpdatedChunks; a rebuilt chunk drops its span, as it is re-uploaded whole.
+    std::vector<std::pair<glm::ivec3, MeshPatch>> takeMeshPatches();
+    size_t getDirtyChunkCount() const { return dirtyChunks.size(); }
+    // Switching modes remeshes every chunk that has a mesh
+    void setMeshingMode(MeshingMode mode);
+    MeshingMode getMeshingMode() const { return meshingMode; }
+    // Coarse meshes built next to each chunk mesh, for the renderer to draw far away chunks
+    // with, see ChunkMesh::lods. 0 (the default) builds none; changing it remeshes every chunk.
+    void setLodLevels(int levels);
+    int getLodLevels() const { return lodLevels; }
+    // Chunks whose voxels were meshed before (undo, redo, switching the mode back) are copied
+    // from the cache instead of remeshed. Give it a directory and call saveMeshCache before
+    // closing, and the next run skips meshing the chunks that did not change.
+    MeshCache& getMeshCache() { return meshPipeline.getCache(); }
+    void saveMeshCache(); // Writes the current chunk meshes to the cache directory
+
+    // Off by default. When on, edits hand their dirty chunks to a background thread and
+    // return at once. The meshes land in a back buffer, and swapMeshBuffers(), called at
+    // the start of a frame, moves the finished ones into getChunkMeshes.
+    void setAsyncMeshing(bool enabled);
+    bool isAsyncMeshing() const { return asyncMeshing; }
+    // Returns true if any meshes arrived. Also starts meshing chunks that were edited meanwhile.
+    bool swapMeshBuffers();
+    // Blocks until every dirty chunk is meshed and swapped in; for tests and loading screens
+    void waitForMeshing();
 
     void extrudeVoxels(int direction, int layers);
     void removeSelectedVoxels();
     void removeVoxel(const glm::ivec3& position); // Add this declaration
-    
+
+    // Edits made between beginEdit and commitEdit only mark the mesh dirty; it is
+    // rebuilt once when the outermost commitEdit runs. Calls may nest.
+    void beginEdit();
+    void commitEdit();
+    bool isEditing() const { return editDepth > 0; }
+
+    // Bulk edits, each costing at most one remesh. MaterialRegistry::NONE removes.
+    void fillBox(const glm::ivec3& boxMin, const glm::ivec3& boxMax, MaterialId material);
+    void setVoxels(const std::vector<std::pair<glm::ivec3, MaterialId>>& voxels);
+    void removeVoxels(const std::vector<glm::ivec3>& positions);
+    void selectBox(const glm::ivec3& boxMin, const glm::ivec3& boxMax); // Selects the voxels that exist inside the box
+
+    const VoxelStorage& getStorage() const { return *storage; }
+
+    // O(chunks) with the default chunked storage. Take it on the editing thread, then hand it to
+    // savers, meshers or the undo stack.
+    std::shared_ptr<const VoxelSnapshot> snapshot() const;
+    void restore(const VoxelSnapshot& snapshot); // Rolls the world back to the snapshot, e.g. for undo
+    uint64_t getVersion() const { return version; } // Bumped by every edit
+
+    // Owning thread only. addReader publishes the current state, so acquireSnapshot is valid right after it.
+    void addReader();
+    void removeReader();
+    // Latest published snapshot; safe to call from any thread once a reader has been added
+    std::shared_ptr<const VoxelSnapshot> acquireSnapshot() const;
+    // Publishes the current state now, e.g. after a run of setVoxel calls that do not publish on their own
+    void publish();
+
 private:
     int size;
-    std::unordered_map<glm::ivec3, Voxel, VoxelIndexHasher> voxels;
-    std::vector<Vertex> vertices;
-    std::vector<unsigned int> indices;
-    std::vector<float> normals;
+    std::unique_ptr<VoxelStorage> storage;
+    VoxelMask selectedMask;
+    VoxelMask highlightedMask;
+    // Grows with every edit and never shrinks, so it always encloses every voxel; raycasts are clipped to it
+    glm::ivec3 boundsMin;
+    glm::ivec3 boundsMax;
+    int editDepth;
+    bool meshDirty;
+    uint64_t version;
+    VoxelHashMap<uint64_t> chunkVersions; // Entries for chunks that become empty are dropped after remeshing
+    int readerCount;
+    std::shared_ptr<const VoxelSnapshot> published; // Only accessed through std::atomic_load/atomic_store
+    uint64_t publishedVersion;
+    VoxelHashMap<ChunkMesh> chunkMeshes;
+    VoxelHashSet dirtyChunks;   // Waiting for generateMeshData
+    VoxelHashSet updatedChunks; // Remeshed but not yet taken by the renderer
+    VoxelHashSet selectionChangedChunks; // Selection or highlight changed, not yet taken by the renderer
+    VoxelHashMap<MeshPatch> meshPatches; // Patched in place but not yet taken by the renderer
+    uint64_t meshGeneration; // Last ChunkMesh::generation handed out
+    VoxelHashSet meshingChunks; // In the batch on the background thread; their meshes are about to be replaced
+    MeshingMode meshingMode;
+    int lodLevels;
+    bool asyncMeshing;
+    MeshPipeline meshPipeline;
 
     glm::ivec3 getVoxelIndex(int x, int y, int z);
-    void addFace(std::vector<Vertex>& vertexBuffer, std::vector<unsigned int>& indexBuffer, int x, int y, int z, const std::vector<Vertex>& faceVertices, const std::vector<unsigned int>& faceIndices, const glm::vec3& color);
-    void calculateNormals(std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices);
+    bool hasVoxel(const glm::ivec3& position) const { return storage->hasVoxel(position); }
+    void clearFlags(const glm::ivec3& position);
+    bool writeVoxel(const glm::ivec3& position, MaterialId material); // False if the storage cannot hold the position
+    void touchChunk(const glm::ivec3& chunkPos);
+    void touchSelection(const glm::ivec3& chunkPos); // New version for readers, no remesh
+    void touchVoxel(const glm::ivec3& position); // Also touches the neighbouring chunks the voxel borders on
+    void invalidateMesh(); // Remeshes now, or on commit inside an edit
+    void finishEdit();
+    void startMeshing(); // Hands the dirty chunks to the background thread if it is free
+    void applyMeshes(const std::vector<glm::ivec3>& chunks, std::vector<ChunkMesh>& meshes);
+    bool patchVoxelMaterial(const glm::ivec3& voxel, MaterialId material); // False if the chunk needs a remesh
 };
 
 #endif
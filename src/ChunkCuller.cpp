@@ -0,0 +1,118 @@
+#include "ChunkCuller.h"
+#include <cmath>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+#include "BitUtils.h"
+
+Frustum Frustum::fromMatrix(const glm::mat4& viewProjection) {
+    // Clip space keeps -w <= x, y, z <= w, so each plane is the last row plus or minus another.
+    // glm is column major: row i is (m[0][i], m[1][i], m[2][i], m[3][i]).
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; ++i) {
+        rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+    }
+    Frustum frustum;
+    frustum.planes[0] = rows[3] + rows[0];
+    frustum.planes[1] = rows[3] - rows[0];
+    frustum.planes[2] = rows[3] + rows[1];
+    frustum.planes[3] = rows[3] - rows[1];
+    frustum.planes[4] = rows[3] + rows[2];
+    frustum.planes[5] = rows[3] - rows[2];
+    return frustum;
+}
+
+ChunkCuller::ChunkCuller() : count(0) {}
+
+void ChunkCuller::setBox(size_t index, const glm::vec3& center, const glm::vec3& extent) {
+    centerX[index] = center.x;
+    centerY[index] = center.y;
+    centerZ[index] = center.z;
+    extentX[index] = extent.x;
+    extentY[index] = extent.y;
+    extentZ[index] = extent.z;
+}
+
+size_t ChunkCuller::add(const glm::vec3& boxMin, const glm::vec3& boxMax) {
+    if (count == centerX.size()) {
+        size_t padded = count + 4;
+        for (std::vector<float>* lane : { &centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ }) {
+            lane->resize(padded, 0.0f);
+        }
+    }
+    setBox(count, 0.5f * (boxMin + boxMax), 0.5f * (boxMax - boxMin));
+    return count++;
+}
+
+void ChunkCuller::remove(size_t index) {
+    size_t last = count - 1;
+    if (index != last) {
+        setBox(index, glm::vec3(centerX[last], centerY[last], centerZ[last]), glm::vec3(extentX[last], extentY[last], extentZ[last]));
+    }
+    setBox(last, glm::vec3(0.0f), glm::vec3(0.0f));
+    --count;
+}
+
+void ChunkCuller::clear() {
+    for (std::vector<float>* lane : { &centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ }) {
+        lane->clear();
+    }
+    count = 0;
+}
+
+// A box is outside when it lies wholly behind one plane: its centre's distance plus the
+// reach of its extent along the plane normal is still negative. SSE2 takes four boxes
+// per step against all six planes; the scalar loop handles machines without it.
+void ChunkCuller::cull(const Frustum& frustum, std::vector<uint32_t>& visible) const {
+    visible.clear();
+    size_t i = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+    __m128 normalX[6], normalY[6], normalZ[6], offset[6], reachX[6], reachY[6], reachZ[6];
+    for (int p = 0; p < 6; ++p) {
+        const glm::vec4& plane = frustum.planes[p];
+        normalX[p] = _mm_set1_ps(plane.x);
+        normalY[p] = _mm_set1_ps(plane.y);
+        normalZ[p] = _mm_set1_ps(plane.z);
+        offset[p] = _mm_set1_ps(plane.w);
+        reachX[p] = _mm_set1_ps(std::fabs(plane.x));
+        reachY[p] = _mm_set1_ps(std::fabs(plane.y));
+        reachZ[p] = _mm_set1_ps(std::fabs(plane.z));
+    }
+    const __m128 zero = _mm_setzero_ps();
+    for (; i < count; i += 4) {
+        __m128 cx = _mm_loadu_ps(&centerX[i]);
+        __m128 cy = _mm_loadu_ps(&centerY[i]);
+        __m128 cz = _mm_loadu_ps(&centerZ[i]);
+        __m128 ex = _mm_loadu_ps(&extentX[i]);
+        __m128 ey = _mm_loadu_ps(&extentY[i]);
+        __m128 ez = _mm_loadu_ps(&extentZ[i]);
+        __m128 outside = zero;
+        for (int p = 0; p < 6; ++p) {
+            // Summed in the scalar loop's order, so both agree on boxes that just touch a plane
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(normalX[p], cx), _mm_mul_ps(normalY[p], cy)), _mm_mul_ps(normalZ[p], cz)), offset[p]);
+            __m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(reachX[p], ex), _mm_mul_ps(reachY[p], ey)), _mm_mul_ps(reachZ[p], ez));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, reach), zero));
+        }
+        uint64_t inside = ~_mm_movemask_ps(outside) & 15;
+        while (inside) {
+            size_t index = i + countTrailingZeros(inside);
+            if (index < count) {
+                visible.push_back(static_cast<uint32_t>(index));
+            }
+            inside &= inside - 1;
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        bool outside = false;
+        for (int p = 0; p < 6 && !outside; ++p) {
+            const glm::vec4& plane = frustum.planes[p];
+            float distance = plane.x * centerX[i] + plane.y * centerY[i] + plane.z * centerZ[i] + plane.w;
+            float reach = std::fabs(plane.x) * extentX[i] + std::fabs(plane.y) * extentY[i] + std::fabs(plane.z) * extentZ[i];
+            outside = distance + reach < 0.0f;
+        }
+        if (!outside) {
+            visible.push_back(static_cast<uint32_t>(i));
+        }
+    }
+}
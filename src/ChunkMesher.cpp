@@ -0,0 +1,777 @@
+#include "ChunkMesher.h"
+#include <algorithm>
+#include <array>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+#include "BitUtils.h"
+#include "MeshCache.h"
+
+namespace {
+
+constexpr unsigned int faceIndices[6] = { 0, 1, 2, 2, 3, 0 };
+constexpr unsigned int flippedFaceIndices[6] = { 1, 2, 3, 3, 0, 1 }; // Same quad split along the other diagonal
+
+// Faces are numbered the way the vertex shader decodes them: +z, -z, -x, +x, +y, -y
+constexpr int P = ChunkMesher::PADDED;
+
+// Axes of each face: the normal axis, the axes the texture's u and v run along,
+// and whether the face sits on the high side of the voxel
+struct FaceAxes {
+    int normal;
+    int u;
+    int v;
+    int side;
+};
+
+constexpr FaceAxes faceAxes[6] = {
+    { 2, 0, 1, 1 }, { 2, 0, 1, 0 },
+    { 0, 2, 1, 0 }, { 0, 2, 1, 1 },
+    { 1, 0, 2, 1 }, { 1, 0, 2, 0 }
+};
+
+constexpr int axisStrides[3] = { 1, P, P * P }; // Steps along x, y and z in the padded block
+
+// Ambient occlusion of the four corners of a face, 2 bits each in PackedVertex corner
+// order, indexed by which of the 8 voxels around the face in the layer in front of it
+// are filled: bits 0-3 the sides at -u, +u, -v, +v, bits 4-7 the diagonals at
+// (-u,-v), (+u,-v), (+u,+v), (-u,+v). A corner looks at its two sides and its diagonal.
+constexpr std::array<uint8_t, 256> buildOcclusionTable() {
+    constexpr int side1[4] = { 0, 1, 1, 0 };
+    constexpr int side2[4] = { 2, 2, 3, 3 };
+    std::array<uint8_t, 256> table = {};
+    for (int neighbours = 0; neighbours < 256; ++neighbours) {
+        uint32_t occlusion = 0;
+        for (int i = 0; i < 4; ++i) {
+            uint32_t a = neighbours >> side1[i] & 1;
+            uint32_t b = neighbours >> side2[i] & 1;
+            uint32_t diagonal = neighbours >> (4 + i) & 1;
+            occlusion |= (a && b ? 3 : a + b + diagonal) << (2 * i);
+        }
+        table[neighbours] = static_cast<uint8_t>(occlusion);
+    }
+    return table;
+}
+
+constexpr std::array<uint8_t, 256> occlusionTable = buildOcclusionTable();
+
+// The padded block holds the layer in front of the face even on chunk edges. strides are
+// the block's steps along x, y and z, so coarse blocks work the same way.
+uint32_t faceOcclusion(const MaterialId* block, const int* strides, int face, int padded) {
+    const FaceAxes& axes = faceAxes[face];
+    const MaterialId* front = &block[padded + (axes.side ? strides[axes.normal] : -strides[axes.normal])];
+    int u = strides[axes.u];
+    int v = strides[axes.v];
+    uint32_t neighbours = (front[-u] != MaterialRegistry::NONE)
+        | (front[u] != MaterialRegistry::NONE) << 1
+        | (front[-v] != MaterialRegistry::NONE) << 2
+        | (front[v] != MaterialRegistry::NONE) << 3
+        | (front[-u - v] != MaterialRegistry::NONE) << 4
+        | (front[u - v] != MaterialRegistry::NONE) << 5
+        | (front[u + v] != MaterialRegistry::NONE) << 6
+        | (front[v - u] != MaterialRegistry::NONE) << 7;
+    return occlusionTable[neighbours];
+}
+
+// Writes the corners of a quad whose first corner has the packed position (ao bits clear),
+// reaching the others by adding uStep and vStep to the packed coordinates directly. True if
+// the quad is to be split along its other diagonal: the lighter one, so a single dark corner
+// stays in its own triangle instead of smearing across the quad.
+inline bool writeQuad(PackedVertex* corners, uint32_t position, uint32_t uStep, uint32_t vStep, MaterialId material, uint32_t occlusion) {
+    uint32_t ao[4] = { occlusion & 3, (occlusion >> 2) & 3, (occlusion >> 4) & 3, (occlusion >> 6) & 3 };
+    corners[0] = PackedVertex::fromWords(position | ao[0] << 21, material);
+    corners[1] = PackedVertex::fromWords((position + uStep) | ao[1] << 21, material);
+    corners[2] = PackedVertex::fromWords((position + uStep + vStep) | ao[2] << 21, material);
+    corners[3] = PackedVertex::fromWords((position + vStep) | ao[3] << 21, material);
+    return ao[0] + ao[2] > ao[1] + ao[3];
+}
+
+// Writes the six indices of quad, whose vertices start at 4 * quad
+inline void writeQuadIndices(unsigned int* indices, unsigned int quad, bool flipped) {
+    const unsigned int* split = flipped ? flippedFaceIndices : faceIndices;
+    unsigned int baseIndex = quad * 4;
+    for (int i = 0; i < 6; ++i) {
+        indices[i] = baseIndex + split[i];
+    }
+}
+
+// Appends a quad's vertices, and its number and diagonal to quads for the indices
+inline void appendQuad(std::vector<PackedVertex>& vertexBuffer, std::vector<uint32_t>& quads, uint32_t position, uint32_t uStep, uint32_t vStep, MaterialId material, uint32_t occlusion) {
+    uint32_t quad = static_cast<uint32_t>(vertexBuffer.size() / 4);
+    PackedVertex corners[4];
+    bool flipped = writeQuad(corners, position, uStep, vStep, material, occlusion);
+    vertexBuffer.insert(vertexBuffer.end(), corners, corners + 4);
+    quads.push_back(quad << 1 | static_cast<uint32_t>(flipped));
+}
+
+// Quad covering width x height faces, corner being the chunk-local voxel corner at its
+// low end. The shader derives UVs from the world corner, so merged quads tile the
+// texture every 5 voxels just like single faces.
+void addQuad(std::vector<PackedVertex>& vertexBuffer, std::vector<uint32_t>& quads, int face, const glm::ivec3& corner, int width, int height, MaterialId material, uint32_t occlusion) {
+    const FaceAxes& axes = faceAxes[face];
+    // Each axis has 6 bits
+    uint32_t uStep = static_cast<uint32_t>(width) << (6 * axes.u);
+    uint32_t vStep = static_cast<uint32_t>(height) << (6 * axes.v);
+    appendQuad(vertexBuffer, quads, PackedVertex(corner.x, corner.y, corner.z, face, 0, material).position, uStep, vStep, material, occlusion);
+}
+
+// faceOcclusion for one face direction of the full size padded block, with every stride
+// a constant. voxel points into the block.
+template <int FACE>
+uint32_t faceOcclusionFor(const MaterialId* voxel) {
+    constexpr FaceAxes axes = faceAxes[FACE];
+    constexpr int u = axisStrides[axes.u];
+    constexpr int v = axisStrides[axes.v];
+    const MaterialId* front = voxel + (axes.side ? axisStrides[axes.normal] : -axisStrides[axes.normal]);
+    uint32_t neighbours = (front[-u] != MaterialRegistry::NONE)
+        | (front[u] != MaterialRegistry::NONE) << 1
+        | (front[-v] != MaterialRegistry::NONE) << 2
+        | (front[v] != MaterialRegistry::NONE) << 3
+        | (front[-u - v] != MaterialRegistry::NONE) << 4
+        | (front[u - v] != MaterialRegistry::NONE) << 5
+        | (front[u + v] != MaterialRegistry::NONE) << 6
+        | (front[v - u] != MaterialRegistry::NONE) << 7;
+    return occlusionTable[neighbours];
+}
+
+// Where MESH_FACES writes: vertices and voxelQuads are sized up front from the face count,
+// as even a reserved push_back costs several times a plain store
+struct FaceOutput {
+    PackedVertex* vertex;
+    VoxelQuad* voxelQuad;
+    uint32_t quad;
+};
+
+// One single voxel face of direction FACE; its quad number and diagonal go to quads for
+// the indices. voxel points into the block; position is the packed low corner of the
+// voxel, index its VoxelChunk::localIndex.
+template <int FACE>
+inline void emitFace(FaceOutput& out, std::vector<uint32_t>& quads, const MaterialId* voxel, uint32_t position, uint16_t index, MaterialId material) {
+    constexpr FaceAxes axes = faceAxes[FACE];
+    constexpr uint32_t faceBits = static_cast<uint32_t>(axes.side) << (6 * axes.normal) | FACE << 18;
+    bool flipped = writeQuad(out.vertex, position + faceBits, 1u << (6 * axes.u), 1u << (6 * axes.v), material, faceOcclusionFor<FACE>(voxel));
+    *out.voxelQuad++ = { index, out.quad };
+    quads.push_back(out.quad << 1 | static_cast<uint32_t>(flipped));
+    out.vertex += 4;
+    ++out.quad;
+}
+
+constexpr int COLUMNS = P * P; // Bit columns per axis in the padded block
+constexpr int FACE_COLUMNS = VoxelChunk::SIZE * VoxelChunk::SIZE;
+constexpr int positiveFace[3] = { 3, 4, 0 }; // +x, +y, +z
+constexpr int negativeFace[3] = { 2, 5, 1 }; // -x, -y, -z
+
+// Bit i of a column is the voxel at padded coordinate i along the axis. A +face shows
+// where the next voxel up is empty, a -face where the one below is. AVX2 and SSE2
+// handle four and two columns per step; the scalar loop picks up the rest.
+void cullColumns(const uint64_t* columns, int count, uint64_t* plus, uint64_t* minus) {
+    int i = 0;
+#if defined(__AVX2__)
+    for (; i + 4 <= count; i += 4) {
+        __m256i column = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(columns + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(plus + i), _mm256_andnot_si256(_mm256_srli_epi64(column, 1), column));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(minus + i), _mm256_andnot_si256(_mm256_slli_epi64(column, 1), column));
+    }
+#elif defined(__SSE2__) || defined(_M_X64)
+    for (; i + 2 <= count; i += 2) {
+        __m128i column = _mm_loadu_si128(reinterpret_cast<const __m128i*>(columns + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(plus + i), _mm_andnot_si128(_mm_srli_epi64(column, 1), column));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(minus + i), _mm_andnot_si128(_mm_slli_epi64(column, 1), column));
+    }
+#endif
+    for (; i < count; ++i) {
+        plus[i] = columns[i] & ~(columns[i] >> 1);
+        minus[i] = columns[i] & ~(columns[i] << 1);
+    }
+}
+
+// Greedy merge of one slice of face keys, n x n with u running fastest: grows each face
+// along u, then along v while whole rows match, clears what it covered and hands the
+// rectangle to emit(u, v, width, height, key). Cells without a face must be 0.
+template <typename Emit>
+void mergeSlice(uint32_t* sliceMask, int n, Emit emit) {
+    for (int v = 0; v < n; ++v) {
+        for (int u = 0; u < n; ) {
+            uint32_t key = sliceMask[u + v * n];
+            if (key == 0) {
+                ++u;
+                continue;
+            }
+            int width = 1;
+            while (u + width < n && sliceMask[u + width + v * n] == key) {
+                ++width;
+            }
+            int height = 1;
+            for (; v + height < n; ++height) {
+                const uint32_t* row = &sliceMask[u + (v + height) * n];
+                if (std::find_if(row, row + width, [key](uint32_t other) { return other != key; }) != row + width) {
+                    break;
+                }
+            }
+            for (int row = 0; row < height; ++row) {
+                std::fill_n(&sliceMask[u + (v + row) * n], width, 0u);
+            }
+            emit(u, v, width, height, key);
+            u += width;
+        }
+    }
+}
+
+// Halves a padded block of n cells per axis (plus a one cell border) into target. Cells
+// inside the chunk are filled if any of their 8 source cells is, taking the material of
+// the highest one so terrain keeps its top layer's colour. Border cells stand for the
+// single layer of the neighbouring chunk, and are filled only if all of it is: a coarse
+// face on the chunk edge is culled only where the neighbour is solid at every level of
+// detail, so whichever level the neighbour is drawn at, it covers the culled face.
+void downsampleBlock(const MaterialId* source, int n, std::vector<MaterialId>& target) {
+    const int m = n / 2;
+    const int sourceSize = n + 2;
+    const int size = m + 2;
+    const int sy = sourceSize;
+    const int sz = sourceSize * sourceSize;
+    target.resize(size * size * size);
+    // Source cells along one axis for each coarse coordinate; the border stays one cell thick
+    int first[VoxelChunk::SIZE / 2 + 2];
+    int last[VoxelChunk::SIZE / 2 + 2];
+    for (int c = 0; c < size; ++c) {
+        first[c] = c == 0 ? 0 : (c == m + 1 ? n + 1 : 2 * c - 1);
+        last[c] = c == 0 ? 0 : (c == m + 1 ? n + 1 : 2 * c);
+    }
+    // Lower layer first; later filled children overwrite, so the upper layer's material wins
+    const int children[8] = { 0, 1, sz, sz + 1, sy, sy + 1, sy + sz, sy + sz + 1 };
+
+    MaterialId* cell = target.data();
+    for (int z = 0; z < size; ++z) {
+        for (int y = 0; y < size; ++y) {
+            bool borderRow = z == 0 || y == 0 || z == m + 1 || y == m + 1;
+            for (int x = 0; x < size; ++x, ++cell) {
+                const MaterialId* base = source + first[x] + first[y] * sy + first[z] * sz;
+                MaterialId material = MaterialRegistry::NONE;
+                if (!borderRow && x != 0 && x != m + 1) {
+                    for (int i = 0; i < 8; ++i) {
+                        MaterialId child = base[children[i]];
+                        material = child != MaterialRegistry::NONE ? child : material;
+                    }
+                    *cell = material;
+                    continue;
+                }
+                bool allFilled = true;
+                for (int dz = 0; dz <= last[z] - first[z]; ++dz) {
+                    for (int dy = 0; dy <= last[y] - first[y]; ++dy) {
+                        for (int dx = 0; dx <= last[x] - first[x]; ++dx) {
+                            MaterialId voxel = base[dx + dy * sy + dz * sz];
+                            allFilled = allFilled && voxel != MaterialRegistry::NONE;
+                            material = voxel != MaterialRegistry::NONE ? voxel : material;
+                        }
+                    }
+                }
+                *cell = allFilled ? material : MaterialRegistry::NONE;
+            }
+        }
+    }
+}
+
+// Surface nets cell: the 8 voxel centres from a low corner voxel up, corner i being
+// (i & 1, i >> 1 & 1, i >> 2 & 1) from it. Indexed by which corners are filled, the table
+// gives the cell's vertex as the mean of the midpoints of the edges that cross the surface
+// (in 1/16 voxel from the low corner), the normal against the occupancy gradient, and the
+// first filled corner, whose material the vertex takes.
+struct SmoothCell {
+    uint8_t offset[3];
+    uint8_t corner;
+    uint32_t normal;
+};
+
+constexpr int cellCorners[8] = { 0, 1, P, 1 + P, P * P, 1 + P * P, P + P * P, 1 + P + P * P }; // Offsets in the padded block
+
+// Octahedral encoding, 8 bits per coordinate; the vertex shader decodes it
+uint32_t encodeNormal(const glm::vec3& normal) {
+    glm::vec3 n = normal / (glm::abs(normal.x) + glm::abs(normal.y) + glm::abs(normal.z));
+    glm::vec2 oct(n.x, n.y);
+    if (n.z < 0.0f) {
+        glm::vec2 sign(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+        oct = (1.0f - glm::abs(glm::vec2(n.y, n.x))) * sign;
+    }
+    glm::ivec2 encoded(glm::round((oct * 0.5f + 0.5f) * 255.0f));
+    return static_cast<uint32_t>(encoded.x | encoded.y << 8);
+}
+
+std::vector<SmoothCell> buildSmoothCellTable() {
+    std::vector<SmoothCell> table(256, SmoothCell());
+    for (int filled = 1; filled < 255; ++filled) {
+        glm::vec3 midpoints(0.0f);
+        glm::vec3 gradient(0.0f);
+        int crossings = 0;
+        for (int i = 0; i < 8; ++i) {
+            glm::vec3 corner(i & 1, i >> 1 & 1, i >> 2 & 1);
+            if (filled >> i & 1) {
+                gradient += corner * 2.0f - 1.0f;
+            }
+            for (int bit = 1; bit < 8; bit <<= 1) {
+                int other = i | bit;
+                if ((i & bit) == 0 && (filled >> i & 1) != (filled >> other & 1)) {
+                    midpoints += (corner + glm::vec3(other & 1, other >> 1 & 1, other >> 2 & 1)) * 0.5f;
+                    ++crossings;
+                }
+            }
+        }
+        SmoothCell& cell = table[filled];
+        glm::vec3 offset = glm::round(midpoints / static_cast<float>(crossings) * 16.0f);
+        for (int axis = 0; axis < 3; ++axis) {
+            cell.offset[axis] = static_cast<uint8_t>(offset[axis]);
+        }
+        cell.corner = static_cast<uint8_t>(countTrailingZeros(static_cast<uint64_t>(filled)));
+        // Opposite corners filled cancel out; such cells are rare and any normal will do
+        cell.normal = encodeNormal(glm::length(gradient) > 0.0f ? -gradient : glm::vec3(0.0f, 1.0f, 0.0f));
+    }
+    return table;
+}
+
+const std::vector<SmoothCell> smoothCellTable = buildSmoothCellTable();
+
+const int CELLS = VoxelChunk::SIZE + 1; // Smooth mode cells per axis, low corners -1..31
+
+} // namespace
+
+void ChunkMesh::clear() {
+    vertices.clear();
+    indices.clear();
+    textureRanges.clear();
+    voxelQuads.clear();
+    smooth = false;
+    lods.clear();
+    contentKey = 0;
+    generation = 0;
+}
+
+std::pair<const VoxelQuad*, const VoxelQuad*> ChunkMesh::findVoxelQuads(int voxel) const {
+    const VoxelQuad* first = voxelQuads.data();
+    const VoxelQuad* last = first + voxelQuads.size();
+    first = std::lower_bound(first, last, voxel, [](const VoxelQuad& entry, int key) { return entry.voxel < key; });
+    last = std::upper_bound(first, last, voxel, [](int key, const VoxelQuad& entry) { return key < entry.voxel; });
+    return { first, last };
+}
+
+ChunkMesher::ChunkMesher()
+    : mode(MESH_FACES), lodLevels(0), cache(nullptr), block(PADDED * PADDED * PADDED), faceMask(VoxelChunk::SIZE * FACE_COLUMNS),
+      columns(3 * COLUMNS), culled(2 * COLUMNS), faceBits(6 * FACE_COLUMNS), cellVertices(CELLS * CELLS * CELLS, -1),
+      lodMask(6 * (VoxelChunk::SIZE / 2) * (VoxelChunk::SIZE / 2) * (VoxelChunk::SIZE / 2)) {}
+
+ChunkMesher::TextureBucket& ChunkMesher::findBucket(TextureId texture) {
+    for (TextureBucket& bucket : buckets) {
+        if (bucket.texture == texture) {
+            return bucket;
+        }
+    }
+    buckets.push_back({ texture, {}, {} });
+    return buckets.back();
+}
+
+std::vector<unsigned int>& ChunkMesher::bucketFor(TextureId texture) {
+    return findBucket(texture).indices;
+}
+
+std::vector<uint32_t>& ChunkMesher::bucketForQuads(TextureId texture) {
+    return findBucket(texture).quads;
+}
+
+void ChunkMesher::meshChunk(const VoxelStorage& storage, const glm::ivec3& chunkPos, ChunkMesh& mesh) {
+    mesh.clear();
+    for (TextureBucket& bucket : buckets) {
+        bucket.indices.clear();
+        bucket.quads.clear();
+    }
+
+    glm::ivec3 origin = VoxelChunk::chunkOrigin(chunkPos);
+    storage.readRegion(origin - 1, glm::ivec3(PADDED), block.data());
+    uint64_t key = 0;
+    if (cache) {
+        key = MeshCache::contentKey(block.data(), mode, lodLevels);
+        if (cache->find(key, mesh)) {
+            return;
+        }
+    }
+
+    cullFaces();
+    if (mode == MESH_GREEDY) {
+        meshGreedy(mesh);
+    } else if (mode == MESH_SMOOTH) {
+        meshSmooth(mesh);
+    } else {
+        meshFaces(mesh);
+    }
+
+    joinBuckets(mesh);
+    if (lodLevels > 0 && mode != MESH_SMOOTH) {
+        buildLods(mesh);
+    }
+    if (cache) {
+        mesh.contentKey = key;
+        cache->store(key, mesh);
+    }
+}
+
+void ChunkMesher::meshLods(const VoxelStorage& storage, const glm::ivec3& chunkPos, ChunkMesh& mesh) {
+    mesh.lods.clear();
+    if (lodLevels == 0 || mode == MESH_SMOOTH) {
+        return;
+    }
+    storage.readRegion(VoxelChunk::chunkOrigin(chunkPos) - 1, glm::ivec3(PADDED), block.data());
+    buildLods(mesh);
+}
+
+void ChunkMesher::joinBuckets(ChunkMesh& mesh) {
+    for (TextureBucket& bucket : buckets) {
+        size_t count = bucket.indices.size() + 6 * bucket.quads.size();
+        if (count == 0) {
+            continue;
+        }
+        size_t first = mesh.indices.size();
+        mesh.textureRanges.push_back({ bucket.texture, static_cast<uint32_t>(first), static_cast<uint32_t>(count) });
+        mesh.indices.resize(first + count);
+        unsigned int* indices = std::copy(bucket.indices.begin(), bucket.indices.end(), &mesh.indices[first]);
+        for (uint32_t quad : bucket.quads) {
+            writeQuadIndices(indices, quad >> 1, (quad & 1) != 0);
+            indices += 6;
+        }
+        bucket.indices.clear();
+        bucket.quads.clear();
+    }
+}
+
+void ChunkMesher::buildLods(ChunkMesh& mesh) {
+    // Each level halves the one before, so the full block is only read once
+    mesh.lods.resize(lodLevels);
+    const MaterialId* source = block.data();
+    int n = VoxelChunk::SIZE;
+    for (int level = 0; level < lodLevels; ++level) {
+        downsampleBlock(source, n, lodBlocks[level]);
+        n /= 2;
+        mesh.lods[level].clear();
+        meshCoarse(lodBlocks[level], n, mesh.lods[level]);
+        source = lodBlocks[level].data();
+    }
+}
+
+void ChunkMesher::meshCoarse(const std::vector<MaterialId>& cells, int cellsPerAxis, ChunkMesh& mesh) {
+    // Cube faces between filled and empty cells, merged like MESH_GREEDY whatever the mode:
+    // distant chunks never get recoloured in place, so nothing needs single faces
+    const MaterialRegistry& registry = MaterialRegistry::global();
+    const int n = cellsPerAxis;
+    const int scale = VoxelChunk::SIZE / n;
+    const int size = n + 2;
+    const int strides[3] = { 1, size, size * size };
+
+    // Like meshGreedy: scatter the visible faces' keys into per face slices, then merge the slices used
+    const int sliceSize = n * n;
+    uint32_t slicesUsed[6] = {};
+    for (int z = 0; z < n; ++z) {
+        for (int y = 0; y < n; ++y) {
+            int padded = 1 + (y + 1) * size + (z + 1) * size * size;
+            for (int x = 0; x < n; ++x, ++padded) {
+                MaterialId material = cells[padded];
+                if (material == MaterialRegistry::NONE) {
+                    continue;
+                }
+                glm::ivec3 cell(x, y, z);
+                for (int face = 0; face < 6; ++face) {
+                    const FaceAxes& axes = faceAxes[face];
+                    if (cells[padded + (axes.side ? strides[axes.normal] : -strides[axes.normal])] != MaterialRegistry::NONE) {
+                        continue;
+                    }
+                    int slice = cell[axes.normal];
+                    lodMask[(face * n + slice) * sliceSize + cell[axes.u] + cell[axes.v] * n] = material | faceOcclusion(cells.data(), strides, face, padded) << 16;
+                    slicesUsed[face] |= 1u << slice;
+                }
+            }
+        }
+    }
+
+    MaterialId lastMaterial = MaterialRegistry::NONE;
+    std::vector<uint32_t>* bucket = nullptr;
+    for (int face = 0; face < 6; ++face) {
+        const FaceAxes& axes = faceAxes[face];
+        for (uint64_t remaining = slicesUsed[face]; remaining != 0; remaining &= remaining - 1) {
+            int slice = countTrailingZeros(remaining);
+            mergeSlice(&lodMask[(face * n + slice) * sliceSize], n, [&](int u, int v, int width, int height, uint32_t key) {
+                MaterialId material = static_cast<MaterialId>(key & 0xFFFF);
+                glm::ivec3 corner;
+                corner[axes.normal] = (slice + axes.side) * scale;
+                corner[axes.u] = u * scale;
+                corner[axes.v] = v * scale;
+                if (material != lastMaterial) {
+                    lastMaterial = material;
+                    bucket = &bucketForQuads(registry.get(material).texture);
+                }
+                addQuad(mesh.vertices, *bucket, face, corner, width * scale, height * scale, material, key >> 16);
+            });
+        }
+    }
+    joinBuckets(mesh);
+}
+
+void ChunkMesher::sortVoxelQuads(std::vector<VoxelQuad>& quads) {
+    // Quads come out face by face, so one voxel's entries start out spread over the list.
+    // Two stable counting passes over the voxel index, low byte first, keep each voxel's
+    // quads in emission order and cost far less than a comparison sort.
+    quadScratch.resize(quads.size());
+    std::vector<VoxelQuad>* from = &quads;
+    std::vector<VoxelQuad>* to = &quadScratch;
+    for (int shift = 0; shift < 16; shift += 8) {
+        uint32_t offsets[257] = {};
+        for (const VoxelQuad& entry : *from) {
+            ++offsets[((entry.voxel >> shift) & 255) + 1];
+        }
+        for (int i = 0; i < 256; ++i) {
+            offsets[i + 1] += offsets[i];
+        }
+        for (const VoxelQuad& entry : *from) {
+            (*to)[offsets[(entry.voxel >> shift) & 255]++] = entry;
+        }
+        std::swap(from, to); // After the second pass the sorted list is back in quads
+    }
+}
+
+void ChunkMesher::cullFaces() {
+    // Columns of axis a are indexed by the (u, v) that faceAxes gives that axis's faces
+    std::fill(columns.begin(), columns.end(), 0);
+    uint64_t* xColumns = &columns[0];
+    uint64_t* yColumns = &columns[COLUMNS];
+    uint64_t* zColumns = &columns[2 * COLUMNS];
+    const MaterialId* voxel = block.data();
+    for (int z = 0; z < P; ++z) {
+        for (int y = 0; y < P; ++y) {
+            uint64_t row = 0;
+            for (int x = 0; x < P; ++x, ++voxel) {
+                row |= uint64_t(*voxel != MaterialRegistry::NONE) << x;
+            }
+            xColumns[z + y * P] = row;
+            // Only filled voxels have bits to spread into the other two axes
+            for (uint64_t filled = row; filled != 0; filled &= filled - 1) {
+                int x = countTrailingZeros(filled);
+                yColumns[x + z * P] |= uint64_t(1) << y;
+                zColumns[x + y * P] |= uint64_t(1) << z;
+            }
+        }
+    }
+
+    // Keep the 32 interior bits of the interior columns; the border only ever hides faces
+    const int N = VoxelChunk::SIZE;
+    for (int axis = 0; axis < 3; ++axis) {
+        cullColumns(&columns[axis * COLUMNS], COLUMNS, &culled[0], &culled[COLUMNS]);
+        uint32_t* plusBits = &faceBits[positiveFace[axis] * FACE_COLUMNS];
+        uint32_t* minusBits = &faceBits[negativeFace[axis] * FACE_COLUMNS];
+        for (int v = 0; v < N; ++v) {
+            for (int u = 0; u < N; ++u) {
+                int column = (u + 1) + (v + 1) * P;
+                plusBits[u + v * N] = static_cast<uint32_t>(culled[column] >> 1);
+                minusBits[u + v * N] = static_cast<uint32_t>(culled[COLUMNS + column] >> 1);
+            }
+        }
+    }
+}
+
+void ChunkMesher::meshFaces(ChunkMesh& mesh) {
+    // Walking the voxels in index order emits each voxel's quads together, so voxelQuads
+    // comes out sorted without the radix passes. Vertices are written once, through
+    // pointers into lists sized from the face count.
+    size_t quadCount = 0;
+    for (uint32_t column : faceBits) {
+        quadCount += popCount(column);
+    }
+    mesh.vertices.resize(quadCount * 4);
+    mesh.voxelQuads.resize(quadCount);
+    FaceOutput out = { mesh.vertices.data(), mesh.voxelQuads.data(), 0 };
+
+    // Neighbouring voxels mostly share a material, so remember the last bucket instead of searching again
+    const MaterialRegistry& registry = MaterialRegistry::global();
+    MaterialId lastMaterial = MaterialRegistry::NONE;
+    std::vector<uint32_t>* bucket = nullptr;
+    const uint64_t* xColumns = &columns[0];
+    const int N = VoxelChunk::SIZE;
+    for (int z = 0; z < N; ++z) {
+        for (int y = 0; y < N; ++y) {
+            // Occupancy rows along x of the voxel row and its four neighbours, padded bit x + 1 being voxel x
+            uint64_t row = xColumns[(z + 1) + (y + 1) * P];
+            uint32_t filled = static_cast<uint32_t>(row >> 1);
+            uint32_t visible[6] = {
+                filled & ~static_cast<uint32_t>(xColumns[(z + 2) + (y + 1) * P] >> 1),
+                filled & ~static_cast<uint32_t>(xColumns[z + (y + 1) * P] >> 1),
+                filled & ~static_cast<uint32_t>(row),
+                filled & ~static_cast<uint32_t>(row >> 2),
+                filled & ~static_cast<uint32_t>(xColumns[(z + 1) + (y + 2) * P] >> 1),
+                filled & ~static_cast<uint32_t>(xColumns[(z + 1) + y * P] >> 1)
+            };
+            uint32_t exposed = visible[0] | visible[1] | visible[2] | visible[3] | visible[4] | visible[5];
+            const MaterialId* rowStart = &block[1 + (y + 1) * P + (z + 1) * P * P];
+            for (; exposed != 0; exposed &= exposed - 1) {
+                int x = countTrailingZeros(exposed);
+                const MaterialId* voxel = rowStart + x;
+                MaterialId material = *voxel;
+                if (material != lastMaterial) {
+                    lastMaterial = material;
+                    bucket = &bucketForQuads(registry.get(material).texture);
+                }
+                uint32_t position = x | y << 6 | z << 12;
+                uint16_t index = static_cast<uint16_t>(VoxelChunk::localIndex(x, y, z));
+                if (visible[0] >> x & 1) {
+                    emitFace<0>(out, *bucket, voxel, position, index, material);
+                }
+                if (visible[1] >> x & 1) {
+                    emitFace<1>(out, *bucket, voxel, position, index, material);
+                }
+                if (visible[2] >> x & 1) {
+                    emitFace<2>(out, *bucket, voxel, position, index, material);
+                }
+                if (visible[3] >> x & 1) {
+                    emitFace<3>(out, *bucket, voxel, position, index, material);
+                }
+                if (visible[4] >> x & 1) {
+                    emitFace<4>(out, *bucket, voxel, position, index, material);
+                }
+                if (visible[5] >> x & 1) {
+                    emitFace<5>(out, *bucket, voxel, position, index, material);
+                }
+            }
+        }
+    }
+}
+
+void ChunkMesher::meshGreedy(ChunkMesh& mesh) {
+    // Sized for the worst case, every face its own quad, and cut down to what was used after
+    size_t faceCount = 0;
+    for (uint32_t column : faceBits) {
+        faceCount += popCount(column);
+    }
+    mesh.vertices.resize(faceCount * 4);
+    mesh.voxelQuads.resize(faceCount);
+    uint32_t quadCount = 0;
+    uint32_t voxelQuadCount = 0;
+    meshGreedyDirection<0>(mesh, quadCount, voxelQuadCount);
+    meshGreedyDirection<1>(mesh, quadCount, voxelQuadCount);
+    meshGreedyDirection<2>(mesh, quadCount, voxelQuadCount);
+    meshGreedyDirection<3>(mesh, quadCount, voxelQuadCount);
+    meshGreedyDirection<4>(mesh, quadCount, voxelQuadCount);
+    meshGreedyDirection<5>(mesh, quadCount, voxelQuadCount);
+    mesh.vertices.resize(quadCount * 4);
+    mesh.voxelQuads.resize(voxelQuadCount);
+    sortVoxelQuads(mesh.voxelQuads);
+}
+
+template <int FACE>
+void ChunkMesher::meshGreedyDirection(ChunkMesh& mesh, uint32_t& quadCount, uint32_t& voxelQuadCount) {
+    constexpr FaceAxes axes = faceAxes[FACE];
+    constexpr int normalStride = axisStrides[axes.normal];
+    const MaterialRegistry& registry = MaterialRegistry::global();
+    const int N = VoxelChunk::SIZE;
+    const uint32_t* bits = &faceBits[FACE * FACE_COLUMNS];
+    // Scatter the key of every visible face into its slice: material in the low 16 bits and
+    // the corner occlusion above, so only faces that shade alike get merged.
+    // Cells without a face stay 0, since the merge below clears what it covers.
+    uint32_t slicesUsed = 0;
+    for (int column = 0; column < FACE_COLUMNS; ++column) {
+        slicesUsed |= bits[column];
+        const MaterialId* first = &block[(column % N + 1) * axisStrides[axes.u] + (column / N + 1) * axisStrides[axes.v] + normalStride];
+        for (uint64_t visible = bits[column]; visible != 0; visible &= visible - 1) {
+            int slice = countTrailingZeros(visible);
+            const MaterialId* padded = first + slice * normalStride;
+            faceMask[slice * FACE_COLUMNS + column] = *padded | faceOcclusionFor<FACE>(padded) << 16;
+        }
+    }
+
+    MaterialId lastMaterial = MaterialRegistry::NONE;
+    std::vector<uint32_t>* bucket = nullptr;
+    for (uint64_t remaining = slicesUsed; remaining != 0; remaining &= remaining - 1) {
+        int slice = countTrailingZeros(remaining);
+        // The packed corner of the slice's faces, and steps of one voxel along u and v
+        constexpr uint32_t uStep = 1u << (6 * axes.u);
+        constexpr uint32_t vStep = 1u << (6 * axes.v);
+        uint32_t slicePosition = static_cast<uint32_t>(slice + axes.side) << (6 * axes.normal) | FACE << 18;
+        mergeSlice(&faceMask[slice * FACE_COLUMNS], N, [&](int u, int v, int width, int height, uint32_t key) {
+            MaterialId material = static_cast<MaterialId>(key & 0xFFFF);
+            if (width == 1 && height == 1) {
+                uint32_t voxel = u << (5 * axes.u) | v << (5 * axes.v) | slice << (5 * axes.normal);
+                mesh.voxelQuads[voxelQuadCount++] = { static_cast<uint16_t>(voxel), quadCount };
+            }
+            if (material != lastMaterial) {
+                lastMaterial = material;
+                bucket = &bucketForQuads(registry.get(material).texture);
+            }
+            bool flipped = writeQuad(&mesh.vertices[quadCount * 4], slicePosition + u * uStep + v * vStep, width * uStep, height * vStep, material, key >> 16);
+            bucket->push_back(quadCount << 1 | static_cast<uint32_t>(flipped));
+            ++quadCount;
+        });
+    }
+}
+
+uint32_t ChunkMesher::cellVertex(ChunkMesh& mesh, const glm::ivec3& cell) {
+    int index = (cell.x + 1) + (cell.y + 1) * CELLS + (cell.z + 1) * CELLS * CELLS;
+    int32_t& vertex = cellVertices[index];
+    if (vertex >= 0) {
+        return static_cast<uint32_t>(vertex);
+    }
+    // Cells on the chunk border read the padded block, so both chunks place their vertex identically
+    int padded = (cell.x + 1) + (cell.y + 1) * PADDED + (cell.z + 1) * PADDED * PADDED;
+    int filled = 0;
+    for (int i = 0; i < 8; ++i) {
+        filled |= (block[padded + cellCorners[i]] != MaterialRegistry::NONE) << i;
+    }
+    const SmoothCell& entry = smoothCellTable[filled];
+    uint32_t x = (cell.x + 1) * 16 + entry.offset[0];
+    uint32_t y = (cell.y + 1) * 16 + entry.offset[1];
+    uint32_t z = (cell.z + 1) * 16 + entry.offset[2];
+    uint32_t material = block[padded + cellCorners[entry.corner]];
+    vertex = static_cast<int32_t>(mesh.vertices.size());
+    mesh.vertices.push_back(PackedVertex::fromWords(x | y << 10 | z << 20, material | entry.normal << 16));
+    usedCells.push_back(index);
+    return static_cast<uint32_t>(vertex);
+}
+
+void ChunkMesher::meshSmooth(ChunkMesh& mesh) {
+    const MaterialRegistry& registry = MaterialRegistry::global();
+    const int N = VoxelChunk::SIZE;
+    const int quadCorners[4][2] = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 1 } }; // Same walk as addQuad
+    MaterialId lastMaterial = MaterialRegistry::NONE;
+    std::vector<unsigned int>* lastBucket = nullptr;
+
+    // Every visible face crosses the edge between its voxel's centre and the empty one in
+    // front. The four cells around that edge give the quad, so the triangles match the
+    // face count of MESH_FACES while neighbouring quads share their vertices.
+    for (int face = 0; face < 6; ++face) {
+        const FaceAxes& axes = faceAxes[face];
+        const uint32_t* bits = &faceBits[face * FACE_COLUMNS];
+        for (int column = 0; column < FACE_COLUMNS; ++column) {
+            glm::ivec3 local;
+            local[axes.u] = column % N;
+            local[axes.v] = column / N;
+            for (uint64_t visible = bits[column]; visible != 0; visible &= visible - 1) {
+                local[axes.normal] = countTrailingZeros(visible);
+                MaterialId material = block[(local.x + 1) + (local.y + 1) * PADDED + (local.z + 1) * PADDED * PADDED];
+                if (material != lastMaterial) {
+                    lastMaterial = material;
+                    lastBucket = &bucketFor(registry.get(material).texture);
+                }
+                glm::ivec3 low = local; // Lower end of the crossing edge
+                low[axes.normal] -= 1 - axes.side;
+                uint32_t corners[4];
+                for (int i = 0; i < 4; ++i) {
+                    glm::ivec3 cell = low;
+                    cell[axes.u] += quadCorners[i][0] - 1;
+                    cell[axes.v] += quadCorners[i][1] - 1;
+                    corners[i] = cellVertex(mesh, cell);
+                }
+                for (int i = 0; i < 6; ++i) {
+                    lastBucket->push_back(corners[faceIndices[i]]);
+                }
+            }
+        }
+    }
+
+    for (int index : usedCells) {
+        cellVertices[index] = -1;
+    }
+    usedCells.clear();
+    mesh.smooth = true;
+}
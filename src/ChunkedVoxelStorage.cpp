@@ -0,0 +1,145 @@
+#include "ChunkedVoxelStorage.h"
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <atomic>
+
+namespace {
+    // Calls fn(chunkPos, chunk) for every stored chunk that overlaps the inclusive box.
+    // Small boxes look their chunks up directly; large ones filter the chunk list instead.
+    template <typename Map, typename Fn>
+    void forEachOverlappingChunk(const Map& chunks, const glm::ivec3& regionMin, const glm::ivec3& regionMax, Fn fn) {
+        glm::ivec3 chunkMin = VoxelChunk::chunkCoord(regionMin);
+        glm::ivec3 chunkMax = VoxelChunk::chunkCoord(regionMax);
+        glm::ivec3 span = chunkMax - chunkMin + 1;
+        if (static_cast<double>(span.x) * span.y * span.z <= static_cast<double>(chunks.size())) {
+            for (int z = chunkMin.z; z <= chunkMax.z; ++z) {
+                for (int y = chunkMin.y; y <= chunkMax.y; ++y) {
+                    for (int x = chunkMin.x; x <= chunkMax.x; ++x) {
+                        glm::ivec3 chunkPos(x, y, z);
+                        if (const auto* chunk = chunks.find(chunkPos)) {
+                            fn(chunkPos, **chunk);
+                        }
+                    }
+                }
+            }
+            return;
+        }
+        for (const auto& chunkPair : chunks) {
+            const glm::ivec3& chunkPos = chunkPair.first;
+            if (glm::all(glm::greaterThanEqual(chunkPos, chunkMin)) && glm::all(glm::lessThanEqual(chunkPos, chunkMax))) {
+                fn(chunkPos, *chunkPair.second);
+            }
+        }
+    }
+}
+
+ChunkedVoxelStorage::ChunkedVoxelStorage() : voxelCount(0) {}
+
+VoxelChunk& ChunkedVoxelStorage::writable(std::shared_ptr<VoxelChunk>& chunk) {
+    // Only the owning thread copies or edits this table, so a count of one means nobody else can see the chunk
+    if (chunk.use_count() > 1) {
+        chunk = std::make_shared<VoxelChunk>(*chunk);
+    } else {
+        // use_count is a relaxed load; a reader that just dropped the last other reference
+        // must have finished reading the chunk before we write to it
+        std::atomic_thread_fence(std::memory_order_acquire);
+    }
+    return *chunk;
+}
+
+const VoxelChunk* ChunkedVoxelStorage::findChunk(const glm::ivec3& chunkPos) const {
+    const std::shared_ptr<VoxelChunk>* chunk = chunks.find(chunkPos);
+    return chunk ? chunk->get() : nullptr;
+}
+
+MaterialId ChunkedVoxelStorage::getVoxel(const glm::ivec3& position) const {
+    const VoxelChunk* chunk = findChunk(VoxelChunk::chunkCoord(position));
+    if (!chunk) {
+        return MaterialRegistry::NONE;
+    }
+    int index = VoxelChunk::localIndex(VoxelChunk::localCoord(position));
+    return chunk->hasVoxel(index) ? chunk->getMaterial(index) : MaterialRegistry::NONE;
+}
+
+void ChunkedVoxelStorage::setVoxel(const glm::ivec3& position, MaterialId material) {
+    if (!canHold(position)) {
+        std::cout << "Voxel (" << position.x << ", " << position.y << ", " << position.z << ") is outside the chunk key range" << std::endl;
+        return;
+    }
+    glm::ivec3 chunkPos = VoxelChunk::chunkCoord(position);
+    int index = VoxelChunk::localIndex(VoxelChunk::localCoord(position));
+
+    if (material == MaterialRegistry::NONE) {
+        std::shared_ptr<VoxelChunk>* chunk = chunks.find(chunkPos);
+        if (!chunk || !(*chunk)->hasVoxel(index)) {
+            return;
+        }
+        --voxelCount;
+        if ((*chunk)->getVoxelCount() == 1) {
+            chunks.erase(chunkPos); // Drop chunks that no longer hold anything
+            return;
+        }
+        writable(*chunk).removeVoxel(index);
+        return;
+    }
+
+    std::shared_ptr<VoxelChunk>& chunk = chunks[chunkPos];
+    if (!chunk) {
+        chunk = std::make_shared<VoxelChunk>();
+    } else if (chunk->hasVoxel(index) && chunk->getMaterial(index) == material) {
+        return; // Unchanged, don't clone a shared chunk for nothing
+    }
+    if (!chunk->hasVoxel(index)) {
+        ++voxelCount;
+    }
+    writable(chunk).setVoxel(index, material);
+}
+
+void ChunkedVoxelStorage::forEachVoxel(const glm::ivec3& regionMin, const glm::ivec3& regionMax, const VoxelVisitor& visitor) const {
+    forEachOverlappingChunk(chunks, regionMin, regionMax, [&](const glm::ivec3& chunkPos, const VoxelChunk& chunk) {
+        glm::ivec3 origin = VoxelChunk::chunkOrigin(chunkPos);
+        bool inside = glm::all(glm::greaterThanEqual(origin, regionMin))
+            && glm::all(glm::lessThanEqual(origin + (VoxelChunk::SIZE - 1), regionMax));
+        chunk.forEachVoxel([&](int index) {
+            glm::ivec3 position = origin + VoxelChunk::localPosition(index);
+            if (inside || (glm::all(glm::greaterThanEqual(position, regionMin)) && glm::all(glm::lessThanEqual(position, regionMax)))) {
+                visitor(position, chunk.getMaterial(index));
+            }
+        });
+    });
+}
+
+void ChunkedVoxelStorage::forEachChunk(const ChunkVisitor& visitor) const {
+    for (const auto& chunkPair : chunks) {
+        visitor(chunkPair.first);
+    }
+}
+
+void ChunkedVoxelStorage::readRegion(const glm::ivec3& regionMin, const glm::ivec3& extent, MaterialId* out) const {
+    std::fill(out, out + static_cast<size_t>(extent.x) * extent.y * extent.z, MaterialRegistry::NONE);
+    glm::ivec3 regionMax = regionMin + extent - 1;
+
+    forEachOverlappingChunk(chunks, regionMin, regionMax, [&](const glm::ivec3& chunkPos, const VoxelChunk& chunk) {
+        glm::ivec3 origin = VoxelChunk::chunkOrigin(chunkPos);
+        glm::ivec3 from = glm::max(regionMin, origin) - origin;
+        glm::ivec3 to = glm::min(regionMax, origin + (VoxelChunk::SIZE - 1)) - origin;
+        uint32_t rowMask = to.x - from.x == VoxelChunk::MASK ? ~0u : ((1u << (to.x - from.x + 1)) - 1) << from.x;
+
+        for (int z = from.z; z <= to.z; ++z) {
+            for (int y = from.y; y <= to.y; ++y) {
+                // Offset of local x = 0 in out; can be negative but every x read below lands inside the region
+                std::ptrdiff_t rowBase = (static_cast<std::ptrdiff_t>(origin.z + z - regionMin.z) * extent.y + (origin.y + y - regionMin.y)) * extent.x
+                    + (origin.x - regionMin.x);
+                // Only touch the filled slots of each row
+                uint32_t bits = chunk.getRowOccupancy(y, z) & rowMask;
+                int rowStart = VoxelChunk::localIndex(0, y, z);
+                while (bits) {
+                    int x = countTrailingZeros(bits);
+                    bits &= bits - 1;
+                    out[rowBase + x] = chunk.getMaterial(rowStart + x);
+                }
+            }
+        }
+    });
+}
@@ -0,0 +1,99 @@
+#include "DenseGridStorage.h"
+#include "VoxelChunk.h"
+#include <algorithm>
+#include <iostream>
+
+DenseGridStorage::DenseGridStorage(int size) : size(std::max(size, 1)), voxelCount(0) {
+    strideY = this->size + 2;
+    strideZ = strideY * strideY;
+    cells.assign(strideZ * strideY, MaterialRegistry::NONE);
+    chunksPerAxis = (this->size + VoxelChunk::MASK) >> VoxelChunk::SHIFT;
+    chunkCounts.assign(static_cast<size_t>(chunksPerAxis) * chunksPerAxis * chunksPerAxis, 0);
+}
+
+void DenseGridStorage::setVoxel(const glm::ivec3& position, MaterialId material) {
+    if (!contains(position)) {
+        std::cout << "Voxel (" << position.x << ", " << position.y << ", " << position.z << ") is outside the " << size << "^3 grid" << std::endl;
+        return;
+    }
+    size_t index = cellIndex(position);
+    MaterialId cell = cells[index];
+    if (cell == material) {
+        return; // Leave shared pages alone
+    }
+    if ((cell == MaterialRegistry::NONE) != (material == MaterialRegistry::NONE)) {
+        glm::ivec3 chunkPos = VoxelChunk::chunkCoord(position);
+        uint32_t& count = chunkCounts[(static_cast<size_t>(chunkPos.z) * chunksPerAxis + chunkPos.y) * chunksPerAxis + chunkPos.x];
+        if (material == MaterialRegistry::NONE) {
+            --count;
+            --voxelCount;
+        } else {
+            ++count;
+            ++voxelCount;
+        }
+    }
+    cells.write(index) = material;
+}
+
+void DenseGridStorage::forEachVoxel(const glm::ivec3& regionMin, const glm::ivec3& regionMax, const VoxelVisitor& visitor) const {
+    glm::ivec3 from = glm::max(regionMin, glm::ivec3(0));
+    glm::ivec3 to = glm::min(regionMax, glm::ivec3(size - 1));
+    for (int z = from.z; z <= to.z; ++z) {
+        for (int y = from.y; y <= to.y; ++y) {
+            size_t row = cellIndex(glm::ivec3(0, y, z));
+            for (int x = from.x; x <= to.x; ++x) {
+                MaterialId material = cells[row + x];
+                if (material != MaterialRegistry::NONE) {
+                    visitor(glm::ivec3(x, y, z), material);
+                }
+            }
+        }
+    }
+}
+
+bool DenseGridStorage::hasChunk(const glm::ivec3& chunkPos) const {
+    if (glm::any(glm::lessThan(chunkPos, glm::ivec3(0))) || glm::any(glm::greaterThanEqual(chunkPos, glm::ivec3(chunksPerAxis)))) {
+        return false;
+    }
+    return chunkCounts[(static_cast<size_t>(chunkPos.z) * chunksPerAxis + chunkPos.y) * chunksPerAxis + chunkPos.x] != 0;
+}
+
+void DenseGridStorage::forEachChunk(const ChunkVisitor& visitor) const {
+    size_t index = 0;
+    for (int z = 0; z < chunksPerAxis; ++z) {
+        for (int y = 0; y < chunksPerAxis; ++y) {
+            for (int x = 0; x < chunksPerAxis; ++x, ++index) {
+                if (chunkCounts[index] != 0) {
+                    visitor(glm::ivec3(x, y, z));
+                }
+            }
+        }
+    }
+}
+
+void DenseGridStorage::readRegion(const glm::ivec3& regionMin, const glm::ivec3& extent, MaterialId* out) const {
+    // The stored border already reads as empty, so only the part beyond it needs filling
+    glm::ivec3 from = glm::max(regionMin, glm::ivec3(-1));
+    glm::ivec3 to = glm::min(regionMin + extent - 1, glm::ivec3(size));
+    if (glm::any(glm::greaterThan(from, to)) || from != regionMin || to != regionMin + extent - 1) {
+        std::fill(out, out + static_cast<size_t>(extent.x) * extent.y * extent.z, MaterialRegistry::NONE);
+    }
+    if (glm::any(glm::greaterThan(from, to))) {
+        return;
+    }
+    size_t rowLength = to.x - from.x + 1;
+    for (int z = from.z; z <= to.z; ++z) {
+        MaterialId* target = out + (static_cast<size_t>(z - regionMin.z) * extent.y + (from.y - regionMin.y)) * extent.x + (from.x - regionMin.x);
+        size_t first = cellIndex(glm::ivec3(from.x, from.y, z));
+        // Usually the whole slice sits in one page, so its rows copy straight out of it
+        if (const MaterialId* slice = cells.span(first, cellIndex(glm::ivec3(to.x, to.y, z)))) {
+            for (int y = from.y; y <= to.y; ++y, slice += strideY, target += extent.x) {
+                std::copy(slice, slice + rowLength, target);
+            }
+            continue;
+        }
+        for (int y = from.y; y <= to.y; ++y, first += strideY, target += extent.x) {
+            cells.read(first, rowLength, target);
+        }
+    }
+}
@@ -174,26 +174,33 @@ void ExtrusionManager::updateExtrusion(const glm::dvec2& currentMousePos, VoxelW
 
 void ExtrusionManager::addVoxels(int layers, VoxelWorld& voxelWorld) {
     //std::cout << "Adding Voxels: " << layers << " layers" << std::endl;
+    MaterialId material = MaterialRegistry::global().getMaterial(1, MaterialRegistry::colorFromName("white"), "default");
+    std::vector<std::pair<glm::ivec3, MaterialId>> added;
+    added.reserve(selectedVoxels.size() * layers);
     for (const auto& voxel : selectedVoxels) {
         for (int i = 0; i < layers; ++i) {
             glm::ivec3 newVoxelPos = voxel + glm::ivec3(extrusionNormal * static_cast<float>(currentLayers + 1 + i));
-            voxelWorld.setVoxel(newVoxelPos.x, newVoxelPos.y, newVoxelPos.z, 1, "white", "default");
+            added.emplace_back(newVoxelPos, material);
             newVoxels.insert(newVoxelPos);
             //std::cout << "Added voxel at: " << glm::to_string(newVoxelPos) << std::endl;
         }
     }
+    voxelWorld.setVoxels(added); // Single remesh for every layer added
 }
 
 void ExtrusionManager::removeVoxels(int layers, VoxelWorld& voxelWorld) {
     //std::cout << "Removing Voxels: " << layers << " layers" << std::endl;
+    std::vector<glm::ivec3> removed;
+    removed.reserve(selectedVoxels.size() * layers);
     for (const auto& voxel : selectedVoxels) {
         for (int i = 0; i < layers; ++i) {
             glm::ivec3 voxelToRemove = voxel + glm::ivec3(extrusionNormal * static_cast<float>(currentLayers - 1 - i));
-            voxelWorld.removeVoxel(voxelToRemove); // Use the new method to remove the voxel
+            removed.push_back(voxelToRemove);
             newVoxels.erase(voxelToRemove);
             //std::cout << "Removed voxel at: " << glm::to_string(voxelToRemove) << std::endl;
         }
     }
+    voxelWorld.removeVoxels(removed); // Single remesh instead of one per voxel
 }
 
 
@@ -225,7 +232,7 @@ glm::ivec3 ExtrusionManager::getExtrusionStart() const {
     return extrusionStart;
 }
 
-void ExtrusionManager::setSelectedVoxels(const std::unordered_set<glm::ivec3>& selectedVoxels) {
+void ExtrusionManager::setSelectedVoxels(const VoxelHashSet& selectedVoxels) {
     this->selectedVoxels = selectedVoxels;
 }
 
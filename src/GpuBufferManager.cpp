@@ -0,0 +1,244 @@
+#include "GpuBufferManager.h"
+#include <iostream>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+
+StreamBuffer::StreamBuffer()
+    : buffer(0), mapped(nullptr), regionSize(0), head(0), frame(0), frameStarted(false), persistent(false) {
+    for (GLsync& fence : fences) {
+        fence = nullptr;
+    }
+}
+
+void StreamBuffer::create(size_t bytesPerFrame) {
+    regionSize = bytesPerFrame;
+    persistent = GLEW_ARB_buffer_storage != 0;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    if (persistent) {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_COPY_READ_BUFFER, regionSize * FRAMES, nullptr, flags);
+        mapped = static_cast<unsigned char*>(glMapBufferRange(GL_COPY_READ_BUFFER, 0, regionSize * FRAMES, flags));
+        if (!mapped) {
+            // Immutable storage cannot be respecified, so start over with a plain buffer
+            std::cout << "StreamBuffer: persistent mapping failed, orphaning instead" << std::endl;
+            persistent = false;
+            glDeleteBuffers(1, &buffer);
+            glGenBuffers(1, &buffer);
+            glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        }
+    }
+    if (!persistent) {
+        glBufferData(GL_COPY_READ_BUFFER, regionSize, nullptr, GL_STREAM_DRAW);
+    }
+}
+
+void StreamBuffer::destroy() {
+    for (GLsync& fence : fences) {
+        if (fence) {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+    if (mapped) {
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glUnmapBuffer(GL_COPY_READ_BUFFER);
+        mapped = nullptr;
+    }
+    glDeleteBuffers(1, &buffer);
+    buffer = 0;
+    frameStarted = false;
+}
+
+void StreamBuffer::beginFrame() {
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    if (persistent) {
+        // The region was last written FRAMES frames ago, so its copies have nearly always finished
+        if (fences[frame]) {
+            while (glClientWaitSync(fences[frame], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {
+            }
+            glDeleteSync(fences[frame]);
+            fences[frame] = nullptr;
+        }
+    } else {
+        // Orphaning: copies still queued keep reading the old storage, this frame gets fresh memory
+        glBufferData(GL_COPY_READ_BUFFER, regionSize, nullptr, GL_STREAM_DRAW);
+    }
+    head = 0;
+    frameStarted = true;
+}
+
+bool StreamBuffer::copyTo(GLuint target, size_t offset, const void* data, size_t bytes) {
+    if (!frameStarted) {
+        beginFrame();
+    }
+    if (bytes > regionSize - head) {
+        return false;
+    }
+    size_t source = head;
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    if (persistent) {
+        source += frame * regionSize;
+        std::memcpy(mapped + source, data, bytes);
+    } else {
+        // Nothing has read this range since the orphan, so there is nothing to wait for
+        void* destination = glMapBufferRange(GL_COPY_READ_BUFFER, head, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (!destination) {
+            return false;
+        }
+        std::memcpy(destination, data, bytes);
+        glUnmapBuffer(GL_COPY_READ_BUFFER);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, target);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, source, offset, bytes);
+    head = std::min(regionSize, head + ((bytes + 15) & ~size_t(15)));
+    return true;
+}
+
+void StreamBuffer::endFrame() {
+    if (!frameStarted) {
+        return; // Nothing staged, the region is still free
+    }
+    if (persistent) {
+        fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    frame = (frame + 1) % FRAMES;
+    frameStarted = false;
+}
+
+void GpuBufferManager::create() {
+    stream.create(STREAM_BYTES_PER_FRAME);
+}
+
+void GpuBufferManager::destroy() {
+    for (auto chunkPair : chunks) {
+        releaseBuffers(chunkPair.second);
+    }
+    chunks.clear();
+    culler.clear();
+    boxChunks.clear();
+    stream.destroy();
+}
+
+void GpuBufferManager::releaseBuffers(ChunkBuffers& buffers) {
+    glDeleteVertexArrays(1, &buffers.VAO);
+    glDeleteBuffers(1, &buffers.VBO);
+    glDeleteBuffers(1, &buffers.EBO);
+}
+
+void GpuBufferManager::release(const glm::ivec3& chunkPos) {
+    ChunkBuffers* buffers = chunks.find(chunkPos);
+    if (!buffers) {
+        return;
+    }
+    // The culler moves its last box into the freed slot, so that chunk learns its new index
+    uint32_t box = buffers->box;
+    culler.remove(box);
+    boxChunks[box] = boxChunks.back();
+    boxChunks.pop_back();
+    if (box < boxChunks.size()) {
+        chunks.find(boxChunks[box])->box = box;
+    }
+    releaseBuffers(*buffers);
+    chunks.erase(chunkPos);
+}
+
+void GpuBufferManager::findVisible(const Frustum& frustum, std::vector<glm::ivec3>& visible) {
+    culler.cull(frustum, visibleBoxes);
+    visible.clear();
+    for (uint32_t box : visibleBoxes) {
+        visible.push_back(boxChunks[box]);
+    }
+}
+
+void GpuBufferManager::write(GLuint target, size_t offset, const void* data, size_t bytes) {
+    if (bytes == 0) {
+        return;
+    }
+    if (!stream.copyTo(target, offset, data, bytes)) {
+        // This frame's staging is used up, e.g. while a whole scene loads: upload directly
+        glBindBuffer(GL_COPY_WRITE_BUFFER, target);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, offset, bytes, data);
+    }
+}
+
+bool GpuBufferManager::upload(const glm::ivec3& chunkPos, const ChunkMesh& mesh) {
+    ChunkBuffers* buffers = chunks.find(chunkPos);
+    if (buffers && buffers->generation == mesh.generation) {
+        return false;
+    }
+    if (!buffers) {
+        buffers = &chunks[chunkPos];
+        buffers->vertexCapacity = 0;
+        buffers->indexCapacity = 0;
+        // The whole chunk plus a voxel of margin: smooth vertices reach a little past its faces
+        glm::vec3 origin(VoxelChunk::chunkOrigin(chunkPos));
+        buffers->box = static_cast<uint32_t>(culler.add(origin - 1.0f, origin + static_cast<float>(VoxelChunk::SIZE + 1)));
+        boxChunks.push_back(chunkPos);
+        glGenVertexArrays(1, &buffers->VAO);
+        glGenBuffers(1, &buffers->VBO);
+        glGenBuffers(1, &buffers->EBO);
+        glBindVertexArray(buffers->VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, buffers->VBO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers->EBO);
+        // Integer attributes; the vertex shader unpacks them, see PackedVertex
+        glVertexAttribIPointer(0, 1, GL_UNSIGNED_INT, sizeof(PackedVertex), (void*)offsetof(PackedVertex, position));
+        glEnableVertexAttribArray(0);
+        glVertexAttribIPointer(1, 1, GL_UNSIGNED_INT, sizeof(PackedVertex), (void*)offsetof(PackedVertex, material));
+        glEnableVertexAttribArray(1);
+        glBindVertexArray(0);
+    }
+    size_t vertexCount = mesh.vertices.size();
+    size_t indexCount = mesh.indices.size();
+    for (const ChunkMesh& lod : mesh.lods) {
+        vertexCount += lod.vertices.size();
+        indexCount += lod.indices.size();
+    }
+    // A quarter of headroom, so a chunk that grows by a few faces keeps its allocation.
+    // Everything else goes through the copy target, which leaves the VAO bindings alone.
+    if (vertexCount > buffers->vertexCapacity || vertexCount * 4 < buffers->vertexCapacity) {
+        buffers->vertexCapacity = vertexCount + vertexCount / 4;
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffers->VBO);
+        glBufferData(GL_COPY_WRITE_BUFFER, buffers->vertexCapacity * sizeof(PackedVertex), nullptr, GL_STATIC_DRAW);
+    }
+    if (indexCount > buffers->indexCapacity || indexCount * 4 < buffers->indexCapacity) {
+        buffers->indexCapacity = indexCount + indexCount / 4;
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffers->EBO);
+        glBufferData(GL_COPY_WRITE_BUFFER, buffers->indexCapacity * sizeof(unsigned int), nullptr, GL_STATIC_DRAW);
+    }
+    buffers->levels.clear();
+    size_t firstVertex = 0;
+    size_t firstIndex = 0;
+    for (size_t level = 0; level <= mesh.lods.size(); ++level) {
+        const ChunkMesh& source = level == 0 ? mesh : mesh.lods[level - 1];
+        write(buffers->VBO, firstVertex * sizeof(PackedVertex), source.vertices.data(), source.vertices.size() * sizeof(PackedVertex));
+        write(buffers->EBO, firstIndex * sizeof(unsigned int), source.indices.data(), source.indices.size() * sizeof(unsigned int));
+        ChunkLevel chunkLevel;
+        chunkLevel.baseVertex = static_cast<GLint>(firstVertex);
+        chunkLevel.textureRanges = source.textureRanges;
+        for (TextureRange& range : chunkLevel.textureRanges) {
+            range.firstIndex += static_cast<uint32_t>(firstIndex);
+        }
+        buffers->levels.push_back(chunkLevel);
+        firstVertex += source.vertices.size();
+        firstIndex += source.indices.size();
+    }
+    buffers->indexCount = static_cast<GLsizei>(indexCount);
+    buffers->smooth = mesh.smooth;
+    buffers->generation = mesh.generation;
+    return true;
+}
+
+void GpuBufferManager::patch(const glm::ivec3& chunkPos, const ChunkMesh& mesh, uint32_t firstVertex, uint32_t vertexCount) {
+    ChunkBuffers* buffers = chunks.find(chunkPos);
+    if (!buffers || static_cast<size_t>(firstVertex) + vertexCount > mesh.vertices.size()) {
+        return;
+    }
+    write(buffers->VBO, firstVertex * sizeof(PackedVertex), &mesh.vertices[firstVertex], vertexCount * sizeof(PackedVertex));
+    buffers->generation = mesh.generation;
+}
+
+void GpuBufferManager::endFrame() {
+    stream.endFrame();
+}
@@ -0,0 +1,123 @@
+#include "JobSystem.h"
+#include <algorithm>
+
+JobSystem& JobSystem::global() {
+    static JobSystem jobSystem;
+    return jobSystem;
+}
+
+JobSystem::JobSystem(unsigned threadCount) : queued(0), stopping(false) {
+    if (threadCount == 0) {
+        unsigned cores = std::thread::hardware_concurrency();
+        threadCount = cores > 1 ? cores - 1 : 0; // The caller is the last core
+    }
+    for (unsigned i = 0; i <= threadCount; ++i) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    for (unsigned i = 1; i <= threadCount; ++i) {
+        threads.emplace_back(&JobSystem::workerLoop, this, i);
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+bool JobSystem::runOne(unsigned worker) {
+    Job job;
+    size_t workerCount = queues.size();
+    // Own queue first, from the front; then the others, from the back
+    for (size_t i = 0; i < workerCount && !job; ++i) {
+        Queue& queue = *queues[(worker + i) % workerCount];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.jobs.empty()) {
+            continue;
+        }
+        if (i == 0) {
+            job = std::move(queue.jobs.front());
+            queue.jobs.pop_front();
+        } else {
+            job = std::move(queue.jobs.back());
+            queue.jobs.pop_back();
+        }
+    }
+    if (!job) {
+        return false;
+    }
+    queued.fetch_sub(1, std::memory_order_relaxed);
+    job(worker);
+    return true;
+}
+
+void JobSystem::workerLoop(unsigned worker) {
+    for (;;) {
+        if (runOne(worker)) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        wake.wait(lock, [this]() { return stopping || queued.load(std::memory_order_relaxed) > 0; });
+        if (stopping) {
+            return;
+        }
+    }
+}
+
+void JobSystem::parallelFor(size_t count, const std::function<void(size_t index, unsigned worker)>& job) {
+    if (count == 0) {
+        return;
+    }
+    if (count == 1 || queues.size() == 1) {
+        for (size_t i = 0; i < count; ++i) {
+            job(i, 0);
+        }
+        return;
+    }
+
+    std::lock_guard<std::mutex> batchLock(batchMutex);
+    std::atomic<size_t> remaining(count);
+    std::mutex doneMutex;
+    std::condition_variable done;
+    bool finished = false; // Set under doneMutex, so the last job is done with it before we return
+
+    // Deal the jobs out in contiguous runs so neighbouring chunks start on the same worker
+    size_t workerCount = queues.size();
+    size_t perWorker = (count + workerCount - 1) / workerCount;
+    for (size_t worker = 0; worker < workerCount; ++worker) {
+        size_t first = worker * perWorker;
+        size_t last = std::min(count, first + perWorker);
+        if (first >= last) {
+            break;
+        }
+        queued.fetch_add(last - first, std::memory_order_relaxed); // Before the push, so a fast taker never underflows it
+        Queue& queue = *queues[worker];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        for (size_t index = first; index < last; ++index) {
+            queue.jobs.push_back([&, index](unsigned runner) {
+                job(index, runner);
+                if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    std::lock_guard<std::mutex> doneLock(doneMutex);
+                    finished = true;
+                    done.notify_one();
+                }
+            });
+        }
+    }
+    {
+        // A worker between its empty check and its wait holds wakeMutex, so this cannot slip past it
+        std::lock_guard<std::mutex> lock(wakeMutex);
+    }
+    wake.notify_all();
+
+    while (runOne(0)) {
+    }
+    // Whatever is left is already running on other workers
+    std::unique_lock<std::mutex> lock(doneMutex);
+    done.wait(lock, [&]() { return finished; });
+}
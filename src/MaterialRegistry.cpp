@@ -0,0 +1,137 @@
+#include "MaterialRegistry.h"
+#include <iostream>
+#include <cstring>
+#include <limits>
+
+MaterialRegistry& MaterialRegistry::global() {
+    static MaterialRegistry registry;
+    return registry;
+}
+
+MaterialRegistry::MaterialRegistry() : count(0), reportedFull(false) {
+    // Slot 0 stands for "no material" so storage can use zero as empty
+    textures.push_back({ "", 0 });
+    textureLookup[""] = 0;
+    blocks[0].reset(new Material[1 << BLOCK_SHIFT]);
+    blocks[0][0] = { 0, glm::vec3(1.0f), 0, 0 };
+    count.store(1, std::memory_order_release);
+}
+
+// FNV-1a over the fields that make a material, with the texture by name, as its id differs between runs
+static uint64_t contentHash(int type, const glm::vec3& color, const std::string& textureName) {
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&hash](const void* data, size_t length) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < length; ++i) {
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+    };
+    mix(&type, sizeof(type));
+    mix(&color, sizeof(color));
+    mix(textureName.data(), textureName.size());
+    return hash ? hash : 1; // 0 stays with NONE
+}
+
+std::size_t MaterialRegistry::MaterialKeyHasher::operator()(const MaterialKey& key) const {
+    uint32_t bits[3];
+    std::memcpy(bits, &key.color, sizeof(bits));
+    std::size_t hash = std::hash<int>()(key.type);
+    for (uint32_t b : bits) {
+        hash = hash * 31 + b;
+    }
+    return hash * 31 + key.texture;
+}
+
+MaterialId MaterialRegistry::getMaterial(int type, const glm::vec3& color, TextureId texture) {
+    std::lock_guard<std::mutex> lock(mutex);
+    MaterialKey key = { type, color, texture };
+    auto it = lookup.find(key);
+    if (it != lookup.end()) {
+        return it->second;
+    }
+
+    size_t id = count.load(std::memory_order_relaxed);
+    if (id >= MAX_MATERIALS) {
+        // NONE would mean "empty" and delete the voxel, so hand out the closest existing material instead
+        if (!reportedFull) {
+            std::cout << "MaterialRegistry is full, reusing the closest existing material" << std::endl;
+            reportedFull = true;
+        }
+        return findClosest(key);
+    }
+    std::unique_ptr<Material[]>& block = blocks[id >> BLOCK_SHIFT];
+    if (!block) {
+        block.reset(new Material[1 << BLOCK_SHIFT]);
+    }
+    block[id & BLOCK_MASK] = { type, color, texture, contentHash(type, color, textures[texture].name) };
+    lookup[key] = static_cast<MaterialId>(id);
+    count.store(id + 1, std::memory_order_release);
+    return static_cast<MaterialId>(id);
+}
+
+MaterialId MaterialRegistry::findClosest(const MaterialKey& key) const {
+    MaterialId best = NONE;
+    float bestScore = std::numeric_limits<float>::max();
+    for (size_t id = 1; id < MAX_MATERIALS; ++id) {
+        const Material& material = get(static_cast<MaterialId>(id));
+        glm::vec3 delta = material.color - key.color;
+        float score = glm::dot(delta, delta);
+        // A different type or texture always loses to any colour match
+        if (material.type != key.type || material.texture != key.texture) {
+            score += 4.0f;
+        }
+        if (score < bestScore) {
+            bestScore = score;
+            best = static_cast<MaterialId>(id);
+        }
+    }
+    return best;
+}
+
+MaterialId MaterialRegistry::getMaterial(int type, const glm::vec3& color, const std::string& texture) {
+    return getMaterial(type, color, getTexture(texture));
+}
+
+TextureId MaterialRegistry::getTexture(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = textureLookup.find(name);
+    if (it != textureLookup.end()) {
+        return it->second;
+    }
+    if (textures.size() > std::numeric_limits<TextureId>::max()) {
+        std::cout << "Too many textures, " << name << " will be drawn untextured" << std::endl;
+        return 0;
+    }
+    TextureId id = static_cast<TextureId>(textures.size());
+    textures.push_back({ name, 0 });
+    textureLookup[name] = id;
+    return id;
+}
+
+std::string MaterialRegistry::getTextureName(TextureId id) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return textures[id].name;
+}
+
+unsigned int MaterialRegistry::getTextureHandle(TextureId id) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return textures[id].handle;
+}
+
+void MaterialRegistry::setTextureHandle(TextureId id, unsigned int handle) {
+    std::lock_guard<std::mutex> lock(mutex);
+    textures[id].handle = handle;
+}
+
+glm::vec3 MaterialRegistry::colorFromName(const std::string& name) {
+    if (name == "red") {
+        return glm::vec3(1.0f, 0.0f, 0.0f);
+    } else if (name == "green") {
+        return glm::vec3(0.0f, 1.0f, 0.0f);
+    } else if (name == "blue") {
+        return glm::vec3(0.0f, 0.0f, 1.0f);
+    } else if (name == "gray") {
+        return glm::vec3(0.5f, 0.5f, 0.5f); // Temporary voxel color
+    }
+    return glm::vec3(1.0f, 1.0f, 1.0f);
+}
@@ -0,0 +1,483 @@
+#include "MeshCache.h"
+#include "MaterialRegistry.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+// Bump whenever ChunkMesher's output or the file layout changes, so stale files on disk stop matching
+static constexpr uint32_t MESH_FORMAT_VERSION = 1;
+static constexpr char FILE_MAGIC[4] = { 'P', 'X', 'M', 'C' };
+static constexpr uint32_t MAX_FILE_ELEMENTS = 1u << 24; // Guards the allocations against damaged counts
+static constexpr int MAX_FILE_DEPTH = ChunkMesher::MAX_LOD_LEVELS + 1;
+
+static uint64_t mixKey(uint64_t key, uint64_t value) {
+    key = (key ^ value) * 0x9E3779B97F4A7C15ull;
+    return key ^ (key >> 29);
+}
+
+static size_t meshBytes(const ChunkMesh& mesh) {
+    size_t bytes = sizeof(ChunkMesh)
+        + mesh.vertices.size() * sizeof(PackedVertex)
+        + mesh.indices.size() * sizeof(unsigned int)
+        + mesh.textureRanges.size() * sizeof(TextureRange)
+        + mesh.voxelQuads.size() * sizeof(VoxelQuad);
+    for (const ChunkMesh& lod : mesh.lods) {
+        bytes += meshBytes(lod);
+    }
+    return bytes;
+}
+
+// Files are written in the machine's byte order; they are a cache, not a document format
+template <typename T>
+static void writeValue(std::ostream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+static bool readValue(std::istream& in, T& value) {
+    in.read(reinterpret_cast<char*>(&value), sizeof(T));
+    return static_cast<bool>(in);
+}
+
+template <typename T>
+static void writeArray(std::ostream& out, const std::vector<T>& values) {
+    writeValue(out, static_cast<uint32_t>(values.size()));
+    out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+}
+
+// fill only stands in until the data is read, for types without a default constructor
+template <typename T>
+static bool readArray(std::istream& in, std::vector<T>& values, const T& fill = T()) {
+    uint32_t count;
+    if (!readValue(in, count) || count > MAX_FILE_ELEMENTS) {
+        return false;
+    }
+    values.assign(count, fill);
+    in.read(reinterpret_cast<char*>(values.data()), count * sizeof(T));
+    return static_cast<bool>(in);
+}
+
+static void writeString(std::ostream& out, const std::string& text) {
+    writeValue(out, static_cast<uint16_t>(text.size()));
+    out.write(text.data(), text.size());
+}
+
+static bool readString(std::istream& in, std::string& text) {
+    uint16_t length;
+    if (!readValue(in, length)) {
+        return false;
+    }
+    text.resize(length);
+    in.read(&text[0], length);
+    return static_cast<bool>(in);
+}
+
+static void collectIds(const ChunkMesh& mesh, std::vector<MaterialId>& materials, std::vector<TextureId>& textures) {
+    MaterialId last = MaterialRegistry::NONE;
+    for (const PackedVertex& vertex : mesh.vertices) {
+        MaterialId material = static_cast<MaterialId>(vertex.material & 0xFFFF);
+        if (material != last) {
+            materials.push_back(material);
+            last = material;
+        }
+    }
+    for (const TextureRange& range : mesh.textureRanges) {
+        textures.push_back(range.texture);
+    }
+    for (const ChunkMesh& lod : mesh.lods) {
+        collectIds(lod, materials, textures);
+    }
+}
+
+// Padding bytes of TextureRange and VoxelQuad are not written, so those go field by field
+static void writeMesh(std::ostream& out, const ChunkMesh& mesh) {
+    writeValue(out, static_cast<uint8_t>(mesh.smooth));
+    writeArray(out, mesh.vertices);
+    writeArray(out, mesh.indices);
+    writeValue(out, static_cast<uint32_t>(mesh.textureRanges.size()));
+    for (const TextureRange& range : mesh.textureRanges) {
+        writeValue(out, range.texture);
+        writeValue(out, range.firstIndex);
+        writeValue(out, range.indexCount);
+    }
+    writeValue(out, static_cast<uint32_t>(mesh.voxelQuads.size()));
+    for (const VoxelQuad& entry : mesh.voxelQuads) {
+        writeValue(out, entry.voxel);
+        writeValue(out, entry.quad);
+    }
+    writeValue(out, static_cast<uint32_t>(mesh.lods.size()));
+    for (const ChunkMesh& lod : mesh.lods) {
+        writeMesh(out, lod);
+    }
+}
+
+static bool readMesh(std::istream& in, ChunkMesh& mesh, int depth) {
+    uint8_t smooth;
+    uint32_t count;
+    if (depth > MAX_FILE_DEPTH || !readValue(in, smooth) || !readArray(in, mesh.vertices, PackedVertex::fromWords(0, 0)) || !readArray(in, mesh.indices)) {
+        return false;
+    }
+    mesh.smooth = smooth != 0;
+    if (!readValue(in, count) || count > MAX_FILE_ELEMENTS) {
+        return false;
+    }
+    mesh.textureRanges.resize(count);
+    for (TextureRange& range : mesh.textureRanges) {
+        if (!readValue(in, range.texture) || !readValue(in, range.firstIndex) || !readValue(in, range.indexCount)) {
+            return false;
+        }
+    }
+    if (!readValue(in, count) || count > MAX_FILE_ELEMENTS) {
+        return false;
+    }
+    mesh.voxelQuads.resize(count);
+    for (VoxelQuad& entry : mesh.voxelQuads) {
+        if (!readValue(in, entry.voxel) || !readValue(in, entry.quad)) {
+            return false;
+        }
+    }
+    if (!readValue(in, count) || count > ChunkMesher::MAX_LOD_LEVELS) {
+        return false;
+    }
+    mesh.lods.resize(count);
+    for (ChunkMesh& lod : mesh.lods) {
+        if (!readMesh(in, lod, depth + 1)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Rewrites the ids the file was saved with to the ones this run's registry hands out
+static bool remapMesh(ChunkMesh& mesh, const std::unordered_map<MaterialId, MaterialId>& materials, const std::unordered_map<TextureId, TextureId>& textures) {
+    MaterialId lastSaved = MaterialRegistry::NONE;
+    MaterialId lastCurrent = MaterialRegistry::NONE;
+    for (PackedVertex& vertex : mesh.vertices) {
+        MaterialId saved = static_cast<MaterialId>(vertex.material & 0xFFFF);
+        if (saved != lastSaved || lastCurrent == MaterialRegistry::NONE) {
+            auto found = materials.find(saved);
+            if (found == materials.end()) {
+                return false;
+            }
+            lastSaved = saved;
+            lastCurrent = found->second;
+        }
+        vertex.material = (vertex.material & 0xFFFF0000u) | lastCurrent;
+    }
+    for (TextureRange& range : mesh.textureRanges) {
+        auto found = textures.find(range.texture);
+        if (found == textures.end()) {
+            return false;
+        }
+        range.texture = found->second;
+    }
+    for (ChunkMesh& lod : mesh.lods) {
+        if (!remapMesh(lod, materials, textures)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Materials and textures are stored by content ahead of the mesh, as their ids differ between runs
+static bool writeMeshFile(const std::string& path, const ChunkMesh& mesh) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        return false;
+    }
+    std::vector<MaterialId> materials;
+    std::vector<TextureId> textures;
+    collectIds(mesh, materials, textures);
+    std::sort(materials.begin(), materials.end());
+    materials.erase(std::unique(materials.begin(), materials.end()), materials.end());
+    std::sort(textures.begin(), textures.end());
+    textures.erase(std::unique(textures.begin(), textures.end()), textures.end());
+
+    const MaterialRegistry& registry = MaterialRegistry::global();
+    out.write(FILE_MAGIC, sizeof(FILE_MAGIC));
+    writeValue(out, MESH_FORMAT_VERSION);
+    writeValue(out, static_cast<uint32_t>(materials.size()));
+    for (MaterialId id : materials) {
+        const Material& material = registry.get(id);
+        writeValue(out, id);
+        writeValue(out, static_cast<int32_t>(material.type));
+        writeValue(out, material.color);
+        writeString(out, registry.getTextureName(material.texture));
+    }
+    writeValue(out, static_cast<uint32_t>(textures.size()));
+    for (TextureId id : textures) {
+        writeValue(out, id);
+        writeString(out, registry.getTextureName(id));
+    }
+    writeMesh(out, mesh);
+    return static_cast<bool>(out);
+}
+
+static bool readMeshFile(const std::string& path, ChunkMesh& mesh) {
+    std::ifstream in(path, std::ios::binary);
+    char magic[sizeof(FILE_MAGIC)];
+    uint32_t version;
+    if (!in || !in.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), FILE_MAGIC)
+        || !readValue(in, version) || version != MESH_FORMAT_VERSION) {
+        return false;
+    }
+
+    MaterialRegistry& registry = MaterialRegistry::global();
+    std::unordered_map<MaterialId, MaterialId> materials; // Id when saved to id now
+    std::unordered_map<TextureId, TextureId> textures;
+    uint32_t count;
+    if (!readValue(in, count) || count > MaterialRegistry::MAX_MATERIALS) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        MaterialId id;
+        int32_t type;
+        glm::vec3 color;
+        std::string texture;
+        if (!readValue(in, id) || !readValue(in, type) || !readValue(in, color) || !readString(in, texture)) {
+            return false;
+        }
+        materials[id] = registry.getMaterial(type, color, texture);
+    }
+    if (!readValue(in, count) || count > MaterialRegistry::MAX_MATERIALS) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        TextureId id;
+        std::string texture;
+        if (!readValue(in, id) || !readString(in, texture)) {
+            return false;
+        }
+        textures[id] = registry.getTexture(texture);
+    }
+    return readMesh(in, mesh, 0) && remapMesh(mesh, materials, textures);
+}
+
+MeshCache::MeshCache()
+    : memoryBudget(DEFAULT_MEMORY_BUDGET), memoryUsed(0), diskBudget(DEFAULT_DISK_BUDGET), hits(0), misses(0) {}
+
+uint64_t MeshCache::contentKey(const MaterialId* block, MeshingMode mode, int lodLevels) {
+    const MaterialRegistry& registry = MaterialRegistry::global();
+    const size_t count = static_cast<size_t>(ChunkMesher::PADDED) * ChunkMesher::PADDED * ChunkMesher::PADDED;
+    uint64_t key = mixKey(MESH_FORMAT_VERSION, static_cast<uint64_t>(mode) << 8 | static_cast<uint64_t>(lodLevels));
+    // Runs of one material go in as (material, length), far fewer mixes than one per voxel
+    size_t start = 0;
+    while (start < count) {
+        MaterialId material = block[start];
+        size_t end = start + 1;
+        // Four voxels per compare while the run lasts, then one at a time to find where it ends
+        const uint64_t pattern = material * 0x0001000100010001ull;
+        while (end + 4 <= count) {
+            uint64_t word;
+            std::memcpy(&word, block + end, sizeof(word));
+            if (word != pattern) {
+                break;
+            }
+            end += 4;
+        }
+        while (end < count && block[end] == material) {
+            ++end;
+        }
+        key = mixKey(key, registry.get(material).hash);
+        key = mixKey(key, end - start);
+        start = end;
+    }
+    return key ? key : 1;
+}
+
+bool MeshCache::find(uint64_t key, ChunkMesh& mesh) {
+    std::shared_ptr<const ChunkMesh> found;
+    std::string dir;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto entry = lookup.find(key);
+        if (entry != lookup.end()) {
+            entries.splice(entries.begin(), entries, entry->second);
+            found = entry->second->mesh;
+            ++hits;
+        } else {
+            dir = directory;
+        }
+    }
+    if (!found && !dir.empty()) {
+        // Read outside the lock, so the other meshers keep going
+        std::string path = pathFor(dir, key);
+        std::shared_ptr<ChunkMesh> loaded = std::make_shared<ChunkMesh>();
+        if (readMeshFile(path, *loaded)) {
+            loaded->contentKey = key;
+            std::error_code error;
+            std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error); // Recently used for trimDirectory
+            std::lock_guard<std::mutex> lock(mutex);
+            insert(key, loaded);
+            found = loaded;
+            ++hits;
+        }
+    }
+    if (!found) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++misses;
+        return false;
+    }
+    mesh = *found; // Reuses the capacity mesh already has
+    return true;
+}
+
+void MeshCache::store(uint64_t key, const ChunkMesh& mesh) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (memoryBudget == 0 || lookup.count(key)) {
+            return; // Same key, same voxels, same mesh
+        }
+    }
+    std::shared_ptr<const ChunkMesh> copy = std::make_shared<const ChunkMesh>(mesh);
+    std::lock_guard<std::mutex> lock(mutex);
+    insert(key, std::move(copy));
+}
+
+void MeshCache::insert(uint64_t key, std::shared_ptr<const ChunkMesh> mesh) {
+    size_t bytes = meshBytes(*mesh);
+    if (bytes > memoryBudget) {
+        return;
+    }
+    auto existing = lookup.find(key);
+    if (existing != lookup.end()) {
+        memoryUsed -= existing->second->bytes;
+        entries.erase(existing->second);
+        lookup.erase(existing);
+    }
+    entries.push_front({ key, std::move(mesh), bytes });
+    lookup[key] = entries.begin();
+    memoryUsed += bytes;
+    evictOverBudget();
+}
+
+void MeshCache::evictOverBudget() {
+    while (memoryUsed > memoryBudget) {
+        const Entry& oldest = entries.back();
+        memoryUsed -= oldest.bytes;
+        lookup.erase(oldest.key);
+        entries.pop_back();
+    }
+}
+
+void MeshCache::save(uint64_t key, const ChunkMesh& mesh) {
+    std::string dir;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        dir = directory;
+    }
+    if (dir.empty()) {
+        return;
+    }
+    std::error_code error;
+    std::string path = pathFor(dir, key);
+    if (std::filesystem::exists(path, error)) {
+        std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+        return;
+    }
+    std::filesystem::create_directories(dir, error);
+    // Written under another name first, so a reader never sees half a file
+    std::string temporary = path + ".tmp";
+    if (!writeMeshFile(temporary, mesh)) {
+        std::cout << "MeshCache: could not write " << temporary << std::endl;
+        std::filesystem::remove(temporary, error);
+        return;
+    }
+    std::filesystem::rename(temporary, path, error);
+    if (error) {
+        std::filesystem::remove(temporary, error);
+    }
+}
+
+void MeshCache::trimDirectory() {
+    std::string dir;
+    uint64_t budget;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        dir = directory;
+        budget = diskBudget;
+    }
+    if (dir.empty()) {
+        return;
+    }
+    struct CacheFile {
+        std::filesystem::path path;
+        std::filesystem::file_time_type used;
+        uint64_t bytes;
+    };
+    std::vector<CacheFile> files;
+    uint64_t total = 0;
+    std::error_code error;
+    for (std::filesystem::directory_iterator it(dir, error), end; !error && it != end; it.increment(error)) {
+        if (it->path().extension() != ".mesh") {
+            continue;
+        }
+        std::error_code fileError;
+        CacheFile file = { it->path(), it->last_write_time(fileError), it->file_size(fileError) };
+        if (!fileError) {
+            files.push_back(file);
+            total += file.bytes;
+        }
+    }
+    if (total <= budget) {
+        return;
+    }
+    std::sort(files.begin(), files.end(), [](const CacheFile& a, const CacheFile& b) { return a.used < b.used; });
+    for (const CacheFile& file : files) {
+        if (total <= budget) {
+            break;
+        }
+        if (std::filesystem::remove(file.path, error)) {
+            total -= file.bytes;
+        }
+    }
+}
+
+void MeshCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.clear();
+    lookup.clear();
+    memoryUsed = 0;
+}
+
+void MeshCache::setMemoryBudget(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    memoryBudget = bytes;
+    evictOverBudget();
+}
+
+void MeshCache::setDirectory(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex);
+    directory = path;
+}
+
+void MeshCache::setDiskBudget(uint64_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    diskBudget = bytes;
+}
+
+size_t MeshCache::getMemoryUsed() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return memoryUsed;
+}
+
+size_t MeshCache::getHits() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return hits;
+}
+
+size_t MeshCache::getMisses() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return misses;
+}
+
+std::string MeshCache::pathFor(const std::string& dir, uint64_t key) const {
+    std::ostringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << key << ".mesh";
+    return (std::filesystem::path(dir) / name.str()).string();
+}
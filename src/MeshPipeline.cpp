@@ -0,0 +1,111 @@
+#include "MeshPipeline.h"
+#include "VoxelWorld.h"
+#include "JobSystem.h"
+#include <iostream>
+
+MeshPipeline::MeshPipeline() : state(BATCH_NONE), stopping(false), batchMode(MESH_FACES), batchLodLevels(0) {
+    // Background batches use these; creating them first makes them outlive a pipeline with
+    // static storage, such as a global VoxelWorld's, so the destructor can still join a batch
+    JobSystem::global();
+    MaterialRegistry::global();
+}
+
+MeshPipeline::~MeshPipeline() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    if (thread.joinable()) {
+        thread.join(); // Lets a running batch finish, before any member it uses is destroyed
+    }
+}
+
+void MeshPipeline::meshNow(const VoxelStorage& storage, MeshingMode mode, int lodLevels, const std::vector<glm::ivec3>& chunks, std::vector<ChunkMesh>& meshes) {
+    JobSystem& jobs = JobSystem::global();
+    if (meshers.empty()) {
+        meshers.resize(jobs.getWorkerCount());
+    }
+    for (ChunkMesher& mesher : meshers) {
+        mesher.setCache(&cache);
+        mesher.setMode(mode);
+        mesher.setLodLevels(lodLevels);
+    }
+    meshes.resize(chunks.size());
+    jobs.parallelFor(chunks.size(), [&](size_t i, unsigned worker) {
+        meshers[worker].meshChunk(storage, chunks[i], meshes[i]);
+    });
+}
+
+void MeshPipeline::meshLodsNow(const VoxelStorage& storage, MeshingMode mode, int lodLevels, const glm::ivec3& chunkPos, ChunkMesh& mesh) {
+    if (!lodMesher) {
+        lodMesher = std::make_unique<ChunkMesher>();
+    }
+    lodMesher->setMode(mode);
+    lodMesher->setLodLevels(lodLevels);
+    lodMesher->meshLods(storage, chunkPos, mesh);
+}
+
+void MeshPipeline::submit(std::shared_ptr<const VoxelSnapshot> snapshot, MeshingMode mode, int lodLevels, std::vector<glm::ivec3> chunks) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (state != BATCH_NONE) {
+            std::cout << "MeshPipeline::submit called while a batch is still in flight" << std::endl;
+            return;
+        }
+        source = std::move(snapshot);
+        batchMode = mode;
+        batchLodLevels = lodLevels;
+        batchChunks = std::move(chunks);
+        state = BATCH_QUEUED;
+        if (!thread.joinable()) {
+            thread = std::thread(&MeshPipeline::run, this);
+        }
+    }
+    wake.notify_one();
+}
+
+bool MeshPipeline::isBusy() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return state != BATCH_NONE;
+}
+
+bool MeshPipeline::takeFinished(std::vector<glm::ivec3>& chunks, std::vector<ChunkMesh>& meshes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (state != BATCH_FINISHED) {
+        return false;
+    }
+    // Dropped here rather than on the pipeline thread, so the owner's next edit of a chunk it
+    // shared with the snapshot is ordered after the batch's reads by this lock
+    source.reset();
+    chunks = std::move(batchChunks);
+    meshes = std::move(batchMeshes);
+    batchChunks.clear();
+    batchMeshes.clear();
+    state = BATCH_NONE;
+    return true;
+}
+
+void MeshPipeline::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [this]() { return state == BATCH_NONE || state == BATCH_FINISHED; });
+}
+
+void MeshPipeline::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        wake.wait(lock, [this]() { return stopping || state == BATCH_QUEUED; });
+        if (stopping) {
+            return;
+        }
+        state = BATCH_RUNNING;
+        lock.unlock();
+
+        // Only this thread touches the batch while it runs
+        meshNow(*source->storage, batchMode, batchLodLevels, batchChunks, batchMeshes);
+
+        lock.lock();
+        state = BATCH_FINISHED;
+        finished.notify_all();
+    }
+}
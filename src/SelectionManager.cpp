@@ -14,6 +14,7 @@ void SelectionManager::startSelection(const glm::ivec3& start) {
 
 void SelectionManager::updateSelection(const glm::ivec3& current, VoxelWorld& voxelWorld) {
     selectionEnd = current;
+    voxelWorld.beginEdit(); // One remesh for the whole box instead of one per voxel
     for (const auto& voxel : highlightedVoxels) {
         voxelWorld.resetHighlight(voxel); // Clear previous highlights
     }
@@ -36,7 +37,7 @@ void SelectionManager::updateSelection(const glm::ivec3& current, VoxelWorld& vo
         }
     }
 
-    voxelWorld.generateMeshData(); // Regenerate mesh data to update highlights
+    voxelWorld.commitEdit(); // Regenerate mesh data to update highlights
 }
 
 void SelectionManager::endSelection(VoxelWorld& voxelWorld) {
@@ -48,19 +49,20 @@ void SelectionManager::endSelection(VoxelWorld& voxelWorld) {
         int maxY = std::max(selectionStart.y, selectionEnd.y);
         int maxZ = std::max(selectionStart.z, selectionEnd.z);
 
+        voxelWorld.beginEdit();
         for (int x = minX; x <= maxX; ++x) {
             for (int y = minY; y <= maxY; ++y) {
                 for (int z = minZ; z <= maxZ; ++z) {
                     glm::ivec3 voxelPos(x, y, z);
                     selectedVoxels.insert(voxelPos);
-                    voxelWorld.selectVoxel(voxelPos);
                     //cout << "Selected voxel at: " << x << ", " << y << ", " << z << endl;
                 }
             }
         }
+        voxelWorld.selectBox(glm::ivec3(minX, minY, minZ), glm::ivec3(maxX, maxY, maxZ));
         selecting = false;
         highlightedVoxels.clear(); // Clear highlights after selection
-        voxelWorld.generateMeshData(); // Regenerate mesh data to update selections
+        voxelWorld.commitEdit(); // Regenerate mesh data to update selections
     }
 }
 
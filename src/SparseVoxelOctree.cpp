@@ -0,0 +1,186 @@
+#include "SparseVoxelOctree.h"
+#include "VoxelChunk.h"
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+
+SparseVoxelOctree::SparseVoxelOctree() : freeHead(NO_NODE), freeCount(0), root(uniformSlot(MaterialRegistry::NONE)), voxelCount(0) {}
+
+uint32_t SparseVoxelOctree::allocateNode(uint32_t fill) {
+    uint32_t index;
+    if (freeHead != NO_NODE) {
+        index = freeHead;
+        freeHead = nodes[index].children[0];
+        --freeCount;
+    } else {
+        index = static_cast<uint32_t>(nodes.size());
+        nodes.push_back(Node());
+    }
+    Node& node = nodes.write(index);
+    std::fill(node.children, node.children + 8, fill);
+    return index;
+}
+
+void SparseVoxelOctree::freeNode(uint32_t index) {
+    nodes.write(index).children[0] = freeHead;
+    freeHead = index;
+    ++freeCount;
+}
+
+MaterialId SparseVoxelOctree::getVoxel(const glm::ivec3& position) const {
+    if (!inRange(position)) {
+        return MaterialRegistry::NONE;
+    }
+    glm::uvec3 offset(position - ORIGIN);
+    uint32_t slot = root;
+    for (int level = LEVELS; !isUniform(slot); --level) {
+        slot = nodes[slot].children[childIndex(offset, level)];
+    }
+    return slotMaterial(slot);
+}
+
+void SparseVoxelOctree::setVoxel(const glm::ivec3& position, MaterialId material) {
+    if (!inRange(position)) {
+        std::cout << "Voxel (" << position.x << ", " << position.y << ", " << position.z << ") is outside the octree bounds" << std::endl;
+        return;
+    }
+    MaterialId previous = getVoxel(position);
+    if (previous == material) {
+        return;
+    }
+
+    glm::uvec3 offset(position - ORIGIN);
+    uint32_t path[LEVELS];
+    int pathChildren[LEVELS];
+
+    // Walk down to the single voxel, splitting every collapsed cube we pass through.
+    // Slots are re-fetched after each allocation since writes can clone a page.
+    uint32_t parent = 0;
+    int parentChild = -1; // -1 means the root slot
+    for (int depth = 0; depth < LEVELS; ++depth) {
+        uint32_t slot = parentChild < 0 ? root : nodes[parent].children[parentChild];
+        if (isUniform(slot)) {
+            uint32_t node = allocateNode(slot);
+            slotRef(parent, parentChild) = node;
+            slot = node;
+        }
+        path[depth] = slot;
+        pathChildren[depth] = childIndex(offset, LEVELS - depth);
+        parent = slot;
+        parentChild = pathChildren[depth];
+    }
+    slotRef(parent, parentChild) = uniformSlot(material);
+
+    // Merge back up while a node's eight children all hold the same material
+    for (int depth = LEVELS - 1; depth >= 0; --depth) {
+        const Node& node = nodes[path[depth]];
+        uint32_t first = node.children[0];
+        if (!isUniform(first) || !std::all_of(node.children + 1, node.children + 8, [first](uint32_t child) { return child == first; })) {
+            break;
+        }
+        freeNode(path[depth]);
+        slotRef(depth == 0 ? 0 : path[depth - 1], depth == 0 ? -1 : pathChildren[depth - 1]) = first;
+    }
+
+    if (previous == MaterialRegistry::NONE) {
+        ++voxelCount;
+    } else if (material == MaterialRegistry::NONE) {
+        --voxelCount;
+    }
+}
+
+void SparseVoxelOctree::visitBoxes(uint32_t slot, int level, const glm::ivec3& nodeMin, const glm::ivec3& regionMin, const glm::ivec3& regionMax, const BoxVisitor& visitor) const {
+    glm::ivec3 nodeMax = nodeMin + ((1 << level) - 1);
+    if (glm::any(glm::greaterThan(nodeMin, regionMax)) || glm::any(glm::lessThan(nodeMax, regionMin))) {
+        return;
+    }
+    if (isUniform(slot)) {
+        if (slotMaterial(slot) != MaterialRegistry::NONE) {
+            visitor(glm::max(nodeMin, regionMin), glm::min(nodeMax, regionMax), slotMaterial(slot));
+        }
+        return;
+    }
+    int half = 1 << (level - 1);
+    for (int child = 0; child < 8; ++child) {
+        glm::ivec3 childMin = nodeMin + glm::ivec3(child & 1, (child >> 1) & 1, child >> 2) * half;
+        visitBoxes(nodes[slot].children[child], level - 1, childMin, regionMin, regionMax, visitor);
+    }
+}
+
+void SparseVoxelOctree::forEachBox(const glm::ivec3& regionMin, const glm::ivec3& regionMax, const BoxVisitor& visitor) const {
+    visitBoxes(root, LEVELS, glm::ivec3(ORIGIN), regionMin, regionMax, visitor);
+}
+
+void SparseVoxelOctree::forEachVoxel(const glm::ivec3& regionMin, const glm::ivec3& regionMax, const VoxelVisitor& visitor) const {
+    forEachBox(regionMin, regionMax, [&](const glm::ivec3& boxMin, const glm::ivec3& boxMax, MaterialId material) {
+        for (int z = boxMin.z; z <= boxMax.z; ++z) {
+            for (int y = boxMin.y; y <= boxMax.y; ++y) {
+                for (int x = boxMin.x; x <= boxMax.x; ++x) {
+                    visitor(glm::ivec3(x, y, z), material);
+                }
+            }
+        }
+    });
+}
+
+void SparseVoxelOctree::visitChunks(uint32_t slot, int level, const glm::ivec3& nodeMin, const ChunkVisitor& visitor) const {
+    if (isUniform(slot)) {
+        if (slotMaterial(slot) == MaterialRegistry::NONE) {
+            return;
+        }
+        // A solid cube at least a chunk wide covers whole chunks
+        glm::ivec3 chunkMin = VoxelChunk::chunkCoord(nodeMin);
+        int chunks = 1 << (level - VoxelChunk::SHIFT);
+        for (int z = 0; z < chunks; ++z) {
+            for (int y = 0; y < chunks; ++y) {
+                for (int x = 0; x < chunks; ++x) {
+                    visitor(chunkMin + glm::ivec3(x, y, z));
+                }
+            }
+        }
+        return;
+    }
+    if (level == VoxelChunk::SHIFT) {
+        visitor(VoxelChunk::chunkCoord(nodeMin)); // Mixed content below chunk size, so something is filled
+        return;
+    }
+    int half = 1 << (level - 1);
+    for (int child = 0; child < 8; ++child) {
+        glm::ivec3 childMin = nodeMin + glm::ivec3(child & 1, (child >> 1) & 1, child >> 2) * half;
+        visitChunks(nodes[slot].children[child], level - 1, childMin, visitor);
+    }
+}
+
+bool SparseVoxelOctree::hasChunk(const glm::ivec3& chunkPos) const {
+    glm::ivec3 origin = VoxelChunk::chunkOrigin(chunkPos);
+    if (!inRange(origin)) {
+        return false;
+    }
+    glm::uvec3 offset(origin - ORIGIN);
+    uint32_t slot = root;
+    for (int level = LEVELS; !isUniform(slot); --level) {
+        if (level == VoxelChunk::SHIFT) {
+            return true; // Mixed content below chunk size, so something is filled
+        }
+        slot = nodes[slot].children[childIndex(offset, level)];
+    }
+    return slotMaterial(slot) != MaterialRegistry::NONE;
+}
+
+void SparseVoxelOctree::forEachChunk(const ChunkVisitor& visitor) const {
+    visitChunks(root, LEVELS, glm::ivec3(ORIGIN), visitor);
+}
+
+void SparseVoxelOctree::readRegion(const glm::ivec3& regionMin, const glm::ivec3& extent, MaterialId* out) const {
+    std::fill(out, out + static_cast<size_t>(extent.x) * extent.y * extent.z, MaterialRegistry::NONE);
+    forEachBox(regionMin, regionMin + extent - 1, [&](const glm::ivec3& boxMin, const glm::ivec3& boxMax, MaterialId material) {
+        glm::ivec3 from = boxMin - regionMin;
+        glm::ivec3 to = boxMax - regionMin;
+        for (int z = from.z; z <= to.z; ++z) {
+            for (int y = from.y; y <= to.y; ++y) {
+                MaterialId* row = out + (static_cast<size_t>(z) * extent.y + y) * extent.x;
+                std::fill(row + from.x, row + to.x + 1, material);
+            }
+        }
+    });
+}
@@ -0,0 +1,141 @@
+#include "VoxelChunk.h"
+
+VoxelChunk::VoxelChunk() : occupancy(WORDS, 0), liveEntries(0), bitsPerIndex(0), voxelCount(0) {}
+
+// Smallest supported index width that can address paletteSize entries
+static int bitsForPaletteSize(size_t paletteSize) {
+    int bits = 0;
+    while ((size_t(1) << bits) < paletteSize) {
+        bits = bits == 0 ? 1 : bits * 2;
+    }
+    return bits;
+}
+
+uint32_t VoxelChunk::getPaletteIndex(int index) const {
+    if (bitsPerIndex == 0) {
+        return 0;
+    }
+    // Widths are powers of two, so an index never straddles two words
+    int bitOffset = index * bitsPerIndex;
+    uint64_t mask = (uint64_t(1) << bitsPerIndex) - 1;
+    return static_cast<uint32_t>((packedIndices[bitOffset >> 6] >> (bitOffset & 63)) & mask);
+}
+
+void VoxelChunk::setPaletteIndex(int index, uint32_t paletteIndex) {
+    if (bitsPerIndex == 0) {
+        return;
+    }
+    int bitOffset = index * bitsPerIndex;
+    uint64_t mask = (uint64_t(1) << bitsPerIndex) - 1;
+    uint64_t& word = packedIndices[bitOffset >> 6];
+    word = (word & ~(mask << (bitOffset & 63))) | (uint64_t(paletteIndex) << (bitOffset & 63));
+}
+
+// Rewrites every index at a new width, optionally mapping old palette indices to new ones
+void VoxelChunk::repackIndices(int newBits, const std::vector<uint32_t>* remap) {
+    std::vector<uint64_t> oldIndices;
+    oldIndices.swap(packedIndices);
+    int oldBits = bitsPerIndex;
+
+    bitsPerIndex = newBits;
+    packedIndices.assign(VOLUME * newBits / 64, 0);
+
+    if (oldBits == 0 || newBits == 0) {
+        return; // Every voxel points at entry 0, which is what the zeroed array already says
+    }
+    uint64_t oldMask = (uint64_t(1) << oldBits) - 1;
+    forEachVoxel([&](int index) {
+        int bitOffset = index * oldBits;
+        uint32_t paletteIndex = static_cast<uint32_t>((oldIndices[bitOffset >> 6] >> (bitOffset & 63)) & oldMask);
+        setPaletteIndex(index, remap ? (*remap)[paletteIndex] : paletteIndex);
+    });
+}
+
+void VoxelChunk::retainEntry(uint32_t paletteIndex) {
+    if (paletteRefCounts[paletteIndex]++ == 0) {
+        ++liveEntries;
+    }
+}
+
+void VoxelChunk::releaseEntry(uint32_t paletteIndex) {
+    if (--paletteRefCounts[paletteIndex] == 0) {
+        --liveEntries;
+    }
+}
+
+// Drops unused entries and narrows the indices to fit what is left. Only runs once
+// half the palette is dead, so the cost is spread over at least as many edits.
+void VoxelChunk::compactPalette() {
+    if (static_cast<size_t>(liveEntries) * 2 >= palette.size()) {
+        return;
+    }
+    std::vector<uint32_t> remap(palette.size(), 0);
+    std::vector<MaterialId> livePalette;
+    std::vector<uint32_t> liveRefCounts;
+    livePalette.reserve(liveEntries);
+    liveRefCounts.reserve(liveEntries);
+    for (size_t i = 0; i < palette.size(); ++i) {
+        if (paletteRefCounts[i] > 0) {
+            remap[i] = static_cast<uint32_t>(livePalette.size());
+            livePalette.push_back(palette[i]);
+            liveRefCounts.push_back(paletteRefCounts[i]);
+        }
+    }
+    repackIndices(bitsForPaletteSize(livePalette.size()), &remap);
+    palette.swap(livePalette);
+    paletteRefCounts.swap(liveRefCounts);
+}
+
+uint32_t VoxelChunk::findOrAddPaletteEntry(MaterialId material) {
+    int freeSlot = -1;
+    for (size_t i = 0; i < palette.size(); ++i) {
+        if (palette[i] == material) {
+            return static_cast<uint32_t>(i);
+        }
+        if (freeSlot < 0 && paletteRefCounts[i] == 0) {
+            freeSlot = static_cast<int>(i);
+        }
+    }
+    if (freeSlot >= 0) {
+        palette[freeSlot] = material;
+        return static_cast<uint32_t>(freeSlot);
+    }
+
+    palette.push_back(material);
+    paletteRefCounts.push_back(0);
+    if (palette.size() > (size_t(1) << bitsPerIndex)) {
+        repackIndices(bitsForPaletteSize(palette.size()), nullptr);
+    }
+    return static_cast<uint32_t>(palette.size() - 1);
+}
+
+void VoxelChunk::setVoxel(int index, MaterialId material) {
+    uint32_t paletteIndex = findOrAddPaletteEntry(material);
+    uint64_t bit = uint64_t(1) << (index & 63);
+    if (occupancy[index >> 6] & bit) {
+        uint32_t oldIndex = getPaletteIndex(index);
+        if (oldIndex == paletteIndex) {
+            return;
+        }
+        releaseEntry(oldIndex);
+    } else {
+        occupancy[index >> 6] |= bit;
+        ++voxelCount;
+    }
+    setPaletteIndex(index, paletteIndex);
+    retainEntry(paletteIndex);
+    compactPalette();
+}
+
+bool VoxelChunk::removeVoxel(int index) {
+    uint64_t bit = uint64_t(1) << (index & 63);
+    if (!(occupancy[index >> 6] & bit)) {
+        return false;
+    }
+    releaseEntry(getPaletteIndex(index));
+    setPaletteIndex(index, 0);
+    occupancy[index >> 6] &= ~bit;
+    --voxelCount;
+    compactPalette();
+    return true;
+}
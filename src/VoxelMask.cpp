@@ -0,0 +1,116 @@
+#include "VoxelMask.h"
+#include <vector>
+#include <algorithm>
+#include <atomic>
+
+VoxelMask::ChunkBits& VoxelMask::writable(std::shared_ptr<ChunkBits>& bits) {
+    if (!bits) {
+        bits = std::make_shared<ChunkBits>();
+    } else if (bits.use_count() > 1) {
+        bits = std::make_shared<ChunkBits>(*bits);
+    } else {
+        // Pairs with the release in the last other owner's reference drop, see ChunkedVoxelStorage::writable
+        std::atomic_thread_fence(std::memory_order_acquire);
+    }
+    return *bits;
+}
+
+bool VoxelMask::set(const glm::ivec3& position) {
+    std::shared_ptr<ChunkBits>& bits = chunks[VoxelChunk::chunkCoord(position)];
+    int index = VoxelChunk::localIndex(VoxelChunk::localCoord(position));
+    uint64_t bit = uint64_t(1) << (index & 63);
+    if (bits && (bits->words[index >> 6] & bit)) {
+        return false;
+    }
+    ChunkBits& target = writable(bits);
+    target.words[index >> 6] |= bit;
+    ++target.count;
+    ++total;
+    return true;
+}
+
+bool VoxelMask::reset(const glm::ivec3& position) {
+    glm::ivec3 chunkPos = VoxelChunk::chunkCoord(position);
+    std::shared_ptr<ChunkBits>* bits = chunks.find(chunkPos);
+    if (!bits) {
+        return false;
+    }
+    int index = VoxelChunk::localIndex(VoxelChunk::localCoord(position));
+    uint64_t bit = uint64_t(1) << (index & 63);
+    if (!((*bits)->words[index >> 6] & bit)) {
+        return false;
+    }
+    --total;
+    if ((*bits)->count == 1) {
+        chunks.erase(chunkPos); // Last bit in the chunk, no need to clone just to clear it
+        return true;
+    }
+    ChunkBits& target = writable(*bits);
+    target.words[index >> 6] &= ~bit;
+    --target.count;
+    return true;
+}
+
+void VoxelMask::clear() {
+    chunks.clear();
+    total = 0;
+}
+
+void VoxelMask::merge(const VoxelMask& other) {
+    for (const auto& chunkPair : other.chunks) {
+        std::shared_ptr<ChunkBits>& bits = chunks[chunkPair.first];
+        if (!bits) {
+            bits = chunkPair.second; // Share until one side writes
+            total += bits->count;
+            continue;
+        }
+        if (bits == chunkPair.second) {
+            continue;
+        }
+        ChunkBits& target = writable(bits);
+        uint32_t count = 0;
+        for (int word = 0; word < VoxelChunk::WORDS; ++word) {
+            target.words[word] |= chunkPair.second->words[word];
+            count += popCount(target.words[word]);
+        }
+        total += count - target.count;
+        target.count = count;
+    }
+}
+
+void VoxelMask::subtract(const VoxelMask& other) {
+    // Walk whichever side has fewer chunks
+    std::vector<glm::ivec3> emptied;
+    auto subtractChunk = [&](const glm::ivec3& chunkPos, std::shared_ptr<ChunkBits>& bits, const ChunkBits& removed) {
+        // Copy the removed words first: cloning a chunk shared with the other mask must not change what we subtract
+        uint64_t removedWords[VoxelChunk::WORDS];
+        std::copy(removed.words, removed.words + VoxelChunk::WORDS, removedWords);
+        ChunkBits& target = writable(bits);
+        uint32_t count = 0;
+        for (int word = 0; word < VoxelChunk::WORDS; ++word) {
+            target.words[word] &= ~removedWords[word];
+            count += popCount(target.words[word]);
+        }
+        total -= target.count - count;
+        target.count = count;
+        if (count == 0) {
+            emptied.push_back(chunkPos);
+        }
+    };
+    if (other.chunks.size() < chunks.size()) {
+        for (const auto& chunkPair : other.chunks) {
+            if (std::shared_ptr<ChunkBits>* bits = chunks.find(chunkPair.first)) {
+                subtractChunk(chunkPair.first, *bits, *chunkPair.second);
+            }
+        }
+    } else {
+        for (const auto& chunkPair : chunks) {
+            if (const std::shared_ptr<ChunkBits>* removed = other.chunks.find(chunkPair.first)) {
+                subtractChunk(chunkPair.first, chunkPair.second, **removed);
+            }
+        }
+    }
+    for (const auto& chunkPos : emptied) {
+        chunks.erase(chunkPos);
+    }
+}
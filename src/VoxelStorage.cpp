@@ -0,0 +1,33 @@
+#include "VoxelStorage.h"
+#include "ChunkedVoxelStorage.h"
+#include "SparseVoxelOctree.h"
+#include "DenseGridStorage.h"
+#include <algorithm>
+
+std::unique_ptr<VoxelStorage> VoxelStorage::create(VoxelStorageType type, int size) {
+    switch (type) {
+        case STORAGE_SPARSE_OCTREE:
+            return std::make_unique<SparseVoxelOctree>();
+        case STORAGE_DENSE:
+            return std::make_unique<DenseGridStorage>(size);
+        case STORAGE_CHUNKED:
+        default:
+            return std::make_unique<ChunkedVoxelStorage>();
+    }
+}
+
+bool VoxelStorage::removeVoxel(const glm::ivec3& position) {
+    if (!hasVoxel(position)) {
+        return false;
+    }
+    setVoxel(position, MaterialRegistry::NONE);
+    return true;
+}
+
+void VoxelStorage::readRegion(const glm::ivec3& regionMin, const glm::ivec3& extent, MaterialId* out) const {
+    std::fill(out, out + static_cast<size_t>(extent.x) * extent.y * extent.z, MaterialRegistry::NONE);
+    forEachVoxel(regionMin, regionMin + extent - 1, [&](const glm::ivec3& position, MaterialId material) {
+        glm::ivec3 local = position - regionMin;
+        out[(static_cast<size_t>(local.z) * extent.y + local.y) * extent.x + local.x] = material;
+    });
+}
@@ -11,10 +11,10 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
-// Define the necessary VBO and EBO variables
-GLuint unselectedVBO, unselectedEBO, selectedVBO, selectedEBO;
-
-VoxelWorld::VoxelWorld(int size) : size(size) {
+VoxelWorld::VoxelWorld(int size, VoxelStorageType storageType)
+    : size(size), storage(VoxelStorage::create(storageType, size)),
+      boundsMin(std::numeric_limits<int>::max()), boundsMax(std::numeric_limits<int>::min()),
+      editDepth(0), meshDirty(false), version(0), readerCount(0), publishedVersion(0), meshGeneration(0), meshingMode(MESH_FACES), lodLevels(0), asyncMeshing(false) {
     std::cout << "VoxelWorld created with size " << size << std::endl;
 }
 
@@ -22,19 +22,226 @@ glm::ivec3 VoxelWorld::getVoxelIndex(int x, int y, int z) {
     return glm::ivec3(x, y, z);
 }
 
+void VoxelWorld::clearFlags(const glm::ivec3& position) {
+    bool selected = selectedMask.reset(position);
+    if (highlightedMask.reset(position) || selected) {
+        touchSelection(VoxelChunk::chunkCoord(position));
+    }
+}
+
+bool VoxelWorld::writeVoxel(const glm::ivec3& position, MaterialId material) {
+    // Checked up front so rejected writes never grow the bounds raycasts walk
+    if (!storage->canHold(position)) {
+        return false;
+    }
+    storage->setVoxel(position, material);
+    clearFlags(position);
+    if (material != MaterialRegistry::NONE) {
+        boundsMin = glm::min(boundsMin, position);
+        boundsMax = glm::max(boundsMax, position);
+    }
+    touchVoxel(position);
+    meshDirty = true;
+    return true;
+}
+
+void VoxelWorld::touchChunk(const glm::ivec3& chunkPos) {
+    chunkVersions[chunkPos] = ++version;
+    dirtyChunks.insert(chunkPos);
+}
+
+void VoxelWorld::touchSelection(const glm::ivec3& chunkPos) {
+    ++version;
+    selectionChangedChunks.insert(chunkPos);
+}
+
+void VoxelWorld::touchVoxel(const glm::ivec3& position) {
+    glm::ivec3 chunkPos = VoxelChunk::chunkCoord(position);
+    glm::ivec3 local = VoxelChunk::localCoord(position);
+    // Neighbouring chunks read this voxel through their one voxel border: faces may appear or
+    // disappear, and corner occlusion and smooth cells reach across edges and corners too
+    glm::ivec3 low(0);
+    glm::ivec3 high(0);
+    for (int axis = 0; axis < 3; ++axis) {
+        if (local[axis] == 0) {
+            low[axis] = -1;
+        } else if (local[axis] == VoxelChunk::MASK) {
+            high[axis] = 1;
+        }
+    }
+    for (int z = low.z; z <= high.z; ++z) {
+        for (int y = low.y; y <= high.y; ++y) {
+            for (int x = low.x; x <= high.x; ++x) {
+                touchChunk(chunkPos + glm::ivec3(x, y, z));
+            }
+        }
+    }
+}
+
+void VoxelWorld::invalidateMesh() {
+    meshDirty = true;
+    if (editDepth == 0) {
+        finishEdit();
+    }
+}
+
+void VoxelWorld::finishEdit() {
+    generateMeshData();
+    // Snapshots are only worth taking when another thread will read them
+    if (readerCount > 0) {
+        publish();
+    }
+}
+
+void VoxelWorld::addReader() {
+    if (readerCount++ == 0) {
+        publish();
+    }
+}
+
+void VoxelWorld::removeReader() {
+    if (readerCount == 0) {
+        std::cout << "removeReader called without a matching addReader" << std::endl;
+        return;
+    }
+    --readerCount;
+}
+
+void VoxelWorld::publish() {
+    if (publishedVersion == version) {
+        return;
+    }
+    // Readers that still hold the previous snapshot keep it alive until they drop it
+    std::atomic_store(&published, snapshot());
+    publishedVersion = version;
+}
+
+std::shared_ptr<const VoxelSnapshot> VoxelWorld::acquireSnapshot() const {
+    return std::atomic_load(&published);
+}
+
+uint64_t VoxelSnapshot::getChunkVersion(const glm::ivec3& chunkPos) const {
+    const uint64_t* chunkVersion = chunkVersions.find(chunkPos);
+    return chunkVersion ? *chunkVersion : 0;
+}
+
+std::shared_ptr<const VoxelSnapshot> VoxelWorld::snapshot() const {
+    std::shared_ptr<VoxelSnapshot> snapshot = std::make_shared<VoxelSnapshot>();
+    snapshot->storage = storage->clone();
+    snapshot->selected = selectedMask;
+    snapshot->highlighted = highlightedMask;
+    snapshot->boundsMin = boundsMin;
+    snapshot->boundsMax = boundsMax;
+    snapshot->version = version;
+    snapshot->chunkVersions = chunkVersions;
+    return snapshot;
+}
+
+void VoxelWorld::restore(const VoxelSnapshot& snapshot) {
+    // Every chunk that holds anything before or after may have changed
+    VoxelHashSet changed;
+    auto collect = [&changed](const glm::ivec3& chunkPos) { changed.insert(chunkPos); };
+    auto touchFlags = [this](const glm::ivec3& chunkPos) { touchSelection(chunkPos); };
+    storage->forEachChunk(collect);
+    selectedMask.forEachChunk(touchFlags);
+    highlightedMask.forEachChunk(touchFlags);
+    storage = snapshot.storage->clone(); // The snapshot stays untouched and can be restored again
+    selectedMask = snapshot.selected;
+    highlightedMask = snapshot.highlighted;
+    boundsMin = snapshot.boundsMin;
+    boundsMax = snapshot.boundsMax;
+    storage->forEachChunk(collect);
+    selectedMask.forEachChunk(touchFlags);
+    highlightedMask.forEachChunk(touchFlags);
+
+    // Smooth cells on a chunk border place their vertex from the neighbouring chunk's voxels,
+    // so the chunks around each changed one are remeshed too, as touchVoxel does for one voxel
+    int reach = meshingMode == MESH_SMOOTH ? 1 : 0;
+    for (const glm::ivec3& chunkPos : changed) {
+        for (int z = -reach; z <= reach; ++z) {
+            for (int y = -reach; y <= reach; ++y) {
+                for (int x = -reach; x <= reach; ++x) {
+                    touchChunk(chunkPos + glm::ivec3(x, y, z));
+                }
+            }
+        }
+    }
+    invalidateMesh();
+}
+
+void VoxelWorld::beginEdit() {
+    ++editDepth;
+}
+
+void VoxelWorld::commitEdit() {
+    if (editDepth == 0) {
+        std::cout << "commitEdit called without a matching beginEdit" << std::endl;
+        return;
+    }
+    if (--editDepth == 0 && meshDirty) {
+        finishEdit();
+    }
+}
+
+void VoxelWorld::fillBox(const glm::ivec3& boxMin, const glm::ivec3& boxMax, MaterialId material) {
+    glm::ivec3 from = glm::max(glm::min(boxMin, boxMax), storage->getMinPosition());
+    glm::ivec3 to = glm::min(glm::max(boxMin, boxMax), storage->getMaxPosition());
+    if (from != glm::min(boxMin, boxMax) || to != glm::max(boxMin, boxMax)) {
+        std::cout << "fillBox: clipped the box to the part the storage can hold" << std::endl;
+    }
+    for (int z = from.z; z <= to.z; ++z) {
+        for (int y = from.y; y <= to.y; ++y) {
+            for (int x = from.x; x <= to.x; ++x) {
+                writeVoxel(glm::ivec3(x, y, z), material);
+            }
+        }
+    }
+    invalidateMesh();
+}
+
+void VoxelWorld::setVoxels(const std::vector<std::pair<glm::ivec3, MaterialId>>& voxels) {
+    size_t rejected = 0;
+    for (const auto& voxel : voxels) {
+        if (!writeVoxel(voxel.first, voxel.second)) {
+            ++rejected;
+        }
+    }
+    if (rejected > 0) {
+        std::cout << "setVoxels: skipped " << rejected << " voxels outside the storage bounds" << std::endl;
+    }
+    invalidateMesh();
+}
+
+void VoxelWorld::removeVoxels(const std::vector<glm::ivec3>& positions) {
+    for (const auto& position : positions) {
+        writeVoxel(position, MaterialRegistry::NONE);
+    }
+    invalidateMesh();
+}
+
+void VoxelWorld::selectBox(const glm::ivec3& boxMin, const glm::ivec3& boxMax) {
+    bool changed = false;
+    storage->forEachVoxel(glm::min(boxMin, boxMax), glm::max(boxMin, boxMax), [&](const glm::ivec3& position, MaterialId) {
+        if (selectedMask.set(position)) {
+            touchSelection(VoxelChunk::chunkCoord(position));
+            changed = true;
+        }
+    });
+    if (changed) {
+        invalidateMesh(); // Nothing to remesh, but readers get the new selection
+    }
+}
+
 void VoxelWorld::setVoxel(int x, int y, int z, int type, const std::string& color, const std::string& texture) {
-    glm::vec3 colorVec(1.0f, 1.0f, 1.0f);
-    if (color == "red") {
-        colorVec = glm::vec3(1.0f, 0.0f, 0.0f);        
-    } else if (color == "green") {
-        colorVec = glm::vec3(0.0f, 1.0f, 0.0f);
-    } else if (color == "blue") {
-        colorVec = glm::vec3(0.0f, 0.0f, 1.0f);
-    } else if (color == "gray") {
-        colorVec = glm::vec3(0.5f, 0.5f, 0.5f); // Temporary voxel color
-    }
-    glm::ivec3 position(x, y, z);
-    voxels[position] = Voxel(type, colorVec, false, false, texture, position);
+    MaterialRegistry& registry = MaterialRegistry::global();
+    setVoxel(x, y, z, registry.getMaterial(type, MaterialRegistry::colorFromName(color), texture));
+}
+
+void VoxelWorld::setVoxel(int x, int y, int z, MaterialId material) {
+    // Marks the mesh dirty without rebuilding it, so loops of setVoxel followed by generateMeshData stay cheap
+    if (!writeVoxel(glm::ivec3(x, y, z), material)) {
+        std::cout << "Voxel (" << x << ", " << y << ", " << z << ") is outside the storage bounds" << std::endl;
+    }
     //std::cout << "Set voxel at: (" << x << ", " << y << ", " << z << ")\n";
 }
 
@@ -72,168 +279,144 @@ GLuint VoxelWorld::loadTexture(const std::string& path) {
     return textureID;
 }
 
-void VoxelWorld::calculateNormals(std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices) {
-    std::vector<float> normals(vertices.size() * 3, 0.0f);
-
-    for (size_t i = 0; i < indices.size(); i += 3) {
-        unsigned int idx0 = indices[i];
-        unsigned int idx1 = indices[i + 1];
-        unsigned int idx2 = indices[i + 2];
-
-        Vertex& v0 = vertices[idx0];
-        Vertex& v1 = vertices[idx1];
-        Vertex& v2 = vertices[idx2];
-
-        float ux = v1.x - v0.x;
-        float uy = v1.y - v0.y;
-        float uz = v1.z - v0.z;
-        float vx = v2.x - v0.x;
-        float vy = v2.y - v0.y;
-        float vz = v2.z - v0.z;
-
-        float nx = uy * vz - uz * vy;
-        float ny = uz * vx - ux * vz;
-        float nz = ux * vy - uy * vx;
-
-        normals[idx0 * 3] += nx;
-        normals[idx0 * 3 + 1] += ny;
-        normals[idx0 * 3 + 2] += nz;
-        normals[idx1 * 3] += nx;
-        normals[idx1 * 3 + 1] += ny;
-        normals[idx1 * 3 + 2] += nz;
-        normals[idx2 * 3] += nx;
-        normals[idx2 * 3 + 1] += ny;
-        normals[idx2 * 3 + 2] += nz;
-    }
-
-    for (size_t i = 0; i < vertices.size(); ++i) {
-        float length = std::sqrt(normals[i * 3] * normals[i * 3] + normals[i * 3 + 1] * normals[i * 3 + 1] + normals[i * 3 + 2] * normals[i * 3 + 2]);
-        if (length > 0) {
-            normals[i * 3] /= length;
-            normals[i * 3 + 1] /= length;
-            normals[i * 3 + 2] /= length;
-        }
-        vertices[i].nx = normals[i * 3];
-        vertices[i].ny = normals[i * 3 + 1];
-        vertices[i].nz = normals[i * 3 + 2];
+void VoxelWorld::generateMeshData() {
+    meshDirty = false;
+    if (asyncMeshing) {
+        startMeshing();
+        return;
     }
+    if (dirtyChunks.empty()) {
+        return;
+    }
+    // Meshing only reads the storage and masks, so chunks can be built on every core at
+    // once; the map of meshes is only written back here on the owning thread
+    std::vector<glm::ivec3> chunks(dirtyChunks.begin(), dirtyChunks.end());
+    dirtyChunks.clear();
+    std::vector<ChunkMesh> built;
+    meshPipeline.meshNow(*storage, meshingMode, lodLevels, chunks, built);
+    applyMeshes(chunks, built);
 }
 
-void VoxelWorld::addFace(std::vector<Vertex>& vertexBuffer, std::vector<unsigned int>& indexBuffer, int x, int y, int z, const std::vector<Vertex>& faceVertices, const std::vector<unsigned int>& faceIndices, const glm::vec3& color) {
-    unsigned int baseIndex = static_cast<unsigned int>(vertexBuffer.size());
-
-    float scale = 1.0f / 5.0f;  // Assuming we want the texture to repeat every 5 voxels
-
-    for (const auto& vertex : faceVertices) {
-        float u = vertex.u * scale;
-        float v = vertex.v * scale;
+void VoxelWorld::startMeshing() {
+    // Chunks edited while a batch runs go out with the next one; an open edit goes out whole once committed
+    if (dirtyChunks.empty() || editDepth > 0 || meshPipeline.isBusy()) {
+        return;
+    }
+    std::vector<glm::ivec3> chunks(dirtyChunks.begin(), dirtyChunks.end());
+    dirtyChunks.clear();
+    for (const glm::ivec3& chunkPos : chunks) {
+        meshingChunks.insert(chunkPos);
+    }
+    meshPipeline.submit(snapshot(), meshingMode, lodLevels, std::move(chunks));
+}
 
-        // Adjust the UV coordinates based on the face being processed
-        if (vertex.nx != 0) { // Left or Right face
-            u += (z % 5) * scale;
-            v += (y % 5) * scale;
-        } else if (vertex.ny != 0) { // Top or Bottom face
-            u += (x % 5) * scale;
-            v += (z % 5) * scale;
-        } else if (vertex.nz != 0) { // Front or Back face
-            u += (x % 5) * scale;
-            v += (y % 5) * scale;
+void VoxelWorld::applyMeshes(const std::vector<glm::ivec3>& chunks, std::vector<ChunkMesh>& meshes) {
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        const glm::ivec3& chunkPos = chunks[i];
+        if (!meshes[i].empty()) {
+            const ChunkMesh* previous = chunkMeshes.find(chunkPos);
+            bool unchanged = previous && previous->contentKey != 0 && previous->contentKey == meshes[i].contentKey;
+            meshes[i].generation = unchanged ? previous->generation : ++meshGeneration;
+            chunkMeshes[chunkPos] = std::move(meshes[i]);
+        } else {
+            chunkMeshes.erase(chunkPos);
+            // Missing entries read as version 0, which still differs from whatever a reader saw before
+            if (!storage->hasChunk(chunkPos)) {
+                chunkVersions.erase(chunkPos);
+            }
         }
+        updatedChunks.insert(chunkPos);
+        meshPatches.erase(chunkPos); // Re-uploaded whole
+    }
+}
 
-        vertexBuffer.emplace_back(vertex.x + x, vertex.y + y, vertex.z + z, color.r, color.g, color.b, vertex.nx, vertex.ny, vertex.nz, u, v);
+bool VoxelWorld::swapMeshBuffers() {
+    std::vector<glm::ivec3> chunks;
+    std::vector<ChunkMesh> meshes;
+    bool swapped = meshPipeline.takeFinished(chunks, meshes);
+    if (swapped) {
+        for (const glm::ivec3& chunkPos : chunks) {
+            meshingChunks.erase(chunkPos);
+        }
+        applyMeshes(chunks, meshes);
     }
+    startMeshing();
+    return swapped;
+}
 
-    for (const auto& index : faceIndices) {
-        indexBuffer.push_back(baseIndex + index);
+void VoxelWorld::waitForMeshing() {
+    while (meshPipeline.isBusy()) {
+        meshPipeline.wait();
+        swapMeshBuffers();
     }
 }
 
+void VoxelWorld::setAsyncMeshing(bool enabled) {
+    if (enabled == asyncMeshing) {
+        return;
+    }
+    if (!enabled) {
+        // Meshing on this thread again would share the meshers with the background batch
+        waitForMeshing();
+    }
+    asyncMeshing = enabled;
+    generateMeshData();
+}
 
-void VoxelWorld::generateMeshData() {
-    selectedVertices.clear();
-    selectedIndices.clear();
-    unselectedVertices.clear();
-    unselectedIndices.clear();
-
-    const float halfSize = 0.5f;
-
-    const std::vector<Vertex> faceVertices[6] = {
-        // Front face
-        { Vertex(-halfSize, -halfSize, halfSize, 1, 0, 0, 0, 0, 1, 0, 0),
-          Vertex(halfSize, -halfSize, halfSize, 0, 1, 0, 0, 0, 1, 1, 0),
-          Vertex(halfSize, halfSize, halfSize, 0, 0, 1, 0, 0, 1, 1, 1),
-          Vertex(-halfSize, halfSize, halfSize, 1, 1, 0, 0, 0, 1, 0, 1) },
-        // Back face
-        { Vertex(-halfSize, -halfSize, -halfSize, 1, 0, 0, 0, 0, -1, 0, 0),
-          Vertex(halfSize, -halfSize, -halfSize, 0, 1, 0, 0, 0, -1, 1, 0),
-          Vertex(halfSize, halfSize, -halfSize, 0, 0, 1, 0, 0, -1, 1, 1),
-          Vertex(-halfSize, halfSize, -halfSize, 1, 1, 0, 0, 0, -1, 0, 1) },
-        // Left face
-        { Vertex(-halfSize, -halfSize, -halfSize, 1, 0, 0, -1, 0, 0, 0, 0),
-          Vertex(-halfSize, -halfSize, halfSize, 0, 1, 0, -1, 0, 0, 1, 0),
-          Vertex(-halfSize, halfSize, halfSize, 0, 0, 1, -1, 0, 0, 1, 1),
-          Vertex(-halfSize, halfSize, -halfSize, 1, 1, 0, -1, 0, 0, 0, 1) },
-        // Right face
-        { Vertex(halfSize, -halfSize, -halfSize, 1, 0, 0, 1, 0, 0, 0, 0),
-          Vertex(halfSize, -halfSize, halfSize, 0, 1, 0, 1, 0, 0, 1, 0),
-          Vertex(halfSize, halfSize, halfSize, 0, 0, 1, 1, 0, 0, 1, 1),
-          Vertex(halfSize, halfSize, -halfSize, 1, 1, 0, 1, 0, 0, 0, 1) },
-        // Top face
-        { Vertex(-halfSize, halfSize, -halfSize, 1, 0, 0, 0, 1, 0, 0, 0),
-          Vertex(halfSize, halfSize, -halfSize, 0, 1, 0, 0, 1, 0, 1, 0),
-          Vertex(halfSize, halfSize, halfSize, 0, 0, 1, 0, 1, 0, 1, 1),
-          Vertex(-halfSize, halfSize, halfSize, 1, 1, 0, 0, 1, 0, 0, 1) },
-        // Bottom face
-        { Vertex(-halfSize, -halfSize, -halfSize, 1, 0, 0, 0, -1, 0, 0, 0),
-          Vertex(halfSize, -halfSize, -halfSize, 0, 1, 0, 0, -1, 0, 1, 0),
-          Vertex(halfSize, -halfSize, halfSize, 0, 0, 1, 0, -1, 0, 1, 1),
-          Vertex(-halfSize, -halfSize, halfSize, 1, 1, 0, 0, -1, 0, 0, 1) }
-    };
-
-    const std::vector<unsigned int> faceIndices = { 0, 1, 2, 2, 3, 0 };
-
-    for (const auto& voxelPair : voxels) {
-        const glm::ivec3& pos = voxelPair.second.position;
-        glm::vec3 color = voxelPair.second.color;
-
-        if (voxelPair.second.selected) {
-            color = glm::vec3(1.0f, 0.0f, 0.0f); // Red for selected
-        } else if (voxelPair.second.highlighted) {
-            color = glm::vec3(1.0f, 0.7f, 0.0f); // Orange for highlighted
-        }
+void VoxelWorld::setMeshingMode(MeshingMode mode) {
+    if (mode == meshingMode) {
+        return;
+    }
+    meshingMode = mode;
+    // The voxels did not change, so chunk versions stay as they are
+    for (const auto& entry : chunkMeshes) {
+        dirtyChunks.insert(entry.first);
+    }
+    invalidateMesh();
+}
 
-        auto& vertexBuffer = voxelPair.second.selected || voxelPair.second.highlighted ? selectedVertices : unselectedVertices;
-        auto& indexBuffer = voxelPair.second.selected || voxelPair.second.highlighted ? selectedIndices : unselectedIndices;
+void VoxelWorld::setLodLevels(int levels) {
+    levels = std::max(0, std::min(levels, ChunkMesher::MAX_LOD_LEVELS));
+    if (levels == lodLevels) {
+        return;
+    }
+    lodLevels = levels;
+    for (const auto& entry : chunkMeshes) {
+        dirtyChunks.insert(entry.first);
+    }
+    invalidateMesh();
+}
 
-        if (!voxels.count(getVoxelIndex(pos.x, pos.y, pos.z + 1))) {
-            addFace(vertexBuffer, indexBuffer, pos.x, pos.y, pos.z, faceVertices[0], faceIndices, color);
-        }
-        if (!voxels.count(getVoxelIndex(pos.x, pos.y, pos.z - 1))) {
-            addFace(vertexBuffer, indexBuffer, pos.x, pos.y, pos.z, faceVertices[1], faceIndices, color);
-        }
-        if (!voxels.count(getVoxelIndex(pos.x - 1, pos.y, pos.z))) {
-            addFace(vertexBuffer, indexBuffer, pos.x, pos.y, pos.z, faceVertices[2], faceIndices, color);
-        }
-        if (!voxels.count(getVoxelIndex(pos.x + 1, pos.y, pos.z))) {
-            addFace(vertexBuffer, indexBuffer, pos.x, pos.y, pos.z, faceVertices[3], faceIndices, color);
-        }
-        if (!voxels.count(getVoxelIndex(pos.x, pos.y + 1, pos.z))) {
-            addFace(vertexBuffer, indexBuffer, pos.x, pos.y, pos.z, faceVertices[4], faceIndices, color);
-        }
-        if (!voxels.count(getVoxelIndex(pos.x, pos.y - 1, pos.z))) {
-            addFace(vertexBuffer, indexBuffer, pos.x, pos.y, pos.z, faceVertices[5], faceIndices, color);
+void VoxelWorld::saveMeshCache() {
+    MeshCache& cache = meshPipeline.getCache();
+    for (const auto& entry : chunkMeshes) {
+        if (entry.second.contentKey != 0) {
+            cache.save(entry.second.contentKey, entry.second);
         }
     }
+    cache.trimDirectory();
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, unselectedVBO);
-    glBufferData(GL_ARRAY_BUFFER, unselectedVertices.size() * sizeof(Vertex), unselectedVertices.data(), GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, unselectedEBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, unselectedIndices.size() * sizeof(unsigned int), unselectedIndices.data(), GL_STATIC_DRAW);
+std::vector<glm::ivec3> VoxelWorld::takeUpdatedChunks() {
+    std::vector<glm::ivec3> chunks(updatedChunks.begin(), updatedChunks.end());
+    updatedChunks.clear();
+    return chunks;
+}
+
+std::vector<std::pair<glm::ivec3, MeshPatch>> VoxelWorld::takeMeshPatches() {
+    std::vector<std::pair<glm::ivec3, MeshPatch>> patches;
+    patches.reserve(meshPatches.size());
+    for (const auto& entry : meshPatches) {
+        patches.emplace_back(entry.first, entry.second);
+    }
+    meshPatches.clear();
+    return patches;
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, selectedVBO);
-    glBufferData(GL_ARRAY_BUFFER, selectedVertices.size() * sizeof(Vertex), selectedVertices.data(), GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, selectedEBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, selectedIndices.size() * sizeof(unsigned int), selectedIndices.data(), GL_STATIC_DRAW);
+std::vector<glm::ivec3> VoxelWorld::takeSelectionChangedChunks() {
+    std::vector<glm::ivec3> chunks(selectionChangedChunks.begin(), selectionChangedChunks.end());
+    selectionChangedChunks.clear();
+    return chunks;
 }
 
 bool VoxelWorld::rayIntersectsTriangle(const glm::vec3& rayOrigin, const glm::vec3& rayDirection, const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, glm::vec3& hitPoint) {
@@ -269,123 +452,227 @@ bool VoxelWorld::rayIntersectsTriangle(const glm::vec3& rayOrigin, const glm::ve
 }
 
 //bool VoxelWorld::raycast(const glm::vec3& rayOrigin, const glm::vec3& rayDirection, glm::ivec3& hitVoxel) {
-bool VoxelWorld::raycast(const glm::vec3& rayOrigin, const glm::vec3& rayDirection, glm::ivec3& hitVoxel, glm::vec3& hitNormal, FaceDirection& hitFace) {
-    float closestDistance = std::numeric_limits<float>::max();
-    bool hit = false;
-
-    for (const auto& voxelPair : voxels) {
-        const Voxel& voxel = voxelPair.second;
-        glm::vec3 voxelMin = glm::vec3(voxel.position) - glm::vec3(0.5f);
-        glm::vec3 voxelMax = glm::vec3(voxel.position) + glm::vec3(0.5f);
-
-        float tMin = (voxelMin.x - rayOrigin.x) / rayDirection.x;
-        float tMax = (voxelMax.x - rayOrigin.x) / rayDirection.x;
-
-        if (tMin > tMax) std::swap(tMin, tMax);
-
-        float tyMin = (voxelMin.y - rayOrigin.y) / rayDirection.y;
-        float tyMax = (voxelMax.y - rayOrigin.y) / rayDirection.y;
-
-        if (tyMin > tyMax) std::swap(tyMin, tyMax);
+// Shared by the live world and snapshots, so worker threads can pick against a snapshot
+static bool raycastStorage(const VoxelStorage& storage, const glm::ivec3& boundsMin, const glm::ivec3& boundsMax,
+                           const glm::vec3& rayOrigin, const glm::vec3& rayDirection, glm::ivec3& hitVoxel, glm::vec3& hitNormal, FaceDirection& hitFace) {
+    hitFace = NONE; // No face was hit
+    if (storage.getVoxelCount() == 0) {
+        return false;
+    }
 
-        if ((tMin > tyMax) || (tyMin > tMax))
+    // Voxel v fills [v - 0.5, v + 0.5], so shifting by half a voxel puts cell borders on integers
+    glm::vec3 start = rayOrigin + 0.5f;
+    glm::vec3 gridMin(boundsMin);
+    glm::vec3 gridMax(boundsMax + 1);
+
+    // Clip the ray to the occupied bounds, then walk the cells it crosses front to back.
+    // The walk stops at the first filled cell, so its cost follows the ray length, not the voxel count.
+    float tEnter = 0.0f;
+    float tExit = std::numeric_limits<float>::max();
+    int axis = -1; // Axis of the last cell border crossed
+    for (int i = 0; i < 3; ++i) {
+        if (rayDirection[i] == 0.0f) {
+            if (start[i] < gridMin[i] || start[i] >= gridMax[i]) {
+                return false;
+            }
             continue;
+        }
+        float t0 = (gridMin[i] - start[i]) / rayDirection[i];
+        float t1 = (gridMax[i] - start[i]) / rayDirection[i];
+        if (t0 > t1) std::swap(t0, t1);
+        if (t0 > tEnter) {
+            tEnter = t0;
+            axis = i;
+        }
+        tExit = std::min(tExit, t1);
+    }
+    if (tEnter > tExit) {
+        return false;
+    }
 
-        if (tyMin > tMin)
-            tMin = tyMin;
-
-        if (tyMax < tMax)
-            tMax = tyMax;
-
-        float tzMin = (voxelMin.z - rayOrigin.z) / rayDirection.z;
-        float tzMax = (voxelMax.z - rayOrigin.z) / rayDirection.z;
+    glm::ivec3 cell = glm::clamp(glm::ivec3(glm::floor(start + rayDirection * tEnter)), boundsMin, boundsMax);
+    glm::ivec3 step;
+    glm::vec3 tNext;
+    glm::vec3 tDelta;
+    for (int i = 0; i < 3; ++i) {
+        step[i] = rayDirection[i] > 0.0f ? 1 : -1;
+        if (rayDirection[i] == 0.0f) {
+            tNext[i] = std::numeric_limits<float>::max();
+            tDelta[i] = std::numeric_limits<float>::max();
+        } else {
+            tNext[i] = (cell[i] + (step[i] > 0 ? 1 : 0) - start[i]) / rayDirection[i];
+            tDelta[i] = std::abs(1.0f / rayDirection[i]);
+        }
+    }
 
-        if (tzMin > tzMax) std::swap(tzMin, tzMax);
+    while (glm::all(glm::greaterThanEqual(cell, boundsMin)) && glm::all(glm::lessThanEqual(cell, boundsMax))) {
+        if (storage.hasVoxel(cell)) {
+            hitVoxel = cell;
+            if (axis < 0) {
+                // The ray starts inside this voxel, fall back to the side nearest the origin
+                glm::vec3 localHitPoint = rayOrigin - glm::vec3(cell);
+                glm::vec3 extent = glm::abs(localHitPoint);
+                axis = extent.x > extent.y && extent.x > extent.z ? 0 : (extent.y > extent.x && extent.y > extent.z ? 1 : 2);
+                step[axis] = localHitPoint[axis] > 0 ? -1 : 1;
+            }
+            hitNormal = glm::vec3(0.0f);
+            hitNormal[axis] = static_cast<float>(-step[axis]);
+            static const FaceDirection positiveFaces[3] = { RIGHT, UP, FORWARD };
+            static const FaceDirection negativeFaces[3] = { LEFT, DOWN, BACKWARD };
+            hitFace = step[axis] < 0 ? positiveFaces[axis] : negativeFaces[axis];
+            return true;
+        }
+        axis = tNext.x < tNext.y ? (tNext.x < tNext.z ? 0 : 2) : (tNext.y < tNext.z ? 1 : 2);
+        cell[axis] += step[axis];
+        tNext[axis] += tDelta[axis];
+    }
+    return false;
+}
 
-        if ((tMin > tzMax) || (tzMin > tMax))
-            continue;
+bool VoxelWorld::raycast(const glm::vec3& rayOrigin, const glm::vec3& rayDirection, glm::ivec3& hitVoxel, glm::vec3& hitNormal, FaceDirection& hitFace) {
+    return raycastStorage(*storage, boundsMin, boundsMax, rayOrigin, rayDirection, hitVoxel, hitNormal, hitFace);
+}
 
-        if (tzMin > tMin)
-            tMin = tzMin;
+bool VoxelSnapshot::raycast(const glm::vec3& rayOrigin, const glm::vec3& rayDirection, glm::ivec3& hitVoxel, glm::vec3& hitNormal, FaceDirection& hitFace) const {
+    return raycastStorage(*storage, boundsMin, boundsMax, rayOrigin, rayDirection, hitVoxel, hitNormal, hitFace);
+}
 
-        if (tzMax < tMax)
-            tMax = tzMax;
 
-        if (tMin < 0) tMin = tMax;
 
-        if (tMin < closestDistance) {
-            closestDistance = tMin;
-            hitVoxel = voxel.position;
-            hit = true;
+ 
 
-            // Determine which face was hit based on the minimum t value
-            glm::vec3 hitPoint = rayOrigin + tMin * rayDirection;
-            glm::vec3 voxelCenter = glm::vec3(voxel.position);
-            glm::vec3 localHitPoint = hitPoint - voxelCenter;
+void VoxelWorld::updateVoxelColor(const glm::ivec3& voxel, const glm::vec3& color) {
+    updateVoxelColors(std::vector<glm::ivec3>(1, voxel), color);
+}
 
-            if (abs(localHitPoint.x) > abs(localHitPoint.y) && abs(localHitPoint.x) > abs(localHitPoint.z)) {
-                hitNormal = glm::vec3(glm::sign(localHitPoint.x), 0.0f, 0.0f);
-                hitFace = localHitPoint.x > 0 ? RIGHT : LEFT;
-            } else if (abs(localHitPoint.y) > abs(localHitPoint.x) && abs(localHitPoint.y) > abs(localHitPoint.z)) {
-                hitNormal = glm::vec3(0.0f, glm::sign(localHitPoint.y), 0.0f);
-                hitFace = localHitPoint.y > 0 ? UP : DOWN;
+void VoxelWorld::updateVoxelColors(const std::vector<glm::ivec3>& voxels, const glm::vec3& color) {
+    MaterialRegistry& registry = MaterialRegistry::global();
+    bool changed = false;
+    VoxelHashSet patchedChunks;
+    for (const glm::ivec3& voxel : voxels) {
+        MaterialId current = storage->getVoxel(voxel);
+        if (current == MaterialRegistry::NONE) {
+            continue;
+        }
+        glm::ivec3 chunkPos = VoxelChunk::chunkCoord(voxel);
+        const Material& material = registry.get(current);
+        MaterialId recolored = registry.getMaterial(material.type, color, material.texture);
+        if (recolored != current) {
+            storage->setVoxel(voxel, recolored);
+            if (patchVoxelMaterial(voxel, recolored)) {
+                chunkVersions[chunkPos] = ++version; // Readers still see the chunk change
+                patchedChunks.insert(chunkPos);
+            } else if (meshingMode == MESH_SMOOTH) {
+                touchVoxel(voxel); // Smooth cells on the border take their colour from the neighbour's voxels
             } else {
-                hitNormal = glm::vec3(0.0f, 0.0f, glm::sign(localHitPoint.z));
-                hitFace = localHitPoint.z > 0 ? FORWARD : BACKWARD;
+                touchChunk(chunkPos);
             }
+            changed = true;
+        }
+        if (selectedMask.set(voxel)) {
+            touchSelection(chunkPos);
+            changed = true;
+        }
+    }
+    // A coarse cell takes the colour of one of its voxels, so coarse meshes cannot be patched;
+    // rebuilding them skips the full detail mesh, which is most of the work
+    for (const glm::ivec3& chunkPos : patchedChunks) {
+        ChunkMesh* mesh = chunkMeshes.find(chunkPos);
+        if (!mesh || mesh->lods.empty() || dirtyChunks.contains(chunkPos)) {
+            continue;
         }
+        meshPipeline.meshLodsNow(*storage, meshingMode, lodLevels, chunkPos, *mesh);
+        mesh->generation = ++meshGeneration;
+        updatedChunks.insert(chunkPos);
+        meshPatches.erase(chunkPos); // Re-uploaded whole
     }
-    if (!hit) {
-        hitFace = NONE; // No face was hit
+    if (changed) {
+        invalidateMesh(); // Remeshes only the chunks that could not be patched
     }
-    return hit;
 }
 
-
-
- 
-
-void VoxelWorld::updateVoxelColor(const glm::ivec3& voxel, const glm::vec3& color) {
-    if (voxels.find(voxel) != voxels.end()) {
-        voxels[voxel].color = color;
-        voxels[voxel].selected = true;
-        generateMeshData();
+bool VoxelWorld::patchVoxelMaterial(const glm::ivec3& voxel, MaterialId material) {
+    glm::ivec3 chunkPos = VoxelChunk::chunkCoord(voxel);
+    if (dirtyChunks.contains(chunkPos) || meshingChunks.contains(chunkPos)) {
+        return false; // A newer mesh is on its way and would undo the patch
+    }
+    if (meshingMode == MESH_SMOOTH) {
+        return false; // Smooth vertices are shared by neighbouring voxels, not owned by one
     }
+    // Occupancy is unchanged, so the voxel shows exactly the faces it showed before
+    int exposed = 0;
+    for (int axis = 0; axis < 3; ++axis) {
+        for (int step = -1; step <= 1; step += 2) {
+            glm::ivec3 neighbour = voxel;
+            neighbour[axis] += step;
+            exposed += !storage->hasVoxel(neighbour);
+        }
+    }
+    ChunkMesh* mesh = chunkMeshes.find(chunkPos);
+    if (!mesh) {
+        return exposed == 0;
+    }
+    std::pair<const VoxelQuad*, const VoxelQuad*> quads = mesh->findVoxelQuads(VoxelChunk::localIndex(VoxelChunk::localCoord(voxel)));
+    if (quads.second - quads.first != exposed) {
+        return false; // Some face is part of a merged quad, which has to be split
+    }
+    mesh->contentKey = 0; // The coarse meshes are rebuilt from the new colours, and the key is of the old ones
+    if (exposed == 0) {
+        return true;
+    }
+    mesh->generation = ++meshGeneration;
+    uint32_t first = quads.first->quad * 4;
+    uint32_t end = (quads.second - 1)->quad * 4 + 4;
+    for (const VoxelQuad* entry = quads.first; entry != quads.second; ++entry) {
+        for (uint32_t vertex = entry->quad * 4; vertex < entry->quad * 4 + 4; ++vertex) {
+            mesh->vertices[vertex].material = material;
+        }
+    }
+    // One span per chunk: the renderer uploads from the first to the last patched vertex
+    MeshPatch* patch = meshPatches.find(chunkPos);
+    if (patch) {
+        end = std::max(end, patch->firstVertex + patch->vertexCount);
+        first = std::min(first, patch->firstVertex);
+    }
+    meshPatches[chunkPos] = { first, end - first };
+    return true;
 }
 
 void VoxelWorld::selectVoxel(const glm::ivec3& voxel) {
-    if (voxels.find(voxel) != voxels.end()) {
-        voxels[voxel].selected = true;
+    // Nothing to redraw if it was already selected
+    if (hasVoxel(voxel) && selectedMask.set(voxel)) {
+        touchSelection(VoxelChunk::chunkCoord(voxel));
         //std::cout << "Voxel selected: " << voxel.x << ", " << voxel.y << ", " << voxel.z << std::endl;
-        generateMeshData();  // Regenerate mesh data to update the selection
+        invalidateMesh();  // Nothing to remesh, but readers get the new selection
     }
 }
 
 void VoxelWorld::highlightVoxel(const glm::ivec3& voxel) {
-    if (voxels.find(voxel) != voxels.end() && !voxels[voxel].selected) {
-        //std::cout << "highlightVoxel  selected: " << voxels[voxel].selected << " at " << voxel.x << ", " << voxel.y << ", " << voxel.z << std::endl;
-        voxels[voxel].highlighted = true;
-        generateMeshData(); // Regenerate mesh data to update the highlight
+    if (hasVoxel(voxel) && !selectedMask.test(voxel) && highlightedMask.set(voxel)) {
+        touchSelection(VoxelChunk::chunkCoord(voxel));
+        //std::cout << "highlightVoxel  selected: " << selectedMask.test(voxel) << " at " << voxel.x << ", " << voxel.y << ", " << voxel.z << std::endl;
+        invalidateMesh(); // Nothing to remesh, but readers get the new highlight
     }
 }
 
 void VoxelWorld::resetHighlight(const glm::ivec3& voxel) {
-    if (voxels.find(voxel) != voxels.end() && !voxels[voxel].selected) {
-        //std::cout << "resetHighlight  selected: " << voxels[voxel].selected << " at " << voxel.x << ", " << voxel.y << ", " << voxel.z << std::endl;
-        voxels[voxel].highlighted = false;
-        generateMeshData(); // Regenerate mesh data to update the highlight
+    if (!selectedMask.test(voxel) && highlightedMask.reset(voxel)) {
+        touchSelection(VoxelChunk::chunkCoord(voxel));
+        //std::cout << "resetHighlight  selected: " << selectedMask.test(voxel) << " at " << voxel.x << ", " << voxel.y << ", " << voxel.z << std::endl;
+        invalidateMesh(); // Nothing to remesh, but readers get the new highlight
     }
 }
 
 
 
 void VoxelWorld::clearSelections(ExtrusionManager& extrusionManager) {
-    for (auto& pair : voxels) {
-        pair.second.selected = false;
-        pair.second.highlighted = false;
-    }
+    auto touch = [this](const glm::ivec3& chunkPos) { touchSelection(chunkPos); };
+    selectedMask.forEachChunk(touch);
+    highlightedMask.forEachChunk(touch);
+    selectedMask.clear();
+    highlightedMask.clear();
     extrusionManager.clearSelectedVoxels();
-    generateMeshData();
+    invalidateMesh();
 }
 
 
@@ -393,53 +680,45 @@ void VoxelWorld::clearSelections(ExtrusionManager& extrusionManager) {
 
 
 bool VoxelWorld::isVoxelSelected(const glm::ivec3& voxel) const {
-    auto it = voxels.find(voxel);
-    return it != voxels.end() && it->second.selected;
+    return selectedMask.test(voxel);
 }
 
 
 
 void VoxelWorld::extrudeVoxels(int direction, int layers) {
-    std::vector<Voxel> newVoxels;
-    for (const auto& voxelPair : voxels) {
-        const Voxel& voxel = voxelPair.second;
-        if (voxel.selected) {
-            for (int i = 1; i <= layers; ++i) {
-                glm::ivec3 newPos = voxel.position;
-                switch (direction) {
-                    case 0: newPos.x += i; break; // Right
-                    case 1: newPos.x -= i; break; // Left
-                    case 2: newPos.y += i; break; // Up
-                    case 3: newPos.y -= i; break; // Down
-                    case 4: newPos.z += i; break; // Forward
-                    case 5: newPos.z -= i; break; // Backward
-                }
-                if (voxels.find(newPos) == voxels.end()) {
-                    newVoxels.emplace_back(voxel.type, voxel.color, false, false, voxel.texture, newPos);
-                }
+    std::vector<std::pair<glm::ivec3, MaterialId>> newVoxels;
+    selectedMask.forEach([&](const glm::ivec3& position) {
+        MaterialId material = storage->getVoxel(position);
+        for (int i = 1; i <= layers; ++i) {
+            glm::ivec3 newPos = position;
+            switch (direction) {
+                case 0: newPos.x += i; break; // Right
+                case 1: newPos.x -= i; break; // Left
+                case 2: newPos.y += i; break; // Up
+                case 3: newPos.y -= i; break; // Down
+                case 4: newPos.z += i; break; // Forward
+                case 5: newPos.z -= i; break; // Backward
+            }
+            if (!hasVoxel(newPos)) {
+                newVoxels.emplace_back(newPos, material);
             }
         }
-    }
-    for (const auto& voxel : newVoxels) {
-        voxels[voxel.position] = voxel;
-    }
-    generateMeshData();
+    });
+    setVoxels(newVoxels);
 }
 
 void VoxelWorld::removeSelectedVoxels() {
-    for (auto it = voxels.begin(); it != voxels.end(); ) {
-        if (it->second.selected) {
-            it = voxels.erase(it);  // Remove the voxel if it's selected
-        } else {
-            ++it;
-        }
-    }
-    generateMeshData();  // Regenerate mesh data to update the scene
+    selectedMask.forEach([&](const glm::ivec3& position) {
+        storage->removeVoxel(position);  // Remove the voxel if it's selected
+        touchVoxel(position);
+    });
+    selectedMask.forEachChunk([this](const glm::ivec3& chunkPos) { touchSelection(chunkPos); });
+    highlightedMask.subtract(selectedMask);
+    selectedMask.clear();
+    invalidateMesh();  // Regenerate mesh data to update the scene
 }
 
 void VoxelWorld::removeVoxel(const glm::ivec3& position) {
-    voxels.erase(position); // Correctly remove the voxel from the map
-    generateMeshData(); // Regenerate mesh data to update the scene
+    writeVoxel(position, MaterialRegistry::NONE);
+    invalidateMesh(); // Regenerate mesh data to update the scene
 }
-
-
@@ -10,10 +10,14 @@
 #include <fstream>
 #include <sstream>
 #include <chrono>
+#include <algorithm>
 #include "VoxelWorld.h"
+#include "MaterialRegistry.h"
 #include "Camera.h"
 #include "SelectionManager.h"
 #include "ExtrusionManager.h"
+#include "VoxelHashMap.h"
+#include "GpuBufferManager.h"
 #include <glm/gtx/string_cast.hpp>
 
 
@@ -34,6 +38,7 @@ SelectionManager selectionManager;
 ExtrusionManager extrusionManager;
 bool isDragging = false;
 glm::dvec2 dragStart, dragEnd;
+bool meshModeKeyDown = false; // M switches the meshing mode once per press
 
 // Global variables
 glm::mat4 projection;
@@ -81,18 +86,207 @@ void logCameraState(const Camera& camera) {
     std::cout << "Camera Pitch: " << camera.pitch << std::endl;
 }
 
-void drawVoxels(GLuint VAO, GLuint VBO, GLuint EBO, const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, GLuint useTextureLoc, GLuint objectColorLoc, const glm::vec3& color, bool useTexture) {
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
-    glUniform1i(useTextureLoc, useTexture ? 1 : 0);
-    glUniform3fv(objectColorLoc, 1, glm::value_ptr(color));
-    glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(indices.size()), GL_UNSIGNED_INT, 0);
+// Chunks closer than this draw at full detail; every doubling of the distance drops one level
+const float LOD_DISTANCE = 128.0f;
+// Far enough for the coarsest level to be worth having; near is kept at 0.1 for editing up close
+const float FAR_PLANE = 1024.0f;
+GpuBufferManager gpuBuffers;
+
+// Hands the chunks the world remeshed or recoloured since the last frame to the buffer
+// manager, which skips meshes whose generation it already holds
+void uploadChunkMeshes(VoxelWorld& voxelWorld) {
+    for (const glm::ivec3& chunkPos : voxelWorld.takeUpdatedChunks()) {
+        const ChunkMesh* mesh = voxelWorld.getChunkMesh(chunkPos);
+        if (mesh) {
+            gpuBuffers.upload(chunkPos, *mesh);
+        } else {
+            gpuBuffers.release(chunkPos);
+        }
+    }
+
+    // Recoloured voxels only rewrite their vertices' material word, so copy just that span
+    for (const auto& patch : voxelWorld.takeMeshPatches()) {
+        const ChunkMesh* mesh = voxelWorld.getChunkMesh(patch.first);
+        if (mesh) {
+            gpuBuffers.patch(patch.first, *mesh, patch.second.firstVertex, patch.second.vertexCount);
+        }
+    }
+}
+
+// Selection and highlight bits for the fragment shader, one slot per chunk with anything
+// flagged. Hovering or selecting rewrites the slots of the chunks it touched and nothing else.
+const GLsizeiptr SELECTION_SLOT_WORDS = 2 * VoxelChunk::WORDS * 2; // Selected then highlighted mask, in 32-bit words
+GLuint selectionBuffer = 0;
+GLuint selectionTexture = 0;
+int selectionSlotCapacity = 0;
+VoxelHashMap<int> selectionSlots;
+std::vector<int> freeSelectionSlots;
+
+void uploadSelectionSlot(const VoxelWorld& voxelWorld, const glm::ivec3& chunkPos, int slot) {
+    // Mask words are little-endian 64-bit, so they read as the shader's 32-bit words in the same bit order
+    std::vector<uint64_t> words(2 * VoxelChunk::WORDS, 0);
+    const uint64_t* selected = voxelWorld.getSelection().getChunkBits(chunkPos);
+    const uint64_t* highlighted = voxelWorld.getHighlight().getChunkBits(chunkPos);
+    if (selected) {
+        std::copy(selected, selected + VoxelChunk::WORDS, words.begin());
+    }
+    if (highlighted) {
+        std::copy(highlighted, highlighted + VoxelChunk::WORDS, words.begin() + VoxelChunk::WORDS);
+    }
+    glBufferSubData(GL_TEXTURE_BUFFER, slot * SELECTION_SLOT_WORDS * sizeof(uint32_t), SELECTION_SLOT_WORDS * sizeof(uint32_t), words.data());
+}
+
+void updateSelectionOverlay(VoxelWorld& voxelWorld) {
+    if (selectionBuffer == 0) {
+        glGenBuffers(1, &selectionBuffer);
+        glGenTextures(1, &selectionTexture);
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, selectionBuffer);
+    bool grown = false;
+    for (const glm::ivec3& chunkPos : voxelWorld.takeSelectionChangedChunks()) {
+        int* slot = selectionSlots.find(chunkPos);
+        if (!voxelWorld.getSelection().getChunkBits(chunkPos) && !voxelWorld.getHighlight().getChunkBits(chunkPos)) {
+            if (slot) {
+                freeSelectionSlots.push_back(*slot);
+                selectionSlots.erase(chunkPos);
+            }
+            continue;
+        }
+        if (!slot) {
+            int next;
+            if (!freeSelectionSlots.empty()) {
+                next = freeSelectionSlots.back();
+                freeSelectionSlots.pop_back();
+            } else {
+                next = static_cast<int>(selectionSlots.size());
+            }
+            slot = &selectionSlots[chunkPos];
+            *slot = next;
+        }
+        if (*slot >= selectionSlotCapacity) {
+            // Reallocating drops the old contents, so every slot is written again below
+            selectionSlotCapacity = std::max(16, *slot * 2);
+            glBufferData(GL_TEXTURE_BUFFER, selectionSlotCapacity * SELECTION_SLOT_WORDS * sizeof(uint32_t), nullptr, GL_DYNAMIC_DRAW);
+            glBindTexture(GL_TEXTURE_BUFFER, selectionTexture);
+            glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, selectionBuffer);
+            grown = true;
+        }
+        if (!grown) {
+            uploadSelectionSlot(voxelWorld, chunkPos, *slot);
+        }
+    }
+    if (grown) {
+        for (const auto& entry : selectionSlots) {
+            uploadSelectionSlot(voxelWorld, entry.first, entry.second);
+        }
+    }
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_BUFFER, selectionTexture);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void deleteSelectionOverlay() {
+    glDeleteTextures(1, &selectionTexture);
+    glDeleteBuffers(1, &selectionBuffer);
+    selectionTexture = 0;
+    selectionBuffer = 0;
+    selectionSlotCapacity = 0;
+    selectionSlots.clear();
+    freeSelectionSlots.clear();
+}
+
+// Material colours for the vertex shader, one RGBA texel per MaterialId, re-uploaded when the registry grows
+GLuint materialPaletteBuffer = 0;
+GLuint materialPaletteTexture = 0;
+size_t materialPaletteSize = 0;
+
+void updateMaterialPalette() {
+    MaterialRegistry& registry = MaterialRegistry::global();
+    size_t materialCount = registry.size();
+    if (materialCount != materialPaletteSize) {
+        std::vector<glm::vec4> colors(materialCount);
+        for (size_t id = 0; id < materialCount; ++id) {
+            colors[id] = glm::vec4(registry.get(static_cast<MaterialId>(id)).color, 1.0f);
+        }
+        if (materialPaletteBuffer == 0) {
+            glGenBuffers(1, &materialPaletteBuffer);
+            glGenTextures(1, &materialPaletteTexture);
+        }
+        glBindBuffer(GL_TEXTURE_BUFFER, materialPaletteBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, colors.size() * sizeof(glm::vec4), colors.data(), GL_STATIC_DRAW);
+        glBindTexture(GL_TEXTURE_BUFFER, materialPaletteTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, materialPaletteBuffer);
+        materialPaletteSize = materialCount;
+    }
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_BUFFER, materialPaletteTexture);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void deleteMaterialPalette() {
+    glDeleteTextures(1, &materialPaletteTexture);
+    glDeleteBuffers(1, &materialPaletteBuffer);
+    materialPaletteTexture = 0;
+    materialPaletteBuffer = 0;
+    materialPaletteSize = 0;
+}
+
+// Chunk vertices are relative to their chunk, so each draw passes the chunk's world origin
+void setChunkOrigin(GLuint chunkOriginLoc, const glm::ivec3& chunkPos) {
+    glUniform3fv(chunkOriginLoc, 1, glm::value_ptr(glm::vec3(VoxelChunk::chunkOrigin(chunkPos))));
 }
 
-void mainRenderLoop(GLFWwindow* window, VoxelWorld& voxelWorld, GLuint shaderProgram, GLuint VAO, GLuint VBO, GLuint EBO, GLuint selectedVAO, GLuint selectedVBO, GLuint selectedEBO, GLuint unselectedVAO, GLuint unselectedVBO, GLuint unselectedEBO, GLuint mvpLoc, GLuint modelLoc, GLuint viewLoc, GLuint projectionLoc, GLuint lightPosLoc, GLuint viewPosLoc, GLuint useTextureLoc, GLuint objectColorLoc, glm::mat4& model, glm::mat4& projection, glm::vec3& lightPos, GLuint texture1) {
+// Level of detail for a chunk whose centre is distance away from the camera
+size_t chooseChunkLevel(float distance, size_t levelCount) {
+    size_t level = 0;
+    for (float limit = LOD_DISTANCE; distance >= limit && level + 1 < levelCount; limit *= 2.0f) {
+        ++level;
+    }
+    return level;
+}
+
+std::vector<glm::ivec3> visibleChunks; // Scratch for drawTexturedVoxels, kept to reuse its memory
+
+// Draws each chunk one texture range at a time, binding each material's texture.
+// Textures the renderer never loaded fall back to defaultTexture. Chunks with a
+// selection slot get their selected and highlighted voxels tinted by the shader.
+// Distant chunks draw one of their coarse levels; their border faces are built to
+// close the seam against neighbours at any level, so no matching is needed here.
+// Chunks outside the view frustum are skipped before any GL call is made for them.
+void drawTexturedVoxels(GLuint useTextureLoc, GLuint objectColorLoc, GLuint chunkOriginLoc, GLuint selectionSlotLoc, GLuint smoothMeshLoc, GLuint defaultTexture, const glm::vec3& viewPos, const glm::mat4& viewProjection) {
+    MaterialRegistry& registry = MaterialRegistry::global();
+    glUniform1i(useTextureLoc, 1);
+    glUniform3fv(objectColorLoc, 1, glm::value_ptr(glm::vec3(1.0f, 1.0f, 1.0f)));
+    glActiveTexture(GL_TEXTURE0);
+    GLuint bound = 0;
+    gpuBuffers.findVisible(Frustum::fromMatrix(viewProjection), visibleChunks);
+    for (const glm::ivec3& chunkPos : visibleChunks) {
+        const ChunkBuffers& buffers = *gpuBuffers.find(chunkPos);
+        if (buffers.indexCount == 0) {
+            continue;
+        }
+        setChunkOrigin(chunkOriginLoc, chunkPos);
+        const int* slot = selectionSlots.find(chunkPos);
+        glUniform1i(selectionSlotLoc, slot ? *slot : -1);
+        glUniform1i(smoothMeshLoc, buffers.smooth ? 1 : 0);
+        glm::vec3 center = glm::vec3(VoxelChunk::chunkOrigin(chunkPos)) + 0.5f * VoxelChunk::SIZE;
+        const ChunkLevel& level = buffers.levels[chooseChunkLevel(glm::distance(center, viewPos), buffers.levels.size())];
+        glBindVertexArray(buffers.VAO);
+        for (const TextureRange& range : level.textureRanges) {
+            GLuint handle = registry.getTextureHandle(range.texture);
+            if (handle == 0) {
+                handle = defaultTexture;
+            }
+            if (handle != bound) {
+                glBindTexture(GL_TEXTURE_2D, handle);
+                bound = handle;
+            }
+            glDrawElementsBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(range.indexCount), GL_UNSIGNED_INT, (void*)(range.firstIndex * sizeof(unsigned int)), level.baseVertex);
+        }
+    }
+}
+
+void mainRenderLoop(GLFWwindow* window, VoxelWorld& voxelWorld, GLuint shaderProgram, GLuint mvpLoc, GLuint modelLoc, GLuint viewLoc, GLuint projectionLoc, GLuint lightPosLoc, GLuint viewPosLoc, GLuint useTextureLoc, GLuint objectColorLoc, GLuint chunkOriginLoc, GLuint selectionSlotLoc, GLuint smoothMeshLoc, glm::mat4& model, glm::mat4& projection, glm::vec3& lightPos, GLuint texture1) {
     while (!glfwWindowShouldClose(window)) {
         // Calculate deltaTime
         float currentFrame = static_cast<float>(glfwGetTime());
@@ -100,9 +294,13 @@ void mainRenderLoop(GLFWwindow* window, VoxelWorld& voxelWorld, GLuint shaderPro
         lastFrame = currentFrame;
 
         view = camera.getViewMatrix();
-        projection = glm::perspective(glm::radians(camera.zoom), (float)windowWidth / (float)windowHeight, 0.1f, 100.0f);
+        projection = glm::perspective(glm::radians(camera.zoom), (float)windowWidth / (float)windowHeight, 0.1f, FAR_PLANE);
 
+        voxelWorld.swapMeshBuffers(); // Pick up whatever finished meshing since the last frame
         processInput(window, voxelWorld, projection, view);
+        uploadChunkMeshes(voxelWorld);
+        updateMaterialPalette();
+        updateSelectionOverlay(voxelWorld);
 
         glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -118,27 +316,17 @@ void mainRenderLoop(GLFWwindow* window, VoxelWorld& voxelWorld, GLuint shaderPro
         glUniform3fv(lightPosLoc, 1, glm::value_ptr(lightPos));
         glUniform3fv(viewPosLoc, 1, glm::value_ptr(camera.position));
 
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texture1);
-
-        // Draw unselected voxels
-        drawVoxels(unselectedVAO, unselectedVBO, unselectedEBO, voxelWorld.getUnselectedVertices(), voxelWorld.getUnselectedIndices(), useTextureLoc, objectColorLoc, glm::vec3(1.0f, 1.0f, 1.0f), true);
-
-        // Draw selected voxels
-        drawVoxels(selectedVAO, selectedVBO, selectedEBO, voxelWorld.getSelectedVertices(), voxelWorld.getSelectedIndices(), useTextureLoc, objectColorLoc, glm::vec3(1.0f, 0.0f, 0.0f), false);
-
-        // Draw highlighted voxels during drag
-        if (isDragging) {
-            drawVoxels(selectedVAO, selectedVBO, selectedEBO, voxelWorld.getSelectedVertices(), voxelWorld.getSelectedIndices(), useTextureLoc, objectColorLoc, glm::vec3(1.0f, 0.7f, 0.0f), false);
-        }
+        // Selected and highlighted voxels are tinted in the same pass
+        drawTexturedVoxels(useTextureLoc, objectColorLoc, chunkOriginLoc, selectionSlotLoc, smoothMeshLoc, texture1, camera.position, projection * view);
+        gpuBuffers.endFrame();
 
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
 
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &EBO);
+    gpuBuffers.destroy();
+    deleteMaterialPalette();
+    deleteSelectionOverlay();
     glDeleteProgram(shaderProgram);
 }
 
@@ -182,62 +370,15 @@ int main() {
     GLuint fragmentShader = compileShader(fragmentShaderSource.c_str(), GL_FRAGMENT_SHADER);
     GLuint shaderProgram = linkProgram(vertexShader, fragmentShader);
     
-    for (int x = -10; x <= 10; ++x) {
-       for (int y = 0; y <= 0; ++y) {
-          for (int z = -10; z <= 10; ++z) {
-                voxelWorld.setVoxel(x, y, z, 1, "blue", "default");
-          }
-       }
-    }
-
-    voxelWorld.generateMeshData();
-
-    GLuint VAO, selectedVAO, unselectedVAO;
-    GLuint VBO, selectedVBO, unselectedVBO;
-    GLuint EBO, selectedEBO, unselectedEBO;
-
-    glGenVertexArrays(1, &VAO);
-    glGenVertexArrays(1, &selectedVAO);
-    glGenVertexArrays(1, &unselectedVAO);
-
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &selectedVBO);
-    glGenBuffers(1, &unselectedVBO);
-
-    glGenBuffers(1, &EBO);
-    glGenBuffers(1, &selectedEBO);
-    glGenBuffers(1, &unselectedEBO);
-
-    // Setup unselected VAO
-    glBindVertexArray(unselectedVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, unselectedVBO);
-    glBufferData(GL_ARRAY_BUFFER, voxelWorld.getUnselectedVertices().size() * sizeof(Vertex), voxelWorld.getUnselectedVertices().data(), GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, unselectedEBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, voxelWorld.getUnselectedIndices().size() * sizeof(unsigned int), voxelWorld.getUnselectedIndices().data(), GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, x));
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, r));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, nx));
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, u));
-    glEnableVertexAttribArray(3);
-
-    // Setup selected VAO
-    glBindVertexArray(selectedVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, selectedVBO);
-    glBufferData(GL_ARRAY_BUFFER, voxelWorld.getSelectedVertices().size() * sizeof(Vertex), voxelWorld.getSelectedVertices().data(), GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, selectedEBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, voxelWorld.getSelectedIndices().size() * sizeof(unsigned int), voxelWorld.getSelectedIndices().data(), GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, x));
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, r));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, nx));
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, u));
-    glEnableVertexAttribArray(3);
-
+    voxelWorld.setMeshingMode(MESH_GREEDY); // Merged quads; the 21x21 floor becomes one quad per side
+    voxelWorld.setLodLevels(ChunkMesher::MAX_LOD_LEVELS); // Far chunks draw 2x, 4x or 8x coarser
+    voxelWorld.setAsyncMeshing(true); // Edits return at once; the render loop swaps finished meshes in
+    voxelWorld.getMeshCache().setDirectory("mesh_cache"); // Chunks saved by the last run are loaded instead of meshed
+    MaterialId floorMaterial = MaterialRegistry::global().getMaterial(1, MaterialRegistry::colorFromName("blue"), "default");
+    voxelWorld.fillBox(glm::ivec3(-10, 0, -10), glm::ivec3(10, 0, 10), floorMaterial); // Meshed in the background, shows up within a frame or two
+
+    // Chunk meshes get their own buffers on the first frame, see uploadChunkMeshes
+    gpuBuffers.create();
     glEnable(GL_DEPTH_TEST);
 
     GLuint mvpLoc = glGetUniformLocation(shaderProgram, "MVP");
@@ -250,16 +391,26 @@ int main() {
     GLuint objectColorLoc = glGetUniformLocation(shaderProgram, "objectColor");
 
     glm::mat4 model = glm::mat4(1.0f);
-    projection = glm::perspective(glm::radians(camera.zoom), 800.0f / 600.0f, 0.1f, 100.0f);
+    projection = glm::perspective(glm::radians(camera.zoom), 800.0f / 600.0f, 0.1f, FAR_PLANE);
     
     glm::vec3 lightPos = glm::vec3(2.0f, 15.0f, 5.0f); // Moved up to lighten up the scene
 
     GLuint texture1 = voxelWorld.loadTexture("./textures/wood.jpg");
+    MaterialRegistry::global().setTextureHandle(MaterialRegistry::global().getTexture("default"), texture1);
     glUseProgram(shaderProgram);
     glUniform1i(glGetUniformLocation(shaderProgram, "texture1"), 0);
+    glUniform1i(glGetUniformLocation(shaderProgram, "materialColors"), 1);
+    glUniform1i(glGetUniformLocation(shaderProgram, "selectionBits"), 2);
+    GLuint chunkOriginLoc = glGetUniformLocation(shaderProgram, "chunkOrigin");
+    GLuint selectionSlotLoc = glGetUniformLocation(shaderProgram, "selectionSlot");
+    GLuint smoothMeshLoc = glGetUniformLocation(shaderProgram, "smoothMesh");
 
     // Main render loop
-    mainRenderLoop(window, voxelWorld, shaderProgram, VAO, VBO, EBO, selectedVAO, selectedVBO, selectedEBO, unselectedVAO, unselectedVBO, unselectedEBO, mvpLoc, modelLoc, viewLoc, projectionLoc, lightPosLoc, viewPosLoc, useTextureLoc, objectColorLoc, model, projection, lightPos, texture1);
+    mainRenderLoop(window, voxelWorld, shaderProgram, mvpLoc, modelLoc, viewLoc, projectionLoc, lightPosLoc, viewPosLoc, useTextureLoc, objectColorLoc, chunkOriginLoc, selectionSlotLoc, smoothMeshLoc, model, projection, lightPos, texture1);
+    // A background batch may still be meshing: let it finish and swap in, so the meshes saved
+    // are final and no job outlives main
+    voxelWorld.waitForMeshing();
+    voxelWorld.saveMeshCache();
 
     glfwTerminate();
     return 0;
@@ -326,7 +477,7 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
 
                 if (voxelWorld.isVoxelSelected(hitVoxel)) {
                     std::vector<glm::ivec3> selectedVoxels = selectionManager.getSelectedVoxels();
-                    std::unordered_set<glm::ivec3> selectedVoxelSet(selectedVoxels.begin(), selectedVoxels.end());
+                    VoxelHashSet selectedVoxelSet(selectedVoxels.begin(), selectedVoxels.end());
                     extrusionManager.setSelectedVoxels(selectedVoxelSet);
                     extrusionManager.startExtrusion(hitVoxel, hitNormal, hitFace, initialMousePos);
                 } else {
@@ -422,6 +573,13 @@ void processInput(GLFWwindow* window, VoxelWorld& voxelWorld, glm::mat4 projecti
      if (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS) {
         logCameraState(camera); // Log camera state when 'L' key is pressed
     }
+
+    // M cycles the meshing mode: faces, greedy, smooth
+    bool meshModeKey = glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS;
+    if (meshModeKey && !meshModeKeyDown) {
+        voxelWorld.setMeshingMode(static_cast<MeshingMode>((voxelWorld.getMeshingMode() + 1) % 3));
+    }
+    meshModeKeyDown = meshModeKey;
     
     // Check for extrusion keys
     if (glfwGetKey(window, GLFW_KEY_1) == GLFW_PRESS) {
@@ -475,10 +633,12 @@ void processInput(GLFWwindow* window, VoxelWorld& voxelWorld, glm::mat4 projecti
     FaceDirection hitFace; // Add this line to declare hitFace
     if (voxelWorld.raycast(rayOrigin, rayWorld, hitVoxel, hitNormal, hitFace)) { // Update this line to match the new signature
         if (!voxelHovered || hitVoxel != lastHoveredVoxel) {
+            voxelWorld.beginEdit(); // Moving the hover publishes once, not twice
             if (voxelHovered) {
                 voxelWorld.resetHighlight(lastHoveredVoxel);
             }
             voxelWorld.highlightVoxel(hitVoxel);
+            voxelWorld.commitEdit();
             lastHoveredVoxel = hitVoxel;
             voxelHovered = true;
         }
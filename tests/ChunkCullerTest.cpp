@@ -0,0 +1,202 @@
+// Compares ChunkCuller's four-at-a-time cull against the plain one box, one plane
+// test, for box counts that leave the last group of four part empty, boxes that
+// straddle or just touch a plane, and boxes removed from the middle while a list of
+// chunks is kept in step with the box indices, the way GpuBufferManager does.
+#include <iostream>
+#include <vector>
+#include <string>
+#include <random>
+#include <cmath>
+#include <algorithm>
+#include <tuple>
+#include <glm/gtc/matrix_transform.hpp>
+#include "ChunkCuller.h"
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cout << "FAILED: " << what << std::endl;
+        ++failures;
+    }
+}
+
+struct Box {
+    glm::vec3 boxMin;
+    glm::vec3 boxMax;
+};
+
+// The scalar test, written out on its own: outside when wholly behind any one plane
+static bool insideFrustum(const Frustum& frustum, const Box& box) {
+    glm::vec3 center = 0.5f * (box.boxMin + box.boxMax);
+    glm::vec3 extent = 0.5f * (box.boxMax - box.boxMin);
+    for (const glm::vec4& plane : frustum.planes) {
+        float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+        float reach = std::fabs(plane.x) * extent.x + std::fabs(plane.y) * extent.y + std::fabs(plane.z) * extent.z;
+        if (distance + reach < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static std::vector<uint32_t> expectedVisible(const Frustum& frustum, const std::vector<Box>& boxes) {
+    std::vector<uint32_t> visible;
+    for (size_t i = 0; i < boxes.size(); ++i) {
+        if (insideFrustum(frustum, boxes[i])) {
+            visible.push_back(static_cast<uint32_t>(i));
+        }
+    }
+    return visible;
+}
+
+// Axis-aligned box [low, high] as a frustum, so which boxes cross its planes is known exactly
+static Frustum boxFrustum(const glm::vec3& low, const glm::vec3& high) {
+    Frustum frustum;
+    frustum.planes[0] = glm::vec4(1, 0, 0, -low.x);
+    frustum.planes[1] = glm::vec4(-1, 0, 0, high.x);
+    frustum.planes[2] = glm::vec4(0, 1, 0, -low.y);
+    frustum.planes[3] = glm::vec4(0, -1, 0, high.y);
+    frustum.planes[4] = glm::vec4(0, 0, 1, -low.z);
+    frustum.planes[5] = glm::vec4(0, 0, -1, high.z);
+    return frustum;
+}
+
+static Frustum cameraFrustum(const glm::vec3& eye, const glm::vec3& target) {
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 400.0f);
+    glm::mat4 view = glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f));
+    return Frustum::fromMatrix(projection * view);
+}
+
+static Box chunkBox(const glm::ivec3& chunkPos) {
+    // Bounds as GpuBufferManager adds them: the chunk plus one voxel of margin
+    glm::vec3 origin(chunkPos * 32);
+    return { origin - 1.0f, origin + 33.0f };
+}
+
+static void testStraddlingBoxes() {
+    Frustum frustum = boxFrustum(glm::vec3(0.0f), glm::vec3(10.0f));
+    std::vector<Box> boxes = {
+        { glm::vec3(2.0f), glm::vec3(3.0f) },                                  // Inside
+        { glm::vec3(-1.0f, 2.0f, 2.0f), glm::vec3(1.0f, 3.0f, 3.0f) },         // Straddles x = 0
+        { glm::vec3(9.0f, 9.0f, 9.0f), glm::vec3(12.0f, 12.0f, 12.0f) },       // Straddles three far planes
+        { glm::vec3(-3.0f, 2.0f, 2.0f), glm::vec3(0.0f, 3.0f, 3.0f) },         // Touches x = 0 from outside
+        { glm::vec3(-3.0f, 2.0f, 2.0f), glm::vec3(-0.5f, 3.0f, 3.0f) },        // Just outside x = 0
+        { glm::vec3(2.0f, 10.5f, 2.0f), glm::vec3(3.0f, 11.0f, 3.0f) },        // Just outside y = 10
+        { glm::vec3(-5.0f), glm::vec3(15.0f) },                                // Contains the frustum
+    };
+    const bool inside[7] = { true, true, true, true, false, false, true };
+    ChunkCuller culler;
+    for (const Box& box : boxes) {
+        culler.add(box.boxMin, box.boxMax);
+    }
+    std::vector<uint32_t> visible;
+    culler.cull(frustum, visible);
+    for (size_t i = 0; i < boxes.size(); ++i) {
+        bool found = std::find(visible.begin(), visible.end(), static_cast<uint32_t>(i)) != visible.end();
+        check(found == inside[i], "box " + std::to_string(i) + (inside[i] ? " should be visible" : " should be culled"));
+    }
+    check(visible == expectedVisible(frustum, boxes), "straddling boxes: culler and scalar test disagree");
+}
+
+static void testCounts() {
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> position(-200.0f, 200.0f);
+    std::uniform_real_distribution<float> size(0.5f, 40.0f);
+    const Frustum frustums[3] = {
+        cameraFrustum(glm::vec3(0.0f, 20.0f, 0.0f), glm::vec3(100.0f, 0.0f, 50.0f)),
+        cameraFrustum(glm::vec3(-150.0f, 80.0f, 150.0f), glm::vec3(0.0f)),
+        boxFrustum(glm::vec3(-50.0f), glm::vec3(30.0f, 60.0f, 10.0f))
+    };
+    // Every count up to a few groups of four, so each possible partly filled last group is hit
+    for (size_t count = 0; count <= 19; ++count) {
+        std::vector<Box> boxes;
+        ChunkCuller culler;
+        for (size_t i = 0; i < count; ++i) {
+            glm::vec3 low(position(random), position(random), position(random));
+            Box box = { low, low + glm::vec3(size(random), size(random), size(random)) };
+            boxes.push_back(box);
+            check(culler.add(box.boxMin, box.boxMax) == i, "add should number boxes in order");
+        }
+        check(culler.size() == count, "culler should hold " + std::to_string(count) + " boxes");
+        for (const Frustum& frustum : frustums) {
+            std::vector<uint32_t> visible;
+            culler.cull(frustum, visible);
+            check(visible == expectedVisible(frustum, boxes), std::to_string(count) + " boxes: culler and scalar test disagree");
+        }
+    }
+}
+
+// Chunks come and go in random order while a list of chunks follows the box indices
+static void testRemoveFromMiddle() {
+    std::mt19937 random(11);
+    ChunkCuller culler;
+    std::vector<glm::ivec3> boxChunks;
+    std::vector<glm::ivec3> live;
+    const Frustum frustum = cameraFrustum(glm::vec3(16.0f, 40.0f, 16.0f), glm::vec3(200.0f, 0.0f, 120.0f));
+    const Frustum everything = boxFrustum(glm::vec3(-1e4f), glm::vec3(1e4f));
+    for (int step = 0; step < 2000; ++step) {
+        bool adding = live.empty() || random() % 5 < 3;
+        if (adding) {
+            glm::ivec3 chunkPos(static_cast<int>(random() % 16) - 4, static_cast<int>(random() % 3), static_cast<int>(random() % 16) - 4);
+            if (std::find(live.begin(), live.end(), chunkPos) != live.end()) {
+                continue;
+            }
+            Box box = chunkBox(chunkPos);
+            check(culler.add(box.boxMin, box.boxMax) == boxChunks.size(), "new box should go after the others");
+            boxChunks.push_back(chunkPos);
+            live.push_back(chunkPos);
+        } else {
+            glm::ivec3 chunkPos = live[random() % live.size()];
+            live.erase(std::find(live.begin(), live.end(), chunkPos));
+            // As GpuBufferManager::release does: the last box moves into the freed slot
+            size_t box = std::find(boxChunks.begin(), boxChunks.end(), chunkPos) - boxChunks.begin();
+            culler.remove(box);
+            boxChunks[box] = boxChunks.back();
+            boxChunks.pop_back();
+        }
+        check(culler.size() == live.size(), "culler size should follow adds and removes");
+
+        std::vector<Box> boxes;
+        for (const glm::ivec3& chunkPos : boxChunks) {
+            boxes.push_back(chunkBox(chunkPos));
+        }
+        std::vector<uint32_t> visible;
+        culler.cull(frustum, visible);
+        if (visible != expectedVisible(frustum, boxes)) {
+            check(false, "step " + std::to_string(step) + ": a box no longer matches the chunk at its index");
+            return;
+        }
+        culler.cull(everything, visible);
+        std::vector<glm::ivec3> seen;
+        for (uint32_t index : visible) {
+            seen.push_back(boxChunks[index]);
+        }
+        auto order = [](const glm::ivec3& a, const glm::ivec3& b) { return std::tie(a.x, a.y, a.z) < std::tie(b.x, b.y, b.z); };
+        std::vector<glm::ivec3> expected = live;
+        std::sort(seen.begin(), seen.end(), order);
+        std::sort(expected.begin(), expected.end(), order);
+        if (seen != expected) {
+            check(false, "step " + std::to_string(step) + ": removed chunk still drawn or live chunk lost");
+            return;
+        }
+    }
+
+    culler.clear();
+    std::vector<uint32_t> visible(3, 0);
+    culler.cull(everything, visible);
+    check(culler.size() == 0 && visible.empty(), "cleared culler should find nothing");
+}
+
+int main() {
+    testStraddlingBoxes();
+    testCounts();
+    testRemoveFromMiddle();
+
+    if (failures == 0) {
+        std::cout << "All chunk culler tests passed" << std::endl;
+        return 0;
+    }
+    std::cout << failures << " chunk culler tests failed" << std::endl;
+    return 1;
+}
@@ -0,0 +1,697 @@
+// Meshes chunks of known shape and checks what ChunkMesher emits: every meshing mode and
+// level of detail has to show exactly the faces between filled and empty voxels, whatever it merges.
+#include <iostream>
+#include <vector>
+#include <string>
+#include <random>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <tuple>
+#include <cmath>
+#include "ChunkMesher.h"
+#include "ChunkedVoxelStorage.h"
+#include "MaterialRegistry.h"
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cout << "FAILED: " << what << std::endl;
+        ++failures;
+    }
+}
+
+// The mesher's face numbering, +z, -z, -x, +x, +y, -y, as {normal, u, v, side}
+static const int faceAxes[6][4] = {
+    { 2, 0, 1, 1 }, { 2, 0, 1, 0 },
+    { 0, 2, 1, 0 }, { 0, 2, 1, 1 },
+    { 1, 0, 2, 1 }, { 1, 0, 2, 0 }
+};
+
+// One voxel face: which voxel, facing where, in what material and with which corner shading
+struct UnitFace {
+    glm::ivec3 voxel;
+    int face;
+    MaterialId material;
+    uint32_t occlusion; // Corner ao, 2 bits each in PackedVertex corner order
+
+    bool operator<(const UnitFace& other) const {
+        if (face != other.face) return face < other.face;
+        if (voxel.z != other.voxel.z) return voxel.z < other.voxel.z;
+        if (voxel.y != other.voxel.y) return voxel.y < other.voxel.y;
+        if (voxel.x != other.voxel.x) return voxel.x < other.voxel.x;
+        if (material != other.material) return material < other.material;
+        return occlusion < other.occlusion;
+    }
+    bool operator==(const UnitFace& other) const {
+        return voxel == other.voxel && face == other.face && material == other.material && occlusion == other.occlusion;
+    }
+};
+
+static glm::ivec3 cornerOf(const PackedVertex& vertex) {
+    return glm::ivec3(vertex.getX(), vertex.getY(), vertex.getZ());
+}
+
+static uint32_t quadOcclusion(const PackedVertex* corners) {
+    return corners[0].getAo() | corners[1].getAo() << 2 | corners[2].getAo() << 4 | corners[3].getAo() << 6;
+}
+
+// Splits every quad of a cube mesh back into the voxel faces it covers, scale voxels per
+// step. A merged quad only ever covers faces that shade alike, so each gets the quad's shading.
+static std::vector<UnitFace> unitFaces(const ChunkMesh& mesh, int scale = 1) {
+    std::vector<UnitFace> faces;
+    for (size_t quad = 0; quad * 4 < mesh.vertices.size(); ++quad) {
+        const PackedVertex* corners = &mesh.vertices[quad * 4];
+        int face = static_cast<int>(corners[0].getFace());
+        const int* axes = faceAxes[face];
+        glm::ivec3 low = cornerOf(corners[0]);
+        glm::ivec3 high = cornerOf(corners[2]);
+        for (int v = low[axes[2]]; v < high[axes[2]]; v += scale) {
+            for (int u = low[axes[1]]; u < high[axes[1]]; u += scale) {
+                UnitFace unit;
+                unit.voxel[axes[0]] = low[axes[0]] - (axes[3] ? scale : 0);
+                unit.voxel[axes[1]] = u;
+                unit.voxel[axes[2]] = v;
+                unit.face = face;
+                unit.material = static_cast<MaterialId>(corners[0].material & 0xFFFF);
+                unit.occlusion = quadOcclusion(corners);
+                faces.push_back(unit);
+            }
+        }
+    }
+    std::sort(faces.begin(), faces.end());
+    return faces;
+}
+
+static ChunkMesh meshOf(const VoxelStorage& storage, const glm::ivec3& chunkPos, MeshingMode mode, int lodLevels = 0) {
+    ChunkMesher mesher;
+    mesher.setMode(mode);
+    mesher.setLodLevels(lodLevels);
+    ChunkMesh mesh;
+    mesher.meshChunk(storage, chunkPos, mesh);
+    return mesh;
+}
+
+struct Scene {
+    std::string name;
+    std::function<void(ChunkedVoxelStorage&)> fill;
+};
+
+// Shapes for chunk (0, 0, 0); most reach into the one voxel border the mesher culls against
+static std::vector<Scene> scenes(MaterialId stone, MaterialId grass) {
+    std::vector<Scene> list;
+    list.push_back({ "noise", [=](ChunkedVoxelStorage& storage) {
+        std::mt19937 random(5);
+        for (int z = -1; z <= 32; ++z) {
+            for (int y = -1; y <= 32; ++y) {
+                for (int x = -1; x <= 32; ++x) {
+                    if (random() % 5 < 2) {
+                        storage.setVoxel(glm::ivec3(x, y, z), random() % 3 ? stone : grass);
+                    }
+                }
+            }
+        }
+    } });
+    list.push_back({ "hill", [=](ChunkedVoxelStorage& storage) {
+        for (int x = -1; x <= 32; ++x) {
+            for (int z = -1; z <= 32; ++z) {
+                int height = 6 + (x * 5 + z * 3) % 17;
+                for (int y = -1; y < height; ++y) {
+                    storage.setVoxel(glm::ivec3(x, y, z), y == height - 1 ? grass : stone);
+                }
+            }
+        }
+    } });
+    list.push_back({ "checkerboard", [=](ChunkedVoxelStorage& storage) {
+        for (int z = 0; z < 32; ++z) {
+            for (int y = 0; y < 32; ++y) {
+                for (int x = 0; x < 32; ++x) {
+                    if ((x + y + z) % 2 == 0) {
+                        storage.setVoxel(glm::ivec3(x, y, z), x < 16 ? stone : grass);
+                    }
+                }
+            }
+        }
+    } });
+    list.push_back({ "solid chunk with half a neighbour", [=](ChunkedVoxelStorage& storage) {
+        for (int z = 0; z < 32; ++z) {
+            for (int y = 0; y < 32; ++y) {
+                for (int x = 0; x < 33; ++x) {
+                    if (x < 32 || y < 16) {
+                        storage.setVoxel(glm::ivec3(x, y, z), (x + y + z) % 4 ? stone : grass);
+                    }
+                }
+            }
+        }
+    } });
+    list.push_back({ "single voxel", [=](ChunkedVoxelStorage& storage) {
+        storage.setVoxel(glm::ivec3(31, 0, 17), grass);
+    } });
+    return list;
+}
+
+static void testGreedyCoversSameFaces(const std::vector<Scene>& list) {
+    for (const Scene& scene : list) {
+        ChunkedVoxelStorage storage;
+        scene.fill(storage);
+        ChunkMesh faces = meshOf(storage, glm::ivec3(0), MESH_FACES);
+        ChunkMesh greedy = meshOf(storage, glm::ivec3(0), MESH_GREEDY);
+        std::vector<UnitFace> fromFaces = unitFaces(faces);
+        std::vector<UnitFace> fromGreedy = unitFaces(greedy);
+        check(!fromFaces.empty(), scene.name + ": mesh should not be empty");
+        check(fromFaces.size() * 4 == faces.vertices.size(), scene.name + ": MESH_FACES should emit single voxel quads");
+        check(fromGreedy == fromFaces, scene.name + ": MESH_GREEDY does not cover the faces MESH_FACES shows");
+        check(greedy.vertices.size() <= faces.vertices.size(), scene.name + ": MESH_GREEDY should never need more quads");
+        check(greedy.indices.size() * 4 == greedy.vertices.size() * 6, scene.name + ": every greedy quad needs six indices");
+    }
+}
+
+// Exposed faces found one voxel and one neighbour at a time, straight from the storage
+static std::vector<UnitFace> referenceFaces(const VoxelStorage& storage) {
+    static const glm::ivec3 normals[6] = {
+        glm::ivec3(0, 0, 1), glm::ivec3(0, 0, -1), glm::ivec3(-1, 0, 0),
+        glm::ivec3(1, 0, 0), glm::ivec3(0, 1, 0), glm::ivec3(0, -1, 0)
+    };
+    std::vector<UnitFace> faces;
+    for (int z = 0; z < 32; ++z) {
+        for (int y = 0; y < 32; ++y) {
+            for (int x = 0; x < 32; ++x) {
+                glm::ivec3 voxel(x, y, z);
+                MaterialId material = storage.getVoxel(voxel);
+                if (material == MaterialRegistry::NONE) {
+                    continue;
+                }
+                for (int face = 0; face < 6; ++face) {
+                    if (!storage.hasVoxel(voxel + normals[face])) {
+                        faces.push_back({ voxel, face, material, 0 });
+                    }
+                }
+            }
+        }
+    }
+    std::sort(faces.begin(), faces.end());
+    return faces;
+}
+
+static std::vector<UnitFace> withoutShading(std::vector<UnitFace> faces) {
+    for (UnitFace& face : faces) {
+        face.occlusion = 0;
+    }
+    std::sort(faces.begin(), faces.end());
+    return faces;
+}
+
+// The bit column kernel runs as AVX2 or SSE2 depending on how the mesher was compiled (the
+// build adds an AVX2 copy of this test where the machine runs it); either way its faces have
+// to match the plain neighbour test, border columns and full columns included
+static void testCullingMatchesScalar(const std::vector<Scene>& list) {
+    for (const Scene& scene : list) {
+        ChunkedVoxelStorage storage;
+        scene.fill(storage);
+        std::vector<UnitFace> expected = referenceFaces(storage);
+        ChunkMesh faces = meshOf(storage, glm::ivec3(0), MESH_FACES);
+        ChunkMesh smooth = meshOf(storage, glm::ivec3(0), MESH_SMOOTH);
+        check(withoutShading(unitFaces(faces)) == expected, scene.name + ": culled faces differ from the neighbour test");
+        check(smooth.indices.size() == expected.size() * 6, scene.name + ": MESH_SMOOTH should emit one quad per exposed face");
+    }
+
+    // Single columns along each axis, filled end to end or with gaps, across the chunk edges
+    MaterialRegistry& registry = MaterialRegistry::global();
+    MaterialId stone = registry.getMaterial(1, glm::vec3(0.5f, 0.5f, 0.5f), "default");
+    for (int axis = 0; axis < 3; ++axis) {
+        for (int pattern = 0; pattern < 4; ++pattern) {
+            ChunkedVoxelStorage storage;
+            for (int i = -1; i <= 32; ++i) {
+                bool filled = pattern == 0 || (pattern == 1 && i % 3 != 0) || (pattern == 2 && (i < 0 || i > 31)) || (pattern == 3 && (i == 0 || i == 31));
+                if (filled) {
+                    glm::ivec3 voxel(7, 19, 30);
+                    voxel[axis] = i;
+                    storage.setVoxel(voxel, stone);
+                }
+            }
+            std::vector<UnitFace> expected = referenceFaces(storage);
+            check(withoutShading(unitFaces(meshOf(storage, glm::ivec3(0), MESH_FACES))) == expected,
+                  "column along axis " + std::to_string(axis) + ", pattern " + std::to_string(pattern) + ": culled faces differ from the neighbour test");
+        }
+    }
+}
+
+// Corner shading worked out from the storage: each corner of a face darkens for the two
+// voxels beside it and the one diagonal to it in the layer in front, fully when both sides are filled
+static uint32_t referenceOcclusion(const VoxelStorage& storage, const glm::ivec3& voxel, int face) {
+    const int* axes = faceAxes[face];
+    glm::ivec3 front = voxel;
+    front[axes[0]] += axes[3] ? 1 : -1;
+    glm::ivec3 u(0);
+    glm::ivec3 v(0);
+    u[axes[1]] = 1;
+    v[axes[2]] = 1;
+    const int uSign[4] = { -1, 1, 1, -1 };
+    const int vSign[4] = { -1, -1, 1, 1 };
+    uint32_t occlusion = 0;
+    for (int corner = 0; corner < 4; ++corner) {
+        uint32_t a = storage.hasVoxel(front + uSign[corner] * u);
+        uint32_t b = storage.hasVoxel(front + vSign[corner] * v);
+        uint32_t diagonal = storage.hasVoxel(front + uSign[corner] * u + vSign[corner] * v);
+        occlusion |= (a && b ? 3 : a + b + diagonal) << (2 * corner);
+    }
+    return occlusion;
+}
+
+static void testOcclusionMatchesReference(const std::vector<Scene>& list) {
+    for (const Scene& scene : list) {
+        ChunkedVoxelStorage storage;
+        scene.fill(storage);
+        std::vector<UnitFace> expected = referenceFaces(storage);
+        for (UnitFace& face : expected) {
+            face.occlusion = referenceOcclusion(storage, face.voxel, face.face);
+        }
+        std::sort(expected.begin(), expected.end());
+        check(unitFaces(meshOf(storage, glm::ivec3(0), MESH_FACES)) == expected, scene.name + ": corner shading differs from the reference");
+    }
+}
+
+// The top face of one voxel with a few neighbours placed around the layer above it.
+// ao lists the expected shading of the face's corners at (x, z), (x + 1, z), (x + 1, z + 1)
+// and (x, z + 1); the quad has to be split along the diagonal through its lighter pair.
+static void checkTopCorner(const std::string& name, const std::vector<glm::ivec3>& neighbours, const uint32_t (&ao)[4]) {
+    MaterialRegistry& registry = MaterialRegistry::global();
+    MaterialId stone = registry.getMaterial(1, glm::vec3(0.5f, 0.5f, 0.5f), "default");
+    const glm::ivec3 voxel(5, 5, 5);
+    ChunkedVoxelStorage storage;
+    storage.setVoxel(voxel, stone);
+    for (const glm::ivec3& offset : neighbours) {
+        storage.setVoxel(voxel + glm::ivec3(offset.x, 1, offset.z), stone);
+    }
+    ChunkMesh mesh = meshOf(storage, glm::ivec3(0), MESH_FACES);
+
+    auto quads = mesh.findVoxelQuads(VoxelChunk::localIndex(voxel.x, voxel.y, voxel.z));
+    const VoxelQuad* top = std::find_if(quads.first, quads.second, [&](const VoxelQuad& entry) { return mesh.vertices[entry.quad * 4].getFace() == 4; });
+    if (top == quads.second) {
+        check(false, name + ": top face missing");
+        return;
+    }
+    const glm::ivec3 cornerAt[4] = { glm::ivec3(5, 6, 5), glm::ivec3(6, 6, 5), glm::ivec3(6, 6, 6), glm::ivec3(5, 6, 6) };
+    uint32_t vertexAt[4] = {};
+    for (uint32_t vertex = top->quad * 4; vertex < top->quad * 4 + 4; ++vertex) {
+        glm::ivec3 corner = cornerOf(mesh.vertices[vertex]);
+        for (int i = 0; i < 4; ++i) {
+            if (corner == cornerAt[i]) {
+                vertexAt[i] = vertex;
+                check(mesh.vertices[vertex].getAo() == ao[i], name + ": corner " + std::to_string(i) + " has ao " + std::to_string(mesh.vertices[vertex].getAo()) + ", expected " + std::to_string(ao[i]));
+            }
+        }
+    }
+
+    // The two triangles of the quad share its diagonal
+    const unsigned int* triangles = nullptr;
+    for (size_t i = 0; i + 6 <= mesh.indices.size(); i += 6) {
+        if (mesh.indices[i] / 4 == top->quad) {
+            triangles = &mesh.indices[i];
+        }
+    }
+    if (!triangles) {
+        check(false, name + ": top face has no triangles");
+        return;
+    }
+    std::vector<unsigned int> first(triangles, triangles + 3);
+    std::vector<unsigned int> second(triangles + 3, triangles + 6);
+    std::sort(first.begin(), first.end());
+    std::sort(second.begin(), second.end());
+    std::vector<unsigned int> diagonal;
+    std::set_intersection(first.begin(), first.end(), second.begin(), second.end(), std::back_inserter(diagonal));
+    bool splitAcross02 = ao[0] + ao[2] <= ao[1] + ao[3];
+    std::vector<unsigned int> expected = splitAcross02 ? std::vector<unsigned int>{ vertexAt[0], vertexAt[2] } : std::vector<unsigned int>{ vertexAt[1], vertexAt[3] };
+    std::sort(expected.begin(), expected.end());
+    check(diagonal == expected, name + ": quad should be split along its lighter diagonal");
+}
+
+static void testCornerOcclusion() {
+    checkTopCorner("open", {}, { 0, 0, 0, 0 });
+    checkTopCorner("one side", { glm::ivec3(1, 0, 0) }, { 0, 1, 1, 0 });
+    checkTopCorner("diagonal at +x +z", { glm::ivec3(1, 0, 1) }, { 0, 0, 1, 0 });
+    checkTopCorner("diagonal at -x +z", { glm::ivec3(-1, 0, 1) }, { 0, 0, 0, 1 });
+    checkTopCorner("side and diagonal", { glm::ivec3(1, 0, 0), glm::ivec3(1, 0, 1) }, { 0, 1, 2, 0 });
+    checkTopCorner("inner corner", { glm::ivec3(-1, 0, 0), glm::ivec3(0, 0, -1) }, { 3, 1, 0, 1 });
+    checkTopCorner("three sides", { glm::ivec3(-1, 0, 0), glm::ivec3(1, 0, 0), glm::ivec3(0, 0, 1) }, { 1, 1, 3, 3 });
+    checkTopCorner("surrounded", { glm::ivec3(-1, 0, -1), glm::ivec3(0, 0, -1), glm::ivec3(1, 0, -1), glm::ivec3(-1, 0, 0),
+                                   glm::ivec3(1, 0, 0), glm::ivec3(-1, 0, 1), glm::ivec3(0, 0, 1), glm::ivec3(1, 0, 1) }, { 3, 3, 3, 3 });
+}
+
+// Smooth vertex position in 1/16 voxel, world space with voxel corners on whole voxels the way the
+// vertex shader places it: the packed position counts from the centre of the voxel below the chunk origin
+static glm::ivec3 smoothPosition(const PackedVertex& vertex, const glm::ivec3& chunkPos) {
+    glm::ivec3 local(vertex.position & 1023, (vertex.position >> 10) & 1023, (vertex.position >> 20) & 1023);
+    return local - 8 + chunkPos * 32 * 16;
+}
+
+// The vertex shader's octahedral decode
+static glm::vec3 smoothNormal(const PackedVertex& vertex) {
+    glm::vec2 oct(static_cast<float>((vertex.material >> 16) & 255), static_cast<float>(vertex.material >> 24));
+    oct = oct / 255.0f * 2.0f - 1.0f;
+    glm::vec3 normal(oct.x, oct.y, 1.0f - std::abs(oct.x) - std::abs(oct.y));
+    if (normal.z < 0.0f) {
+        glm::vec2 sign(oct.x >= 0.0f ? 1.0f : -1.0f, oct.y >= 0.0f ? 1.0f : -1.0f);
+        normal.x = (1.0f - std::abs(oct.y)) * sign.x;
+        normal.y = (1.0f - std::abs(oct.x)) * sign.y;
+    }
+    return glm::normalize(normal);
+}
+
+// True if every edge is shared by exactly two triangles. The renderer draws both sides, so
+// triangles are wound by their face's u and v axes rather than outwards, and only closure is checked.
+static bool closedSurface(const std::vector<unsigned int>& indices) {
+    std::vector<std::pair<unsigned int, unsigned int>> edges;
+    for (size_t i = 0; i + 3 <= indices.size(); i += 3) {
+        for (int corner = 0; corner < 3; ++corner) {
+            unsigned int a = indices[i + corner];
+            unsigned int b = indices[i + (corner + 1) % 3];
+            edges.emplace_back(std::min(a, b), std::max(a, b));
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    for (size_t i = 0; i < edges.size(); i += 2) {
+        if (i + 1 >= edges.size() || edges[i] != edges[i + 1] || (i + 2 < edges.size() && edges[i + 2] == edges[i])) {
+            return false;
+        }
+    }
+    return !edges.empty();
+}
+
+static void testSmoothSingleVoxel() {
+    MaterialRegistry& registry = MaterialRegistry::global();
+    MaterialId grass = registry.getMaterial(1, glm::vec3(0.2f, 0.8f, 0.2f), "grass");
+    const glm::ivec3 voxel(10, 20, 31);
+    ChunkedVoxelStorage storage;
+    storage.setVoxel(voxel, grass);
+    ChunkMesh mesh = meshOf(storage, glm::ivec3(0), MESH_SMOOTH);
+    check(mesh.smooth, "smooth mesh should be flagged as such");
+    check(mesh.vertices.size() == 8 && mesh.indices.size() == 36, "single voxel should give the 8 cells around it, two triangles per face");
+    check(closedSurface(mesh.indices), "single voxel should give a closed surface");
+
+    // Each of the 8 cells has only the voxel filled, so its vertex is the mean of the three
+    // crossing edge midpoints: 5/6 of the way towards the voxel centre on every axis
+    glm::vec3 centre = (glm::vec3(voxel) + 0.5f) * 16.0f;
+    std::vector<glm::ivec3> expected;
+    for (int corner = 0; corner < 8; ++corner) {
+        glm::ivec3 cell = voxel - glm::ivec3(corner & 1, corner >> 1 & 1, corner >> 2 & 1);
+        glm::ivec3 offset((corner & 1) ? 13 : 3, (corner >> 1 & 1) ? 13 : 3, (corner >> 2 & 1) ? 13 : 3);
+        expected.push_back(cell * 16 + 8 + offset);
+    }
+    std::vector<glm::ivec3> found;
+    for (const PackedVertex& vertex : mesh.vertices) {
+        glm::ivec3 position = smoothPosition(vertex, glm::ivec3(0));
+        found.push_back(position);
+        check((vertex.material & 0xFFFF) == grass, "smooth vertex should take the material of its filled corner");
+        check(glm::dot(smoothNormal(vertex), glm::vec3(position) - centre) > 0.0f, "smooth normal should point away from the voxel");
+    }
+    auto order = [](const glm::ivec3& a, const glm::ivec3& b) { return std::tie(a.x, a.y, a.z) < std::tie(b.x, b.y, b.z); };
+    std::sort(expected.begin(), expected.end(), order);
+    std::sort(found.begin(), found.end(), order);
+    check(found == expected, "single voxel cell vertices misplaced");
+}
+
+static void fillBall(VoxelStorage& storage, const glm::vec3& centre, float radius, MaterialId inner, MaterialId outer) {
+    glm::ivec3 low(glm::floor(centre - radius));
+    glm::ivec3 high(glm::ceil(centre + radius));
+    for (int z = low.z; z <= high.z; ++z) {
+        for (int y = low.y; y <= high.y; ++y) {
+            for (int x = low.x; x <= high.x; ++x) {
+                float distance = glm::length(glm::vec3(x, y, z) + 0.5f - centre);
+                if (distance <= radius) {
+                    storage.setVoxel(glm::ivec3(x, y, z), distance < radius - 2.0f ? inner : outer);
+                }
+            }
+        }
+    }
+}
+
+// Welds the smooth meshes of several chunks by world position, so the seams can be checked
+static void weldSmooth(const std::vector<std::pair<glm::ivec3, ChunkMesh>>& meshes, std::vector<unsigned int>& indices) {
+    std::vector<std::pair<glm::ivec3, uint32_t>> welded;
+    auto order = [](const std::pair<glm::ivec3, uint32_t>& a, const glm::ivec3& b) { return std::tie(a.first.x, a.first.y, a.first.z) < std::tie(b.x, b.y, b.z); };
+    for (const auto& chunk : meshes) {
+        std::vector<unsigned int> remap;
+        for (const PackedVertex& vertex : chunk.second.vertices) {
+            glm::ivec3 position = smoothPosition(vertex, chunk.first);
+            auto found = std::lower_bound(welded.begin(), welded.end(), position, order);
+            if (found == welded.end() || found->first != position) {
+                found = welded.insert(found, { position, static_cast<uint32_t>(welded.size()) });
+            }
+            remap.push_back(found->second);
+        }
+        for (unsigned int index : chunk.second.indices) {
+            indices.push_back(remap[index]);
+        }
+    }
+}
+
+static void testSmoothSurfaceIsClosed() {
+    MaterialRegistry& registry = MaterialRegistry::global();
+    MaterialId stone = registry.getMaterial(1, glm::vec3(0.5f, 0.5f, 0.5f), "default");
+    MaterialId grass = registry.getMaterial(1, glm::vec3(0.2f, 0.8f, 0.2f), "grass");
+
+    // Inside one chunk: closed, with every normal facing out of the ball
+    const glm::vec3 centre(15.0f, 16.5f, 17.2f);
+    ChunkedVoxelStorage storage;
+    fillBall(storage, centre, 9.3f, stone, grass);
+    ChunkMesh smooth = meshOf(storage, glm::ivec3(0), MESH_SMOOTH);
+    check(closedSurface(smooth.indices), "smooth ball should be a closed surface");
+    bool outwards = true;
+    bool outerMaterial = true;
+    for (const PackedVertex& vertex : smooth.vertices) {
+        glm::vec3 position = glm::vec3(smoothPosition(vertex, glm::ivec3(0))) / 16.0f;
+        outwards = outwards && glm::dot(smoothNormal(vertex), position - centre) > 0.0f;
+        outerMaterial = outerMaterial && (vertex.material & 0xFFFF) == grass;
+    }
+    check(outwards, "smooth ball normals should face out of the ball");
+    check(outerMaterial, "smooth ball surface should take the outer layer's material");
+
+    // Across the corner of eight chunks: each chunk places the vertices of its border cells
+    // from the padded block, so the welded meshes have to close up without cracks
+    ChunkedVoxelStorage seam;
+    fillBall(seam, glm::vec3(32.3f, 31.6f, 32.0f), 8.6f, stone, grass);
+    std::vector<std::pair<glm::ivec3, ChunkMesh>> meshes;
+    for (int corner = 0; corner < 8; ++corner) {
+        glm::ivec3 chunkPos(corner & 1, corner >> 1 & 1, corner >> 2 & 1);
+        meshes.emplace_back(chunkPos, meshOf(seam, chunkPos, MESH_SMOOTH));
+        check(!meshes.back().second.empty(), "every chunk around the seam should hold part of the ball");
+    }
+    std::vector<unsigned int> indices;
+    weldSmooth(meshes, indices);
+    check(closedSurface(indices), "smooth ball across chunk borders should close up without cracks");
+}
+
+// Faces a level of detail with cells of scale voxels should show: a cell is filled if any of its
+// voxels is, and a cell outside the chunk only hides a face if the whole scale x scale patch of
+// the neighbour's first layer is filled. Materials are left out; see testLodKeepsTopMaterial.
+static std::vector<UnitFace> referenceCoarseFaces(const VoxelStorage& storage, int scale) {
+    static const glm::ivec3 normals[6] = {
+        glm::ivec3(0, 0, 1), glm::ivec3(0, 0, -1), glm::ivec3(-1, 0, 0),
+        glm::ivec3(1, 0, 0), glm::ivec3(0, 1, 0), glm::ivec3(0, -1, 0)
+    };
+    const int n = 32 / scale;
+    auto cellFilled = [&](const glm::ivec3& cell) {
+        for (int z = 0; z < scale; ++z) {
+            for (int y = 0; y < scale; ++y) {
+                for (int x = 0; x < scale; ++x) {
+                    if (storage.hasVoxel(cell * scale + glm::ivec3(x, y, z))) {
+                        return true;
+                    }
+                }
+            }
+        }
+        return false;
+    };
+    auto neighbourLayerFilled = [&](const glm::ivec3& cell, int face) {
+        const int* axes = faceAxes[face];
+        glm::ivec3 voxel = cell * scale;
+        voxel[axes[0]] = axes[3] ? 32 : -1;
+        for (int v = 0; v < scale; ++v) {
+            for (int u = 0; u < scale; ++u) {
+                glm::ivec3 patch = voxel;
+                patch[axes[1]] += u;
+                patch[axes[2]] += v;
+                if (!storage.hasVoxel(patch)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    };
+    std::vector<UnitFace> faces;
+    for (int z = 0; z < n; ++z) {
+        for (int y = 0; y < n; ++y) {
+            for (int x = 0; x < n; ++x) {
+                glm::ivec3 cell(x, y, z);
+                if (!cellFilled(cell)) {
+                    continue;
+                }
+                for (int face = 0; face < 6; ++face) {
+                    glm::ivec3 next = cell + normals[face];
+                    bool inside = glm::all(glm::greaterThanEqual(next, glm::ivec3(0))) && glm::all(glm::lessThan(next, glm::ivec3(n)));
+                    if (inside ? !cellFilled(next) : !neighbourLayerFilled(cell, face)) {
+                        faces.push_back({ cell * scale, face, 0, 0 });
+                    }
+                }
+            }
+        }
+    }
+    std::sort(faces.begin(), faces.end());
+    return faces;
+}
+
+static std::vector<UnitFace> shapeOnly(std::vector<UnitFace> faces) {
+    for (UnitFace& face : faces) {
+        face.material = 0;
+        face.occlusion = 0;
+    }
+    std::sort(faces.begin(), faces.end());
+    return faces;
+}
+
+// True if every edge of the faces is shared by an even number of them, as on a closed surface
+static bool closedFaces(const std::vector<UnitFace>& faces, int scale) {
+    std::vector<std::pair<glm::ivec3, int>> edges; // Low end and axis, in voxel corners
+    for (const UnitFace& face : faces) {
+        const int* axes = faceAxes[face.face];
+        glm::ivec3 corner = face.voxel;
+        corner[axes[0]] += axes[3] ? scale : 0;
+        glm::ivec3 u(0);
+        glm::ivec3 v(0);
+        u[axes[1]] = scale;
+        v[axes[2]] = scale;
+        edges.emplace_back(corner, axes[1]);
+        edges.emplace_back(corner + v, axes[1]);
+        edges.emplace_back(corner, axes[2]);
+        edges.emplace_back(corner + u, axes[2]);
+    }
+    auto order = [](const std::pair<glm::ivec3, int>& a, const std::pair<glm::ivec3, int>& b) {
+        return std::tie(a.first.x, a.first.y, a.first.z, a.second) < std::tie(b.first.x, b.first.y, b.first.z, b.second);
+    };
+    std::sort(edges.begin(), edges.end(), order);
+    for (size_t i = 0; i < edges.size(); ) {
+        size_t end = i;
+        while (end < edges.size() && edges[end] == edges[i]) {
+            ++end;
+        }
+        if ((end - i) % 2 != 0) {
+            return false;
+        }
+        i = end;
+    }
+    return !edges.empty();
+}
+
+static void testLodShapes(const std::vector<Scene>& list) {
+    for (const Scene& scene : list) {
+        ChunkedVoxelStorage storage;
+        scene.fill(storage);
+        for (MeshingMode mode : { MESH_FACES, MESH_GREEDY }) {
+            ChunkMesh mesh = meshOf(storage, glm::ivec3(0), mode, ChunkMesher::MAX_LOD_LEVELS);
+            check(mesh.lods.size() == ChunkMesher::MAX_LOD_LEVELS, scene.name + ": mesh should carry every level of detail");
+            for (size_t level = 0; level < mesh.lods.size(); ++level) {
+                int scale = 2 << level;
+                std::string name = scene.name + ", level " + std::to_string(level);
+                check(shapeOnly(unitFaces(mesh.lods[level], scale)) == referenceCoarseFaces(storage, scale), name + ": coarse faces differ from the downsampled voxels");
+                check(mesh.lods[level].textureRanges.size() >= 1 && mesh.lods[level].indices.size() * 4 == mesh.lods[level].vertices.size() * 6, name + ": coarse mesh should be indexed quads");
+            }
+        }
+    }
+}
+
+static void testLodSolidBlockIsClosed() {
+    MaterialRegistry& registry = MaterialRegistry::global();
+    MaterialId stone = registry.getMaterial(1, glm::vec3(0.5f, 0.5f, 0.5f), "default");
+    // Off the coarse grid on every side, and touching the chunk's low faces, so cells are partly filled
+    const glm::ivec3 blocks[3][2] = {
+        { glm::ivec3(3, 5, 7), glm::ivec3(20, 26, 17) },
+        { glm::ivec3(0, 0, 0), glm::ivec3(31, 31, 31) },
+        { glm::ivec3(0, 9, 0), glm::ivec3(12, 9, 30) }
+    };
+    for (const auto& block : blocks) {
+        ChunkedVoxelStorage storage;
+        for (int z = block[0].z; z <= block[1].z; ++z) {
+            for (int y = block[0].y; y <= block[1].y; ++y) {
+                for (int x = block[0].x; x <= block[1].x; ++x) {
+                    storage.setVoxel(glm::ivec3(x, y, z), stone);
+                }
+            }
+        }
+        ChunkMesh mesh = meshOf(storage, glm::ivec3(0), MESH_GREEDY, ChunkMesher::MAX_LOD_LEVELS);
+        check(closedFaces(unitFaces(mesh), 1), "solid block should be closed at full detail");
+        for (size_t level = 0; level < mesh.lods.size(); ++level) {
+            int scale = 2 << level;
+            std::vector<UnitFace> faces = unitFaces(mesh.lods[level], scale);
+            check(closedFaces(faces, scale), "solid block should be closed at level " + std::to_string(level));
+            // The coarse box is the block rounded out to whole cells
+            glm::ivec3 low = block[0] / scale * scale;
+            glm::ivec3 size = (block[1] / scale + 1) * scale - low;
+            size_t area = 2 * (static_cast<size_t>(size.x) * size.y + static_cast<size_t>(size.y) * size.z + static_cast<size_t>(size.z) * size.x);
+            check(faces.size() * scale * scale == area, "solid block at level " + std::to_string(level) + " should be its rounded out box");
+        }
+    }
+}
+
+// A coarse cell takes the material of its highest filled voxels, so terrain seen from afar
+// keeps the colour of its top layer
+static void testLodKeepsTopMaterial(const std::vector<Scene>& list) {
+    MaterialRegistry& registry = MaterialRegistry::global();
+    MaterialId grass = registry.getMaterial(1, glm::vec3(0.2f, 0.8f, 0.2f), "grass");
+    ChunkedVoxelStorage storage;
+    for (const Scene& scene : list) {
+        if (scene.name == "hill") {
+            scene.fill(storage);
+        }
+    }
+    ChunkMesher mesher;
+    mesher.setMode(MESH_FACES);
+    mesher.setLodLevels(ChunkMesher::MAX_LOD_LEVELS);
+    ChunkMesh mesh;
+    mesher.meshChunk(storage, glm::ivec3(0), mesh);
+    for (size_t level = 0; level < mesh.lods.size(); ++level) {
+        size_t tops = 0;
+        bool allGrass = true;
+        for (const UnitFace& face : unitFaces(mesh.lods[level], 2 << level)) {
+            if (face.face == 4) {
+                ++tops;
+                allGrass = allGrass && face.material == grass;
+            }
+        }
+        check(tops > 0 && allGrass, "hill tops at level " + std::to_string(level) + " should keep the grass layer");
+    }
+
+    // Rebuilding only the levels, as after recolouring in place, gives the same levels
+    ChunkMesh patched = mesh;
+    mesher.meshLods(storage, glm::ivec3(0), patched);
+    bool same = patched.lods.size() == mesh.lods.size();
+    for (size_t level = 0; same && level < mesh.lods.size(); ++level) {
+        same = unitFaces(patched.lods[level], 2 << level) == unitFaces(mesh.lods[level], 2 << level);
+    }
+    check(same, "meshLods should rebuild the levels meshChunk built");
+}
+
+int main() {
+    MaterialRegistry& registry = MaterialRegistry::global();
+    MaterialId stone = registry.getMaterial(1, glm::vec3(0.5f, 0.5f, 0.5f), "default");
+    MaterialId grass = registry.getMaterial(1, glm::vec3(0.2f, 0.8f, 0.2f), "grass");
+    std::vector<Scene> list = scenes(stone, grass);
+
+    testGreedyCoversSameFaces(list);
+    testCullingMatchesScalar(list);
+    testOcclusionMatchesReference(list);
+    testCornerOcclusion();
+    testSmoothSingleVoxel();
+    testSmoothSurfaceIsClosed();
+    testLodShapes(list);
+    testLodSolidBlockIsClosed();
+    testLodKeepsTopMaterial(list);
+
+    if (failures == 0) {
+        std::cout << "All chunk mesher tests passed" << std::endl;
+        return 0;
+    }
+    std::cout << failures << " chunk mesher tests failed" << std::endl;
+    return 1;
+}
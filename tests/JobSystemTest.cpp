@@ -0,0 +1,46 @@
+// Runs batches of uneven jobs on a pool with more threads than this machine may
+// have cores, so stealing and the end-of-batch handoff get exercised either way.
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include <string>
+#include "JobSystem.h"
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cout << "FAILED: " << what << std::endl;
+        ++failures;
+    }
+}
+
+int main() {
+    JobSystem jobs(3);
+    check(jobs.getWorkerCount() == 4, "pool should have three threads plus the caller");
+
+    for (size_t count = 0; count < 300; count += 7) {
+        std::vector<std::atomic<int>> runs(count);
+        std::atomic<bool> workersOk(true);
+        jobs.parallelFor(count, [&](size_t index, unsigned worker) {
+            if (worker >= jobs.getWorkerCount()) {
+                workersOk = false;
+            }
+            // The first jobs are much slower, so the workers that finish early have to steal
+            volatile size_t spin = index < count / 4 ? 20000 : 10;
+            while (spin > 0) {
+                spin = spin - 1;
+            }
+            ++runs[index];
+        });
+        bool onceEach = true;
+        for (const std::atomic<int>& run : runs) {
+            onceEach = onceEach && run == 1;
+        }
+        check(onceEach, "batch of " + std::to_string(count) + " did not run every job exactly once");
+        check(workersOk, "worker index out of range");
+    }
+
+    std::cout << (failures == 0 ? "All job system tests passed" : "Job system tests failed") << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,260 @@
+// Checks that MeshCache keys follow exactly the voxels a chunk mesh depends on, that
+// cached meshes match freshly built ones, and that mesh files survive a registry that
+// hands out ids in another order while damaged or outdated files are turned away.
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <vector>
+#include <string>
+#include <cstring>
+#include "MeshCache.h"
+#include "ChunkMesher.h"
+#include "ChunkedVoxelStorage.h"
+#include "MaterialRegistry.h"
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cout << "FAILED: " << what << std::endl;
+        ++failures;
+    }
+}
+
+static bool sameMesh(const ChunkMesh& a, const ChunkMesh& b) {
+    if (a.vertices.size() != b.vertices.size() || a.indices != b.indices || a.textureRanges.size() != b.textureRanges.size()
+        || a.voxelQuads.size() != b.voxelQuads.size() || a.lods.size() != b.lods.size() || a.smooth != b.smooth) {
+        return false;
+    }
+    for (size_t i = 0; i < a.vertices.size(); ++i) {
+        if (a.vertices[i].position != b.vertices[i].position || a.vertices[i].material != b.vertices[i].material) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < a.textureRanges.size(); ++i) {
+        if (a.textureRanges[i].texture != b.textureRanges[i].texture || a.textureRanges[i].firstIndex != b.textureRanges[i].firstIndex
+            || a.textureRanges[i].indexCount != b.textureRanges[i].indexCount) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < a.voxelQuads.size(); ++i) {
+        if (a.voxelQuads[i].voxel != b.voxelQuads[i].voxel || a.voxelQuads[i].quad != b.voxelQuads[i].quad) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < a.lods.size(); ++i) {
+        if (!sameMesh(a.lods[i], b.lods[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static uint64_t keyOf(const VoxelStorage& storage, const glm::ivec3& chunkPos, MeshingMode mode, int lodLevels) {
+    std::vector<MaterialId> block(static_cast<size_t>(ChunkMesher::PADDED) * ChunkMesher::PADDED * ChunkMesher::PADDED);
+    storage.readRegion(chunkPos * VoxelChunk::SIZE - 1, glm::ivec3(ChunkMesher::PADDED), block.data());
+    return MeshCache::contentKey(block.data(), mode, lodLevels);
+}
+
+// A stepped hill of two materials, so the chunk has faces in every direction and both materials
+static void buildHill(VoxelStorage& storage, MaterialId stone, MaterialId grass) {
+    for (int x = 0; x < 32; ++x) {
+        for (int z = 0; z < 32; ++z) {
+            int height = 4 + (x * 7 + z * 3) % 11;
+            for (int y = 0; y < height; ++y) {
+                storage.setVoxel(glm::ivec3(x, y, z), y == height - 1 ? grass : stone);
+            }
+        }
+    }
+}
+
+static void testCacheHitMatchesFreshMesh(MaterialId stone, MaterialId grass) {
+    ChunkedVoxelStorage storage;
+    buildHill(storage, stone, grass);
+    const MeshingMode modes[3] = { MESH_FACES, MESH_GREEDY, MESH_SMOOTH };
+    for (MeshingMode mode : modes) {
+        ChunkMesher fresh;
+        fresh.setMode(mode);
+        fresh.setLodLevels(2);
+        ChunkMesh expected;
+        fresh.meshChunk(storage, glm::ivec3(0), expected);
+
+        MeshCache cache;
+        ChunkMesher cached;
+        cached.setMode(mode);
+        cached.setLodLevels(2);
+        cached.setCache(&cache);
+        ChunkMesh first;
+        ChunkMesh second;
+        cached.meshChunk(storage, glm::ivec3(0), first);
+        cached.meshChunk(storage, glm::ivec3(0), second);
+        std::string name = "mode " + std::to_string(mode);
+        check(cache.getHits() == 1 && cache.getMisses() == 1, name + ": second mesh of the same chunk should come from the cache");
+        check(!expected.empty() && sameMesh(first, expected), name + ": mesh built through the cache differs from a fresh one");
+        check(sameMesh(second, expected), name + ": cache hit differs from a fresh mesh");
+        check(second.contentKey == keyOf(storage, glm::ivec3(0), mode, 2), name + ": cache hit should carry the key of its voxels");
+    }
+}
+
+static void testKeyFollowsBorder(MaterialId stone, MaterialId grass) {
+    ChunkedVoxelStorage storage;
+    buildHill(storage, stone, grass);
+    const glm::ivec3 chunk(0);
+    uint64_t key = keyOf(storage, chunk, MESH_FACES, 0);
+    check(key != 0, "content keys are never 0");
+    check(keyOf(storage, chunk, MESH_FACES, 0) == key, "same voxels should give the same key");
+    check(keyOf(storage, chunk, MESH_GREEDY, 0) != key, "meshing mode should change the key");
+    check(keyOf(storage, chunk, MESH_FACES, 1) != key, "level of detail count should change the key");
+
+    // Two voxels past the edge belong to the neighbour but not to this chunk's border
+    storage.setVoxel(glm::ivec3(33, 3, 5), grass);
+    check(keyOf(storage, chunk, MESH_FACES, 0) == key, "voxel beyond the border should not change the key");
+
+    // The neighbour's first layer is the border this chunk is culled against
+    const glm::ivec3 borders[4] = { glm::ivec3(32, 3, 5), glm::ivec3(5, 3, -1), glm::ivec3(-1, 0, 31), glm::ivec3(32, 32, 32) };
+    for (const glm::ivec3& border : borders) {
+        storage.setVoxel(border, grass);
+        uint64_t changed = keyOf(storage, chunk, MESH_FACES, 0);
+        check(changed != key, "border voxel at " + std::to_string(border.x) + "," + std::to_string(border.y) + "," + std::to_string(border.z) + " should change the key");
+        storage.setVoxel(border, stone);
+        check(keyOf(storage, chunk, MESH_FACES, 0) != changed, "recolouring a border voxel should change the key");
+        storage.removeVoxel(border);
+        check(keyOf(storage, chunk, MESH_FACES, 0) == key, "removing the border voxel again should restore the key");
+    }
+}
+
+static std::vector<std::filesystem::path> meshFiles(const std::filesystem::path& dir) {
+    std::vector<std::filesystem::path> files;
+    for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+        if (entry.path().extension() == ".mesh") {
+            files.push_back(entry.path());
+        }
+    }
+    return files;
+}
+
+static std::vector<char> readFile(const std::filesystem::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<char>((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+static void writeFile(const std::filesystem::path& path, const std::vector<char>& bytes) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(bytes.data(), bytes.size());
+}
+
+// Saves the chunk's mesh into dir and returns it, with the one file written
+static ChunkMesh saveMesh(const std::filesystem::path& dir, const VoxelStorage& storage, uint64_t& key, std::filesystem::path& file) {
+    std::filesystem::remove_all(dir);
+    ChunkMesher mesher;
+    mesher.setMode(MESH_FACES);
+    ChunkMesh mesh;
+    mesher.meshChunk(storage, glm::ivec3(0), mesh);
+    key = keyOf(storage, glm::ivec3(0), MESH_FACES, 0);
+    MeshCache cache;
+    cache.setDirectory(dir.string());
+    cache.save(key, mesh);
+    std::vector<std::filesystem::path> files = meshFiles(dir);
+    file = files.size() == 1 ? files[0] : std::filesystem::path();
+    return mesh;
+}
+
+static bool loadMesh(const std::filesystem::path& dir, uint64_t key, ChunkMesh& mesh) {
+    MeshCache cache; // Empty, so find has to go to the file
+    cache.setDirectory(dir.string());
+    return cache.find(key, mesh);
+}
+
+static void testFileRoundTrip(MaterialId stone, MaterialId grass) {
+    const std::filesystem::path dir = std::filesystem::temp_directory_path() / "pixzorMeshCacheTest";
+    ChunkedVoxelStorage storage;
+    buildHill(storage, stone, grass);
+
+    uint64_t key;
+    std::filesystem::path file;
+    ChunkMesh saved = saveMesh(dir, storage, key, file);
+    check(!file.empty(), "save should write exactly one mesh file");
+    if (file.empty()) {
+        return;
+    }
+    ChunkMesh loaded;
+    check(loadMesh(dir, key, loaded) && sameMesh(loaded, saved), "mesh read back from disk differs from the one saved");
+    check(loaded.contentKey == key, "mesh read from disk should carry its key");
+
+    // A run that registered the two materials the other way round saved the same mesh with
+    // their ids swapped. The file lists each material as its id, type, colour and texture name
+    // after the magic, the version and the material count, ids in ascending order.
+    std::vector<char> bytes = readFile(file);
+    const size_t entryBytes = sizeof(MaterialId) + sizeof(int32_t) + sizeof(glm::vec3) + sizeof(uint16_t) + std::strlen("default");
+    const size_t firstId = 12;
+    MaterialId low = std::min(stone, grass);
+    MaterialId high = std::max(stone, grass);
+    MaterialId id0;
+    MaterialId id1;
+    std::memcpy(&id0, &bytes[firstId], sizeof(MaterialId));
+    std::memcpy(&id1, &bytes[firstId + entryBytes], sizeof(MaterialId));
+    check(id0 == low && id1 == high, "file should list the mesh's two materials first");
+    std::memcpy(&bytes[firstId], &high, sizeof(MaterialId));
+    std::memcpy(&bytes[firstId + entryBytes], &low, sizeof(MaterialId));
+    writeFile(file, bytes);
+    ChunkMesh remapped;
+    bool found = loadMesh(dir, key, remapped);
+    check(found && remapped.vertices.size() == saved.vertices.size(), "file saved under another registry order should still load");
+    if (found && remapped.vertices.size() == saved.vertices.size()) {
+        bool swapped = true;
+        for (size_t i = 0; i < saved.vertices.size(); ++i) {
+            MaterialId before = static_cast<MaterialId>(saved.vertices[i].material & 0xFFFF);
+            MaterialId after = static_cast<MaterialId>(remapped.vertices[i].material & 0xFFFF);
+            swapped = swapped && after == (before == stone ? grass : stone)
+                && remapped.vertices[i].position == saved.vertices[i].position
+                && (remapped.vertices[i].material & 0xFFFF0000u) == (saved.vertices[i].material & 0xFFFF0000u);
+        }
+        check(swapped, "materials of a file saved under another registry order were not remapped by content");
+    }
+
+    // Cut short: every length from nothing up to one byte short must be rejected
+    saved = saveMesh(dir, storage, key, file);
+    std::vector<char> whole = readFile(file);
+    const size_t cuts[5] = { 0, 3, 10, whole.size() / 2, whole.size() - 1 };
+    for (size_t cut : cuts) {
+        writeFile(file, std::vector<char>(whole.begin(), whole.begin() + cut));
+        ChunkMesh truncated;
+        check(!loadMesh(dir, key, truncated), "file truncated to " + std::to_string(cut) + " bytes should be rejected");
+    }
+
+    // Written by another version of the format
+    std::vector<char> outdated = whole;
+    uint32_t version;
+    std::memcpy(&version, &outdated[4], sizeof(version));
+    ++version;
+    std::memcpy(&outdated[4], &version, sizeof(version));
+    writeFile(file, outdated);
+    ChunkMesh stale;
+    check(!loadMesh(dir, key, stale), "file of another format version should be rejected");
+
+    std::vector<char> foreign = whole;
+    foreign[0] = 'X';
+    writeFile(file, foreign);
+    check(!loadMesh(dir, key, stale), "file with the wrong magic should be rejected");
+
+    writeFile(file, whole);
+    check(loadMesh(dir, key, stale) && sameMesh(stale, saved), "intact file should load again");
+    std::filesystem::remove_all(dir);
+}
+
+int main() {
+    MaterialRegistry& registry = MaterialRegistry::global();
+    MaterialId stone = registry.getMaterial(1, glm::vec3(0.5f, 0.5f, 0.5f), "default");
+    MaterialId grass = registry.getMaterial(1, glm::vec3(0.2f, 0.8f, 0.2f), "default");
+
+    testCacheHitMatchesFreshMesh(stone, grass);
+    testKeyFollowsBorder(stone, grass);
+    testFileRoundTrip(stone, grass);
+
+    if (failures == 0) {
+        std::cout << "All mesh cache tests passed" << std::endl;
+        return 0;
+    }
+    std::cout << failures << " mesh cache tests failed" << std::endl;
+    return 1;
+}
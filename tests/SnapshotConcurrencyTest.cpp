@@ -0,0 +1,210 @@
+// Reads snapshots on a second thread while the owning thread keeps editing, on
+// every storage backend. Build with -DPIXZOR_BUILD_TESTS=ON -DPIXZOR_TSAN=ON to
+// run it under ThreadSanitizer, which reports any write that reaches a shared chunk or page.
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <string>
+#include "VoxelWorld.h"
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cout << "FAILED: " << what << std::endl;
+        ++failures;
+    }
+}
+
+static void testSnapshotIsFrozen(VoxelStorageType type, const std::string& name) {
+    VoxelWorld world(128, type);
+    MaterialRegistry& registry = MaterialRegistry::global();
+    MaterialId blue = registry.getMaterial(1, glm::vec3(0.0f, 0.0f, 1.0f), "default");
+    MaterialId pink = registry.getMaterial(1, glm::vec3(1.0f, 0.0f, 1.0f), "default");
+
+    world.beginEdit();
+    world.fillBox(glm::ivec3(0, 0, 0), glm::ivec3(99, 9, 99), blue);
+    world.selectBox(glm::ivec3(0, 0, 0), glm::ivec3(10, 0, 10));
+    std::shared_ptr<const VoxelSnapshot> snapshot = world.snapshot();
+
+    std::atomic<bool> done(false);
+    std::atomic<bool> readerOk(true);
+    std::thread reader([&]() {
+        while (!done) {
+            size_t seen = 0;
+            snapshot->storage->forEachVoxel(glm::ivec3(0, 0, 0), glm::ivec3(99, 9, 99), [&](const glm::ivec3&, MaterialId material) {
+                if (material != blue) {
+                    readerOk = false;
+                }
+                ++seen;
+            });
+            if (seen != 100000 || snapshot->selected.count() != 121) {
+                readerOk = false;
+            }
+        }
+    });
+    for (int i = 0; i < 20; ++i) {
+        world.fillBox(glm::ivec3(0, 0, 0), glm::ivec3(99, 9, 99), i % 2 ? blue : pink);
+        world.removeVoxel(glm::ivec3(i, 0, i));
+        world.selectBox(glm::ivec3(0, 0, 0), glm::ivec3(50, 5, 50));
+    }
+    done = true;
+    reader.join();
+
+    check(readerOk, name + ": reader saw edits made after the snapshot");
+    check(world.getStorage().getVoxelCount() != 100000, name + ": edits did not reach the live world");
+    world.restore(*snapshot);
+    world.commitEdit();
+    check(world.getStorage().getVoxelCount() == 100000 && world.getSelectedCount() == 121, name + ": restore did not bring the snapshot back");
+}
+
+static void testPublishedSnapshots(VoxelStorageType type, const std::string& name) {
+    VoxelWorld world(128, type);
+    MaterialId blue = MaterialRegistry::global().getMaterial(1, glm::vec3(0.0f, 0.0f, 1.0f), "default");
+    world.fillBox(glm::ivec3(0, 0, 0), glm::ivec3(63, 3, 63), blue);
+    world.addReader();
+
+    std::atomic<bool> done(false);
+    std::atomic<bool> readerOk(true);
+    std::thread reader([&]() {
+        while (!done) {
+            std::shared_ptr<const VoxelSnapshot> snapshot = world.acquireSnapshot();
+            glm::ivec3 hitVoxel;
+            glm::vec3 hitNormal;
+            FaceDirection hitFace;
+            if (!snapshot->raycast(glm::vec3(5.0f, 50.0f, 5.0f), glm::vec3(0.0f, -1.0f, 0.0f), hitVoxel, hitNormal, hitFace) || hitVoxel != glm::ivec3(5, 3, 5)) {
+                readerOk = false;
+            }
+        }
+    });
+    std::shared_ptr<const VoxelSnapshot> before = world.acquireSnapshot();
+    for (int i = 0; i < 50; ++i) {
+        world.setVoxel(40, 4 + i % 5, 40, blue);
+        world.removeVoxel(glm::ivec3(40, 4 + i % 5, 40));
+    }
+    done = true;
+    reader.join();
+    world.removeReader();
+
+    std::shared_ptr<const VoxelSnapshot> after = world.acquireSnapshot();
+    check(readerOk, name + ": reader raycast missed the floor");
+    check(after->getChunkVersion(glm::ivec3(1, 0, 1)) > before->getChunkVersion(glm::ivec3(1, 0, 1)), name + ": edited chunk kept its version");
+    check(after->getChunkVersion(glm::ivec3(0, 0, 0)) == before->getChunkVersion(glm::ivec3(0, 0, 0)), name + ": untouched chunk changed version");
+}
+
+static size_t countIndices(const VoxelWorld& world) {
+    size_t indices = 0;
+    for (const auto& entry : world.getChunkMeshes()) {
+        indices += entry.second.indices.size();
+    }
+    return indices;
+}
+
+// Keeps editing while the background thread meshes earlier edits, then checks the
+// swapped-in meshes match a world meshed on the spot
+static void testAsyncMeshing(VoxelStorageType type, const std::string& name) {
+    MaterialId blue = MaterialRegistry::global().getMaterial(1, glm::vec3(0.0f, 0.0f, 1.0f), "default");
+    VoxelWorld world(128, type);
+    VoxelWorld reference(128, type);
+    world.setAsyncMeshing(true);
+    for (VoxelWorld* target : { &world, &reference }) {
+        target->fillBox(glm::ivec3(0, 0, 0), glm::ivec3(99, 9, 99), blue);
+    }
+    for (int i = 0; i < 30; ++i) {
+        for (VoxelWorld* target : { &world, &reference }) {
+            target->removeVoxel(glm::ivec3(i * 3, 9, i * 3));
+            target->selectBox(glm::ivec3(i, 0, 0), glm::ivec3(i + 2, 9, 2));
+        }
+        world.swapMeshBuffers();
+    }
+    world.waitForMeshing();
+    check(world.getDirtyChunkCount() == 0, name + ": chunks left unmeshed after waitForMeshing");
+    check(countIndices(world) == countIndices(reference), name + ": background meshes differ from synchronous ones");
+}
+
+// Every non-empty chunk mesh of the world, vertex for vertex, matches the reference's
+static bool sameMeshes(const VoxelWorld& world, const VoxelWorld& reference) {
+    size_t compared = 0;
+    for (const auto& entry : reference.getChunkMeshes()) {
+        if (entry.second.empty()) {
+            continue;
+        }
+        const ChunkMesh* mesh = world.getChunkMeshes().find(entry.first);
+        if (!mesh || mesh->indices != entry.second.indices || mesh->vertices.size() != entry.second.vertices.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < mesh->vertices.size(); ++i) {
+            if (mesh->vertices[i].position != entry.second.vertices[i].position || mesh->vertices[i].material != entry.second.vertices[i].material) {
+                return false;
+            }
+        }
+        ++compared;
+    }
+    size_t nonEmpty = 0;
+    for (const auto& entry : world.getChunkMeshes()) {
+        nonEmpty += !entry.second.empty();
+    }
+    return nonEmpty == compared;
+}
+
+// Smooth cells on a chunk border place their vertex from the neighbouring chunk's voxels,
+// so restoring a voxel on one side has to remesh the chunk on the other
+static void testSmoothRestore(VoxelStorageType type, const std::string& name) {
+    MaterialId blue = MaterialRegistry::global().getMaterial(1, glm::vec3(0.0f, 0.0f, 1.0f), "default");
+    // A voxel that stays put, and one across a face, edge or corner of its chunk that comes and goes
+    const glm::ivec3 pairs[][2] = {
+        { glm::ivec3(31, 5, 5), glm::ivec3(32, 5, 5) },
+        { glm::ivec3(31, 31, 5), glm::ivec3(32, 32, 5) },
+        { glm::ivec3(31, 31, 31), glm::ivec3(32, 32, 32) },
+        { glm::ivec3(40, 32, 40), glm::ivec3(40, 31, 40) },
+    };
+    for (const auto& pair : pairs) {
+        VoxelWorld world(128, type);
+        VoxelWorld without(128, type);
+        VoxelWorld with(128, type);
+        for (VoxelWorld* target : { &world, &without, &with }) {
+            target->setMeshingMode(MESH_SMOOTH);
+            target->setVoxel(pair[0].x, pair[0].y, pair[0].z, blue);
+        }
+        with.setVoxel(pair[1].x, pair[1].y, pair[1].z, blue);
+        without.generateMeshData();
+        with.generateMeshData();
+
+        world.generateMeshData();
+        std::shared_ptr<const VoxelSnapshot> before = world.snapshot();
+        world.setVoxel(pair[1].x, pair[1].y, pair[1].z, blue);
+        world.generateMeshData();
+        std::shared_ptr<const VoxelSnapshot> after = world.snapshot();
+        world.restore(*before);
+        check(sameMeshes(world, without), name + ": smooth border left over after restoring the voxel away");
+        world.restore(*after);
+        check(sameMeshes(world, with), name + ": smooth border stale after restoring the voxel");
+    }
+}
+
+// Leaves a background batch in flight when the world goes away; the pipeline has to
+// join it before the meshers and snapshot it reads are destroyed
+static void testDestroyWhileMeshing(VoxelStorageType type, const std::string& name) {
+    MaterialId blue = MaterialRegistry::global().getMaterial(1, glm::vec3(0.0f, 0.0f, 1.0f), "default");
+    for (int i = 0; i < 5; ++i) {
+        VoxelWorld world(128, type);
+        world.setAsyncMeshing(true);
+        world.fillBox(glm::ivec3(0, 0, 0), glm::ivec3(99, 9, 99), blue);
+        world.removeVoxel(glm::ivec3(i, 9, i));
+    }
+    check(true, name + ": destroying a world while it meshes");
+}
+
+int main() {
+    const VoxelStorageType types[] = { STORAGE_CHUNKED, STORAGE_SPARSE_OCTREE, STORAGE_DENSE };
+    const std::string names[] = { "chunked", "octree", "dense" };
+    for (int i = 0; i < 3; ++i) {
+        testSnapshotIsFrozen(types[i], names[i]);
+        testPublishedSnapshots(types[i], names[i]);
+        testAsyncMeshing(types[i], names[i]);
+        testSmoothRestore(types[i], names[i]);
+        testDestroyWhileMeshing(types[i], names[i]);
+    }
+    std::cout << (failures == 0 ? "All snapshot tests passed" : "Snapshot tests failed") << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,182 @@
+// Drives one chunk's palette up through every index width to 16 bits and back down,
+// checking each voxel against a plain array and the width against the palette after
+// every step, and that compaction starts exactly when half the palette is dead.
+#include <iostream>
+#include <vector>
+#include <string>
+#include <random>
+#include <algorithm>
+#include "VoxelChunk.h"
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cout << "FAILED: " << what << std::endl;
+        ++failures;
+    }
+}
+
+// The chunk and what it should hold, NONE for empty
+struct Model {
+    VoxelChunk chunk;
+    std::vector<MaterialId> expected = std::vector<MaterialId>(VoxelChunk::VOLUME, MaterialRegistry::NONE);
+
+    void set(int index, MaterialId material) {
+        chunk.setVoxel(index, material);
+        expected[index] = material;
+    }
+    void remove(int index) {
+        bool removed = chunk.removeVoxel(index);
+        if (removed != (expected[index] != MaterialRegistry::NONE)) {
+            check(false, "removeVoxel should report whether the voxel was there");
+        }
+        expected[index] = MaterialRegistry::NONE;
+    }
+    size_t liveMaterials() const {
+        std::vector<MaterialId> used(expected);
+        std::sort(used.begin(), used.end());
+        used.erase(std::unique(used.begin(), used.end()), used.end());
+        used.erase(std::remove(used.begin(), used.end(), MaterialRegistry::NONE), used.end());
+        return used.size();
+    }
+};
+
+static int widthFor(size_t paletteSize) {
+    int bits = 0;
+    while ((size_t(1) << bits) < paletteSize) {
+        bits = bits == 0 ? 1 : bits * 2;
+    }
+    return bits;
+}
+
+// Every voxel, the count, the width for the palette and the half-dead bound on the palette
+static bool consistent(const Model& model, const std::string& when) {
+    int count = 0;
+    for (int index = 0; index < VoxelChunk::VOLUME; ++index) {
+        MaterialId expected = model.expected[index];
+        bool has = model.chunk.hasVoxel(index);
+        if (has != (expected != MaterialRegistry::NONE) || (has && model.chunk.getMaterial(index) != expected)) {
+            check(false, when + ": voxel " + std::to_string(index) + " reads back wrong");
+            return false;
+        }
+        count += has;
+    }
+    int visited = 0;
+    model.chunk.forEachVoxel([&](int) { ++visited; });
+    size_t live = model.liveMaterials();
+    size_t palette = model.chunk.getPaletteSize();
+    bool ok = true;
+    if (count != model.chunk.getVoxelCount() || visited != count) {
+        check(false, when + ": voxel count is off");
+        ok = false;
+    }
+    if (model.chunk.getBitsPerIndex() != widthFor(palette)) {
+        check(false, when + ": " + std::to_string(model.chunk.getBitsPerIndex()) + " bit indices for a palette of " + std::to_string(palette));
+        ok = false;
+    }
+    if (palette < live || palette > 2 * live) {
+        check(false, when + ": palette of " + std::to_string(palette) + " for " + std::to_string(live) + " live materials");
+        ok = false;
+    }
+    return ok;
+}
+
+static MaterialId materialNumber(int i) {
+    return static_cast<MaterialId>(1 + i * 7); // Spread out, so ids and palette slots differ
+}
+
+static void testWidthsUpAndDown() {
+    Model model;
+    check(consistent(model, "empty chunk") && model.chunk.getBitsPerIndex() == 0, "empty chunk should need no index bits");
+
+    // Up: one more material at a time, each covering a stripe of voxels
+    const int widths[] = { 0, 1, 2, 2, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 8 };
+    const int materials = 300;
+    for (int i = 0; i < materials; ++i) {
+        for (int index = i; index < VoxelChunk::VOLUME; index += materials) {
+            model.set(index, materialNumber(i));
+        }
+        int expectedWidth = i < 17 ? widths[i] : (i < 256 ? 8 : 16);
+        check(model.chunk.getBitsPerIndex() == expectedWidth, std::to_string(i + 1) + " materials should use " + std::to_string(expectedWidth) + " bit indices");
+        if (i < 20 || i % 37 == 0 || i == 255 || i == 256) {
+            consistent(model, "growing to " + std::to_string(i + 1) + " materials");
+        }
+    }
+    check(model.chunk.getVoxelCount() == VoxelChunk::VOLUME, "every voxel should be filled");
+    consistent(model, "full chunk of 300 materials");
+
+    // Down: fold the materials into fewer and fewer, so the palette keeps dying off and compacting
+    std::mt19937 random(3);
+    for (int kept = materials; kept >= 1; kept = kept * 2 / 3) {
+        for (int index = 0; index < VoxelChunk::VOLUME; ++index) {
+            MaterialId material = model.expected[index];
+            int number = (material - 1) / 7;
+            if (number >= kept) {
+                model.set(index, materialNumber(random() % kept));
+            }
+        }
+        consistent(model, "folded to " + std::to_string(kept) + " materials");
+    }
+    check(model.chunk.getBitsPerIndex() == 0 && model.chunk.getPaletteSize() == 1, "one material should be back to no index bits");
+
+    // Emptying the chunk drops the palette altogether
+    for (int index = 0; index < VoxelChunk::VOLUME; index += 2) {
+        model.remove(index);
+    }
+    consistent(model, "half emptied");
+    for (int index = 1; index < VoxelChunk::VOLUME; index += 2) {
+        model.remove(index);
+    }
+    check(consistent(model, "emptied") && model.chunk.isEmpty() && model.chunk.getPaletteSize() == 0, "empty chunk should hold no palette");
+    model.remove(5);
+    model.set(5, materialNumber(9));
+    check(consistent(model, "refilled") && model.chunk.getBitsPerIndex() == 0, "one voxel after emptying should need no index bits");
+}
+
+// Fills n materials, then removes them one at a time: the palette must stay as it is
+// while at least half of it is in use, and compact on the removal that breaks that
+static void testCompactionThreshold(int n) {
+    Model model;
+    for (int i = 0; i < n; ++i) {
+        model.set(i * 11, materialNumber(i));
+        model.set(i * 11 + 1, materialNumber(i));
+    }
+    check(model.chunk.getPaletteSize() == static_cast<size_t>(n), std::to_string(n) + " materials should give a palette of " + std::to_string(n));
+    int width = widthFor(n);
+    for (int removed = 1; removed < n; ++removed) {
+        model.remove((removed - 1) * 11);
+        model.remove((removed - 1) * 11 + 1);
+        int live = n - removed;
+        std::string name = std::to_string(n) + " materials, " + std::to_string(live) + " live";
+        if (2 * live >= n) {
+            check(model.chunk.getPaletteSize() == static_cast<size_t>(n) && model.chunk.getBitsPerIndex() == width, name + ": palette should not compact yet");
+        } else {
+            check(model.chunk.getPaletteSize() == static_cast<size_t>(live) && model.chunk.getBitsPerIndex() == widthFor(live), name + ": palette should have compacted");
+            consistent(model, name);
+            return;
+        }
+        // A dead entry is reused before the palette grows
+        if (removed == 1) {
+            model.set(3000, materialNumber(1000));
+            check(model.chunk.getPaletteSize() == static_cast<size_t>(n), name + ": new material should take the dead entry");
+            model.remove(3000);
+        }
+        consistent(model, name);
+    }
+}
+
+int main() {
+    testWidthsUpAndDown();
+    const int sizes[] = { 2, 3, 4, 5, 16, 17, 256, 257 };
+    for (int n : sizes) {
+        testCompactionThreshold(n);
+    }
+
+    if (failures == 0) {
+        std::cout << "All voxel chunk tests passed" << std::endl;
+        return 0;
+    }
+    std::cout << failures << " voxel chunk tests failed" << std::endl;
+    return 1;
+}
@@ -0,0 +1,232 @@
+// Runs VoxelHashMap through long random mixes of inserts, overwrites and erases next to
+// std::map, on dense clusters that make long Robin Hood probe chains and on coordinates
+// at and past the edges of the Morton range, checking lookups, iteration and size throughout.
+#include <iostream>
+#include <vector>
+#include <map>
+#include <tuple>
+#include <string>
+#include <random>
+#include <climits>
+#include "VoxelHashMap.h"
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cout << "FAILED: " << what << std::endl;
+        ++failures;
+    }
+}
+
+using Key = std::tuple<int, int, int>;
+
+static Key keyOf(const glm::ivec3& position) {
+    return Key(position.x, position.y, position.z);
+}
+
+// Everything the map holds, read back through find and through iteration
+static bool matches(const VoxelHashMap<int>& map, const std::map<Key, int>& expected, const std::string& when) {
+    if (map.size() != expected.size() || map.empty() != expected.empty()) {
+        check(false, when + ": size " + std::to_string(map.size()) + ", expected " + std::to_string(expected.size()));
+        return false;
+    }
+    for (const auto& entry : expected) {
+        glm::ivec3 position(std::get<0>(entry.first), std::get<1>(entry.first), std::get<2>(entry.first));
+        const int* value = map.find(position);
+        if (!value || *value != entry.second || !map.contains(position)) {
+            check(false, when + ": lost a key");
+            return false;
+        }
+    }
+    std::map<Key, int> iterated;
+    for (auto entry : map) {
+        if (!iterated.emplace(keyOf(entry.first), entry.second).second) {
+            check(false, when + ": iteration visited a key twice");
+            return false;
+        }
+    }
+    if (iterated != expected) {
+        check(false, when + ": iteration does not match the contents");
+        return false;
+    }
+    return true;
+}
+
+static void testMorton() {
+    const int low = -(1 << 20);
+    const int high = (1 << 20) - 1;
+    const glm::ivec3 inside[] = {
+        glm::ivec3(0), glm::ivec3(low), glm::ivec3(high), glm::ivec3(low, high, 0), glm::ivec3(-1, 1, high), glm::ivec3(12345, -54321, 777)
+    };
+    for (const glm::ivec3& position : inside) {
+        check(Morton::inRange(position) && Morton::decode(Morton::encode(position)) == position, "Morton code should round trip inside its range");
+    }
+    const glm::ivec3 outside[] = {
+        glm::ivec3(high + 1, 0, 0), glm::ivec3(0, low - 1, 0), glm::ivec3(0, 0, INT_MAX), glm::ivec3(INT_MIN, 0, 0), glm::ivec3(1 << 21, 1 << 21, 1 << 21)
+    };
+    for (const glm::ivec3& position : outside) {
+        check(!Morton::inRange(position), "coordinate outside [-2^20, 2^20) should be out of range");
+    }
+}
+
+// Keys that are out of range would alias real ones if they were encoded; they must be
+// turned away without disturbing the keys they would alias
+static void testOutOfRangeKeys() {
+    VoxelHashMap<int> map;
+    std::map<Key, int> expected;
+    const int span = 1 << 21;
+    const glm::ivec3 real[] = { glm::ivec3(0), glm::ivec3(5, -3, 9), glm::ivec3(-(1 << 20)), glm::ivec3((1 << 20) - 1) };
+    for (const glm::ivec3& position : real) {
+        map.insert(position, position.x + 7);
+        expected[keyOf(position)] = position.x + 7;
+    }
+    for (const glm::ivec3& position : real) {
+        // One Morton span away would land on the same code if the bias wrapped around
+        const glm::ivec3 aliases[] = { position + glm::ivec3(span, 0, 0), position - glm::ivec3(0, span, 0), glm::ivec3(position.x, position.y, position.z + span) };
+        for (const glm::ivec3& alias : aliases) {
+            check(!map.insert(alias, -1), "out of range key should be rejected");
+            check(!map.contains(alias) && map.find(alias) == nullptr, "out of range key should never be found");
+            check(!map.erase(alias), "erasing an out of range key should do nothing");
+        }
+    }
+    const glm::ivec3 extremes[] = { glm::ivec3(INT_MAX), glm::ivec3(INT_MIN), glm::ivec3(INT_MIN, 0, INT_MAX) };
+    for (const glm::ivec3& position : extremes) {
+        check(!map.insert(position, -1) && !map.contains(position) && !map.erase(position), "extreme coordinate should be rejected");
+    }
+    matches(map, expected, "after out of range keys");
+}
+
+static void testRandomMix(const std::string& name, int radius, int operations, unsigned seed, bool spread) {
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<int> near(-radius, radius);
+    std::uniform_int_distribution<int> far(-(1 << 20), (1 << 20) - 1);
+    auto randomKey = [&]() {
+        // Mostly a dense cluster, so probe chains get long; sometimes anywhere in range or past it
+        int pick = static_cast<int>(random() % 1000);
+        if (spread && pick < 100) {
+            return glm::ivec3(far(random), far(random), far(random));
+        }
+        if (spread && pick < 102) {
+            int edge = (random() % 2) ? (1 << 20) : -(1 << 20) - 1;
+            return glm::ivec3(edge, near(random), near(random));
+        }
+        return glm::ivec3(near(random), near(random), near(random));
+    };
+
+    VoxelHashMap<int> map;
+    std::map<Key, int> expected;
+    for (int step = 0; step < operations; ++step) {
+        glm::ivec3 position = randomKey();
+        bool inRange = Morton::inRange(position);
+        int operation = static_cast<int>(random() % 10);
+        // Inserts outnumber erases early on and the other way round later, so the table grows, fills and drains
+        bool inserting = operation < (step < operations / 2 ? 7 : 3);
+        if (inserting) {
+            int value = static_cast<int>(random());
+            bool added = inRange && expected.find(keyOf(position)) == expected.end();
+            if (map.insert(position, value) != added) {
+                check(false, name + ": insert reported the wrong result at step " + std::to_string(step));
+                return;
+            }
+            if (inRange) {
+                expected[keyOf(position)] = value;
+            }
+        } else {
+            bool present = expected.erase(keyOf(position)) != 0;
+            if (map.erase(position) != present) {
+                check(false, name + ": erase reported the wrong result at step " + std::to_string(step));
+                return;
+            }
+        }
+        if (step % 997 == 0 && !matches(map, expected, name + " at step " + std::to_string(step))) {
+            return;
+        }
+    }
+    if (!matches(map, expected, name + " after the mix")) {
+        return;
+    }
+
+    // Drain completely: every erase shifts a cluster back, and the map must still find the rest
+    std::vector<Key> keys;
+    for (const auto& entry : expected) {
+        keys.push_back(entry.first);
+    }
+    std::shuffle(keys.begin(), keys.end(), random);
+    for (size_t i = 0; i < keys.size(); ++i) {
+        glm::ivec3 position(std::get<0>(keys[i]), std::get<1>(keys[i]), std::get<2>(keys[i]));
+        check(map.erase(position), name + ": drained key should be present");
+        expected.erase(keys[i]);
+        if (i % 211 == 0 && !matches(map, expected, name + " while draining")) {
+            return;
+        }
+    }
+    matches(map, expected, name + " drained");
+    check(map.empty() && map.begin() == map.end(), name + ": drained map should be empty");
+
+    // The emptied table is reused as is
+    for (int i = 0; i < 100; ++i) {
+        glm::ivec3 position(i, -i, i * 3);
+        map[position] = i;
+        expected[keyOf(position)] = i;
+    }
+    matches(map, expected, name + " refilled");
+}
+
+// Growing ahead of time and clearing keep the table's contents intact
+static void testReserveAndClear() {
+    VoxelHashMap<int> map;
+    std::map<Key, int> expected;
+    for (int i = 0; i < 50; ++i) {
+        glm::ivec3 position(i % 4, i / 4, -i);
+        map.insert(position, i);
+        expected[keyOf(position)] = i;
+    }
+    map.reserve(5000);
+    matches(map, expected, "after reserve");
+    for (int i = 0; i < 5000; ++i) {
+        glm::ivec3 position(i % 17, (i / 17) % 17, i / 289 + 100);
+        map[position] = -i;
+        expected[keyOf(position)] = -i;
+    }
+    map.reserve(10);
+    matches(map, expected, "after filling and a smaller reserve");
+    map.clear();
+    expected.clear();
+    matches(map, expected, "after clear");
+    check(map.insert(glm::ivec3(1, 2, 3), 4) && *map.find(glm::ivec3(1, 2, 3)) == 4, "cleared map should take new keys");
+}
+
+static void testSet() {
+    std::vector<glm::ivec3> keys;
+    for (int x = -8; x < 8; ++x) {
+        for (int z = -8; z < 8; ++z) {
+            keys.emplace_back(x, 0, z);
+        }
+    }
+    VoxelHashSet set(keys.begin(), keys.end());
+    check(set.size() == keys.size(), "set should hold every key once");
+    check(!set.insert(keys[3]) && set.erase(keys[3]) && !set.contains(keys[3]) && set.count(keys[4]) == 1, "set insert and erase");
+    size_t visited = 0;
+    for (auto it = set.begin(); it != set.end(); ++it) {
+        visited += (*it).y == 0;
+    }
+    check(visited == keys.size() - 1, "set iteration should visit every key");
+}
+
+int main() {
+    testMorton();
+    testOutOfRangeKeys();
+    testRandomMix("dense cube", 6, 40000, 1, false);
+    testRandomMix("clusters with far and out of range keys", 20, 60000, 2, true);
+    testRandomMix("planar floor", 0, 2000, 3, false);
+    testReserveAndClear();
+    testSet();
+
+    if (failures == 0) {
+        std::cout << "All voxel hash map tests passed" << std::endl;
+        return 0;
+    }
+    std::cout << failures << " voxel hash map tests failed" << std::endl;
+    return 1;
+}